@@ -7,6 +7,8 @@
 #include "threads/io.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/trace.h"
 
 /* The code in this file is an interface to an ATA (IDE)
    controller.  It attempts to comply to [ATA-3]. */
@@ -86,6 +88,7 @@ static void identify_ata_device (struct disk *);
 
 static void select_sector (struct disk *, disk_sector_t);
 static void issue_pio_command (struct channel *, uint8_t command);
+static void wait_completion (struct channel *);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
 
@@ -218,7 +221,7 @@ disk_read (struct disk *d, disk_sector_t sec_no, void *buffer) {
 	lock_acquire (&c->lock);
 	select_sector (d, sec_no);
 	issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-	sema_down (&c->completion_wait);
+	wait_completion (c);
 	if (!wait_while_busy (d))
 		PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
 	input_sector (c, buffer);
@@ -245,7 +248,7 @@ disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer) {
 	if (!wait_while_busy (d))
 		PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
 	output_sector (c, buffer);
-	sema_down (&c->completion_wait);
+	wait_completion (c);
 	d->write_cnt++;
 	lock_release (&c->lock);
 }
@@ -354,7 +357,7 @@ identify_ata_device (struct disk *d) {
 	   into our buffer. */
 	select_device_wait (d);
 	issue_pio_command (c, CMD_IDENTIFY_DEVICE);
-	sema_down (&c->completion_wait);
+	wait_completion (c);
 	if (!wait_while_busy (d)) {
 		d->is_ata = false;
 		return;
@@ -432,6 +435,14 @@ issue_pio_command (struct channel *c, uint8_t command) {
 	outb (reg_command (c), command);
 }
 
+/* Waits for the interrupt that completes the command issued on
+   channel C. */
+static void
+wait_completion (struct channel *c) {
+	thread_current ()->wait_reason = TRACE_WAIT_DISK;
+	sema_down (&c->completion_wait);
+}
+
 /* Reads a sector from channel C's data register in PIO mode into
    SECTOR, which must have room for DISK_SECTOR_SIZE bytes. */
 static void
@@ -2,6 +2,7 @@
 #include <debug.h>
 #include "devices/intq.h"
 #include "devices/serial.h"
+#include "threads/trace.h"
 
 /* Stores keys from the keyboard and serial port. */
 static struct intq buffer;
@@ -13,12 +14,17 @@ input_init (void) {
 }
 
 /* Adds a key to the input buffer.
-   Interrupts must be off and the buffer must not be full. */
+   Interrupts must be off and the buffer must not be full.
+   TRACE_DUMP_KEY requests a trace dump instead, if tracing is on. */
 void
 input_putc (uint8_t key) {
 	ASSERT (intr_get_level () == INTR_OFF);
 	ASSERT (!intq_full (&buffer));
 
+	if (key == TRACE_DUMP_KEY && trace_enabled) {
+		trace_request_dump ();
+		return;
+	}
 	intq_putc (&buffer, key);
 	serial_notify ();
 }
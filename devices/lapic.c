@@ -0,0 +1,211 @@
+#include "devices/lapic.h"
+#include <debug.h>
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/mmu.h"
+#include "threads/pte.h"
+#include "threads/vaddr.h"
+#include "intrinsic.h"
+
+/* Local APIC.
+
+   The local APIC timer is used for high-resolution timeouts and
+   the interrupt command register to start application
+   processors and to send them interprocessor interrupts (IPIs).
+   Device interrupts still come from the 8259A PICs, which the
+   bootstrap processor's local APIC passes through by programming
+   LINT0 as an ExtINT input ("virtual wire" mode); the other
+   CPUs mask LINT0, so that each device interrupt is taken only
+   once.  See [IA32-v3a] chapter 10 "Advanced Programmable
+   Interrupt Controller (APIC)". */
+
+#define MSR_APIC_BASE 0x1b              /* IA32_APIC_BASE. */
+#define APIC_BASE_ENABLE (1 << 11)      /* APIC global enable. */
+#define APIC_BASE_ADDR 0xffffff000ULL   /* Physical base address. */
+#define CPUID_EDX_APIC (1 << 9)         /* CPUID leaf 1: has an APIC. */
+
+/* Register offsets. */
+#define LAPIC_ID 0x020          /* Local APIC ID. */
+#define LAPIC_TPR 0x080         /* Task priority. */
+#define LAPIC_EOI 0x0b0         /* End of interrupt. */
+#define LAPIC_SVR 0x0f0         /* Spurious interrupt vector. */
+#define LAPIC_ICR_LO 0x300      /* Interrupt command, low half. */
+#define LAPIC_ICR_HI 0x310      /* Interrupt command, high half. */
+#define LAPIC_LVT_TIMER 0x320   /* Local vector table: timer. */
+#define LAPIC_LVT_LINT0 0x350   /* Local vector table: LINT0 pin. */
+#define LAPIC_LVT_LINT1 0x360   /* Local vector table: LINT1 pin. */
+#define LAPIC_TIMER_INIT 0x380  /* Timer initial count. */
+#define LAPIC_TIMER_CUR 0x390   /* Timer current count. */
+#define LAPIC_TIMER_DIV 0x3e0   /* Timer divide configuration. */
+
+#define SVR_ENABLE (1 << 8)     /* APIC software enable. */
+#define LVT_MASKED (1 << 16)    /* Interrupt masked. */
+#define LVT_NMI (4 << 8)        /* Delivery mode: NMI. */
+#define LVT_EXTINT (7 << 8)     /* Delivery mode: ExtINT. */
+#define TIMER_DIV_16 0x3        /* Count at 1/16 of the bus clock. */
+
+/* Interrupt command register bits. */
+#define ICR_INIT (5 << 8)       /* Delivery mode: INIT. */
+#define ICR_STARTUP (6 << 8)    /* Delivery mode: start-up (SIPI). */
+#define ICR_PENDING (1 << 12)   /* Delivery status: send pending. */
+#define ICR_ASSERT (1 << 14)    /* Level: assert. */
+#define ICR_LEVEL (1 << 15)     /* Trigger mode: level. */
+
+/* Mapped registers, or NULL if there is no local APIC. */
+static volatile uint32_t *lapic;
+
+static uint32_t
+lapic_read (int reg) {
+	return lapic[reg / 4];
+}
+
+static void
+lapic_write (int reg, uint32_t value) {
+	lapic[reg / 4] = value;
+}
+
+static void lapic_setup (bool bsp);
+
+/* Maps and enables the bootstrap processor's local APIC, if the
+   CPU has one, with its timer stopped.  Returns true if
+   successful.  Must be called after paging_init(). */
+bool
+lapic_init (void) {
+	uint32_t eax, ebx, ecx, edx;
+	uint64_t base, pa, *pte;
+
+	cpuid (1, 0, &eax, &ebx, &ecx, &edx);
+	if (!(edx & CPUID_EDX_APIC))
+		return false;
+
+	base = read_msr (MSR_APIC_BASE);
+	if (!(base & APIC_BASE_ENABLE))
+		write_msr (MSR_APIC_BASE, base | APIC_BASE_ENABLE);
+	pa = base & APIC_BASE_ADDR;
+
+	/* The registers lie above RAM, so paging_init() did not map
+	   them.  Map them uncached. */
+	pte = pml4e_walk (base_pml4, (uint64_t) ptov (pa), 1);
+	if (pte == NULL)
+		return false;
+	*pte = pa | PTE_P | PTE_W | PTE_PWT | PTE_PCD;
+	lapic = ptov (pa);
+
+	lapic_setup (true);
+	return true;
+}
+
+/* Enables the local APIC of the application processor that
+   calls it, with its timer stopped.  The registers are at the
+   same address on every CPU, so lapic_init() must have mapped
+   them already. */
+void
+lapic_init_ap (void) {
+	uint64_t base = read_msr (MSR_APIC_BASE);
+
+	ASSERT (lapic != NULL);
+
+	if (!(base & APIC_BASE_ENABLE))
+		write_msr (MSR_APIC_BASE, base | APIC_BASE_ENABLE);
+	lapic_setup (false);
+}
+
+/* Programs the local vector table and enables the local APIC.
+   Only the bootstrap processor, if BSP is true, takes the PICs'
+   interrupts through LINT0. */
+static void
+lapic_setup (bool bsp) {
+	lapic_write (LAPIC_TPR, 0);
+	lapic_write (LAPIC_LVT_LINT0, bsp ? LVT_EXTINT : LVT_MASKED);
+	lapic_write (LAPIC_LVT_LINT1, LVT_NMI);
+	lapic_write (LAPIC_LVT_TIMER, LVT_MASKED | LAPIC_VEC_TIMER);
+	lapic_write (LAPIC_TIMER_DIV, TIMER_DIV_16);
+	lapic_write (LAPIC_TIMER_INIT, 0);
+	lapic_write (LAPIC_SVR, SVR_ENABLE | LAPIC_VEC_SPURIOUS);
+}
+
+/* Returns true if lapic_init() succeeded. */
+bool
+lapic_present (void) {
+	return lapic != NULL;
+}
+
+/* Returns the ID of the calling CPU's local APIC. */
+uint8_t
+lapic_id (void) {
+	ASSERT (lapic != NULL);
+
+	return lapic_read (LAPIC_ID) >> 24;
+}
+
+/* Acknowledges the local APIC interrupt being handled. */
+void
+lapic_eoi (void) {
+	lapic_write (LAPIC_EOI, 0);
+}
+
+/* Arms the timer to raise LAPIC_VEC_TIMER once, after COUNT
+   timer periods.  A COUNT of 0 stops the timer. */
+void
+lapic_timer_oneshot (uint32_t count) {
+	ASSERT (lapic != NULL);
+
+	lapic_write (LAPIC_LVT_TIMER, LAPIC_VEC_TIMER);
+	lapic_write (LAPIC_TIMER_INIT, count);
+}
+
+/* Starts the timer counting down from its maximum without
+   interrupting, for calibration with lapic_timer_count(). */
+void
+lapic_timer_free_run (void) {
+	ASSERT (lapic != NULL);
+
+	lapic_write (LAPIC_LVT_TIMER, LVT_MASKED | LAPIC_VEC_TIMER);
+	lapic_write (LAPIC_TIMER_INIT, UINT32_MAX);
+}
+
+/* Returns the timer's current count. */
+uint32_t
+lapic_timer_count (void) {
+	ASSERT (lapic != NULL);
+
+	return lapic_read (LAPIC_TIMER_CUR);
+}
+
+/* Writes the interrupt command register to send LO to the local
+   APIC with ID APIC_ID, and waits for the send to complete.
+   Interrupts must be off, so that no handler sends an IPI of its
+   own between the two writes. */
+static void
+lapic_icr (uint8_t apic_id, uint32_t lo) {
+	ASSERT (lapic != NULL);
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	lapic_write (LAPIC_ICR_HI, (uint32_t) apic_id << 24);
+	lapic_write (LAPIC_ICR_LO, lo);
+	while (lapic_read (LAPIC_ICR_LO) & ICR_PENDING)
+		asm volatile ("pause");
+}
+
+/* Sends an INIT IPI to the CPU with local APIC ID APIC_ID, which
+   puts it in a wait-for-SIPI state. */
+void
+lapic_send_init (uint8_t apic_id) {
+	lapic_icr (apic_id, ICR_INIT | ICR_LEVEL | ICR_ASSERT);
+	lapic_icr (apic_id, ICR_INIT | ICR_LEVEL);
+}
+
+/* Sends a start-up IPI to the CPU with local APIC ID APIC_ID,
+   which then starts executing in real mode at physical address
+   PAGE * 4096.  See [IA32-v3a] 8.4.4.1 "Typical BSP
+   Initialization Sequence". */
+void
+lapic_send_startup (uint8_t apic_id, uint8_t page) {
+	lapic_icr (apic_id, ICR_STARTUP | page);
+}
+
+/* Sends interrupt VEC to the CPU with local APIC ID APIC_ID. */
+void
+lapic_send_ipi (uint8_t apic_id, uint8_t vec) {
+	lapic_icr (apic_id, vec);
+}
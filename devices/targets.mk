@@ -1,4 +1,5 @@
 devices_SRC  = devices/timer.c		# Timer device.
+devices_SRC += devices/lapic.c		# Local APIC timer.
 devices_SRC += devices/kbd.c		# Keyboard device.
 devices_SRC += devices/vga.c		# Video device.
 devices_SRC += devices/serial.c		# Serial port device.
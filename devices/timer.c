@@ -3,10 +3,13 @@
 #include <inttypes.h>
 #include <round.h>
 #include <stdio.h>
+#include "devices/lapic.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
+#include "threads/smp.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
+#include "intrinsic.h"
 
 /* See [8254] for hardware details of the 8254 timer chip. */
 
@@ -24,28 +27,120 @@ static int64_t ticks;
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
+/* 8254 input frequency and the counter value for one tick,
+   rounded to nearest. */
+#define PIT_HZ 1193180
+#define PIT_TICK_COUNT ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* Longest one-shot the 16-bit 8254 counter can express, in
+   ticks.  Only used without a local APIC timer. */
+#define PIT_MAX_ONESHOT (0xffff / PIT_TICK_COUNT)
+
+/* If true, the idle thread stops the periodic tick and programs
+   a one-shot interrupt for the next timeout instead.
+   Controlled by kernel command-line option "-tickless". */
+bool timer_tickless;
+
+/* Tickless idle state.  While ONESHOT_TICKS is nonzero, the
+   tick is stopped and `ticks' lags behind real time: either the
+   8254 is in one-shot mode or, if NOHZ_LAPIC, stopped with the
+   local APIC timer armed instead. */
+static int64_t oneshot_ticks; /* Ticks covered by the one-shot. */
+static bool nohz_lapic;		  /* One-shot is on the local APIC? */
+static int64_t nohz_start;	  /* timer_ns() when it was armed. */
+static int64_t nohz_entries;  /* # of times the tick was stopped. */
+static int64_t nohz_skipped;  /* # of ticks never delivered. */
+
+/* High-resolution clock.
+
+   timer_calibrate() measures the frequencies of the TSC and of
+   the local APIC timer against the 8254.  From then on,
+   timer_ns() reads the TSC, and high-resolution timeouts are
+   kept on a list sorted by expiry and fired by programming the
+   local APIC timer as a one-shot for the first of them.  Before
+   calibration, or without a local APIC, both fall back to the
+   tick. */
+#define NSEC_PER_SEC 1000000000LL
+#define NSEC_PER_TICK (NSEC_PER_SEC / TIMER_FREQ)
+#define CALIBRATE_TICKS 5		  /* Ticks to measure over. */
+#define HIRES_MAX_NS (NSEC_PER_SEC / 10) /* Longest one-shot programmed. */
+#define CPUID_EDX_INVARIANT_TSC (1 << 8) /* CPUID 0x80000007: invariant TSC. */
+
+static uint64_t tsc_hz;		   /* TSC frequency, or 0 if not calibrated. */
+static uint64_t tsc_ns_mult;   /* Nanoseconds per TSC cycle, times 2**32. */
+static uint64_t tsc_base;	   /* TSC at calibration. */
+static int64_t ns_base;		   /* timer_ns() at calibration. */
+static uint64_t lapic_hz;	   /* Local APIC timer frequency, or 0. */
+static struct list hires_list; /* Pending high-resolution timeouts. */
+static int64_t hires_fired;	   /* # of high-resolution timeouts fired. */
+
+/* Hierarchical timer wheel holding pending timeouts.
+
+   Level 0 has one bucket per tick for the next WHEEL0_SIZE
+   ticks.  Each higher level has WHEELN_SIZE buckets, each
+   covering a whole revolution of the level below it.  Whenever
+   level 0 wraps around, the next bucket of level 1 is
+   "cascaded", that is, its timeouts are redistributed into
+   finer-grained buckets, and so on up the hierarchy.  Adding and
+   cancelling a timeout is constant time, and each tick only
+   touches the bucket that is expiring. */
+#define WHEEL0_BITS 8
+#define WHEELN_BITS 6
+#define WHEEL0_SIZE (1 << WHEEL0_BITS)
+#define WHEELN_SIZE (1 << WHEELN_BITS)
+#define WHEEL0_MASK (WHEEL0_SIZE - 1)
+#define WHEELN_MASK (WHEELN_SIZE - 1)
+#define WHEEL_LEVELS 4
+#define WHEEL_MAX_DELTA ((int64_t)1 << (WHEEL0_BITS + (WHEEL_LEVELS - 1) * WHEELN_BITS))
+
+static struct list wheel0[WHEEL0_SIZE];
+static struct list wheeln[WHEEL_LEVELS - 1][WHEELN_SIZE];
+
+/* Next tick whose level-0 bucket has not been run yet. */
+static int64_t wheel_base;
+
 static intr_handler_func timer_interrupt;
+static intr_handler_func tick_interrupt;
 static bool too_many_loops(unsigned loops);
 static void busy_wait(int64_t loops);
 static void real_time_sleep(int64_t num, int32_t denom);
+static void wheel_insert(struct timeout *);
+static int wheel_cascade(int level);
+static void run_timeouts(void);
+static int64_t next_timeout(void);
+static void pit_set_periodic(void);
+static bool nohz_lapic_enter(int64_t delta);
+static void clock_calibrate(void);
+static intr_handler_func hires_interrupt;
+static void hires_program(void);
 
 /* Sets up the 8254 Programmable Interval Timer (PIT) to
    interrupt PIT_FREQ times per second, and registers the
    corresponding interrupt. */
 void timer_init(void)
 {
-	/* 8254 input frequency divided by TIMER_FREQ, rounded to
-	   nearest. */
-	uint16_t count = (1193180 + TIMER_FREQ / 2) / TIMER_FREQ;
+	int i, j;
 
-	outb(0x43, 0x34); /* CW: counter 0, LSB then MSB, mode 2, binary. */
-	outb(0x40, count & 0xff);
-	outb(0x40, count >> 8);
+	for (i = 0; i < WHEEL0_SIZE; i++)
+		list_init(&wheel0[i]);
+	for (i = 0; i < WHEEL_LEVELS - 1; i++)
+		for (j = 0; j < WHEELN_SIZE; j++)
+			list_init(&wheeln[i][j]);
+
+	list_init(&hires_list);
+
+	pit_set_periodic();
 
 	intr_register_ext(0x20, timer_interrupt, "8254 Timer");
+	if (lapic_init())
+	{
+		intr_register_ext(LAPIC_VEC_TIMER, hires_interrupt, "Local APIC Timer");
+		intr_register_ext(LAPIC_VEC_TICK, tick_interrupt, "Forwarded Timer Tick");
+	}
 }
 
-/* Calibrates loops_per_tick, used to implement brief delays. */
+/* Calibrates loops_per_tick, used to implement brief delays,
+   and the high-resolution clock. */
 void timer_calibrate(void)
 {
 	unsigned high_bit, test_bit;
@@ -69,6 +164,79 @@ void timer_calibrate(void)
 			loops_per_tick |= test_bit;
 
 	printf("%" PRIu64 " loops/s.\n", (uint64_t)loops_per_tick * TIMER_FREQ);
+
+	clock_calibrate();
+}
+
+/* Measures the frequencies of the TSC and of the local APIC
+   timer over CALIBRATE_TICKS timer ticks, and starts timer_ns()
+   running off the TSC. */
+static void
+clock_calibrate(void)
+{
+	uint64_t tsc_start, tsc_end;
+	uint32_t lapic_start = 0, lapic_end = 0;
+	uint32_t eax, ebx, ecx, edx;
+	enum intr_level old_level;
+	int64_t start;
+
+	/* Start right after a tick. */
+	start = ticks;
+	while (ticks == start)
+		barrier();
+	tsc_start = rdtsc();
+	if (lapic_present())
+	{
+		lapic_timer_free_run();
+		lapic_start = lapic_timer_count();
+	}
+
+	start = ticks;
+	while (ticks - start < CALIBRATE_TICKS)
+		barrier();
+	tsc_end = rdtsc();
+	if (lapic_present())
+	{
+		lapic_end = lapic_timer_count();
+		lapic_timer_oneshot(0);
+		lapic_hz = (uint64_t)(lapic_start - lapic_end) * TIMER_FREQ / CALIBRATE_TICKS;
+	}
+
+	old_level = intr_disable();
+	tsc_hz = (tsc_end - tsc_start) * TIMER_FREQ / CALIBRATE_TICKS;
+	tsc_ns_mult = ((uint64_t)NSEC_PER_SEC << 32) / tsc_hz;
+	tsc_base = rdtsc();
+	ns_base = ticks * NSEC_PER_TICK;
+	intr_set_level(old_level);
+
+	cpuid(0x80000000, 0, &eax, &ebx, &ecx, &edx);
+	if (eax >= 0x80000007)
+		cpuid(0x80000007, 0, &eax, &ebx, &ecx, &edx);
+	else
+		edx = 0;
+	printf("TSC: %" PRIu64 " Hz%s; local APIC timer: %" PRIu64 " Hz.\n",
+		   tsc_hz, edx & CPUID_EDX_INVARIANT_TSC ? "" : " (not invariant)", lapic_hz);
+}
+
+/* Returns the number of nanoseconds since the OS booted.  Once
+   the clock is calibrated this has the resolution of the TSC;
+   before that, of the timer tick. */
+int64_t
+timer_ns(void)
+{
+	uint64_t cycles;
+
+	if (tsc_hz == 0)
+		return timer_ticks() * NSEC_PER_TICK;
+	cycles = rdtsc() - tsc_base;
+	return ns_base + (int64_t)(((unsigned __int128)cycles * tsc_ns_mult) >> 32);
+}
+
+/* Returns true if timeout_add_ns() has better than tick
+   resolution. */
+bool timer_hires(void)
+{
+	return lapic_hz != 0;
 }
 
 /* Returns the number of timer ticks since the OS booted. */
@@ -94,7 +262,11 @@ timer_elapsed(int64_t then)
 void timer_sleep(int64_t ticks)
 {
 	int64_t start = timer_ticks();
-	thread_sleep(start + ticks); // ticks에 대해 확실하지 않으므로, 다시 볼 것
+
+	ASSERT(intr_get_level() == INTR_ON);
+	if (ticks <= 0)
+		return;
+	thread_sleep(start + ticks);
 }
 
 /* Suspends execution for approximately MS milliseconds. */
@@ -119,13 +291,161 @@ void timer_nsleep(int64_t ns)
 void timer_print_stats(void)
 {
 	printf("Timer: %" PRId64 " ticks\n", timer_ticks());
+	if (timer_hires())
+		printf("Timer: %" PRId64 " high-resolution timeouts\n", hires_fired);
+	if (timer_tickless)
+		printf("Timer: tick stopped %" PRId64 " times, %" PRId64 " ticks skipped\n",
+			   nohz_entries, nohz_skipped);
 }
 
-/* Timer interrupt handler. */
+/* Called by the idle thread, with interrupts off, just before it
+   halts.  In tickless mode, replaces the periodic tick by a
+   one-shot interrupt at the next timeout, so that an idle
+   machine is not woken up TIMER_FREQ times per second.  The
+   skipped ticks are accounted for by timer_irq_enter().  With
+   more than one CPU, the tick only stops once all are idle; the
+   interrupt that gives any of them work restarts it.
+
+   The one-shot comes from the local APIC timer when there is one,
+   and otherwise from the 8254, whose 16-bit counter caps the
+   sleep at PIT_MAX_ONESHOT ticks. */
+void timer_idle_enter(void)
+{
+	int64_t delta;
+	uint16_t count;
+
+	ASSERT(intr_get_level() == INTR_OFF);
+
+	if (!timer_tickless || oneshot_ticks != 0 || !thread_cpus_idle())
+		return;
+
+	delta = next_timeout() - ticks;
+
+	/* The MLFQS updates load_avg and every recent_cpu once per
+	   second, so never sleep across a second boundary. */
+	if (thread_mlfqs && delta > TIMER_FREQ - ticks % TIMER_FREQ)
+		delta = TIMER_FREQ - ticks % TIMER_FREQ;
+
+	if (delta <= 1 || nohz_lapic_enter(delta))
+		return;
+
+	if (delta > PIT_MAX_ONESHOT)
+		delta = PIT_MAX_ONESHOT;
+
+	count = delta * PIT_TICK_COUNT;
+	outb(0x43, 0x30); /* CW: counter 0, LSB then MSB, mode 0, binary. */
+	outb(0x40, count & 0xff);
+	outb(0x40, count >> 8);
+
+	oneshot_ticks = delta;
+	nohz_entries++;
+}
+
+/* Stops the tick for DELTA - 1 ticks by stopping the 8254 and
+   arming this CPU's local APIC timer, no later than the first
+   high-resolution timeout.  Once timer_irq_enter()
+   restarts the 8254, its next tick is the DELTA'th and runs the
+   due timeouts as usual.  Returns false, doing nothing, without a
+   local APIC timer. */
+static bool
+nohz_lapic_enter(int64_t delta)
+{
+	int64_t now, wake;
+	uint64_t count;
+
+	if (!timer_hires())
+		return false;
+
+	now = timer_ns();
+	wake = now + (delta - 1) * NSEC_PER_TICK;
+	if (!list_empty(&hires_list))
+	{
+		struct timeout *first = list_entry(list_front(&hires_list), struct timeout, elem);
+
+		if (first->expires < wake)
+			wake = first->expires;
+	}
+	count = wake > now ? (uint64_t)(wake - now) * lapic_hz / NSEC_PER_SEC : 1;
+	if (count > UINT32_MAX)
+		count = UINT32_MAX;
+
+	/* Mode 5 waits for a rising edge on the gate, which counter 0
+	   never gets, so the 8254 falls silent.  Masking IRQ 0 instead
+	   would let the PIC latch a stale tick. */
+	outb(0x43, 0x3a); /* CW: counter 0, LSB then MSB, mode 5, binary. */
+	outb(0x40, 0xff);
+	outb(0x40, 0xff);
+	lapic_timer_oneshot(count > 0 ? count : 1);
+
+	oneshot_ticks = delta;
+	nohz_lapic = true;
+	nohz_start = now;
+	nohz_entries++;
+	return true;
+}
+
+/* Called on entry to every external interrupt.  If the tick was
+   stopped by timer_idle_enter(), brings `ticks' up to date and
+   restarts the periodic tick.  When the one-shot itself has
+   fired, its final tick is left for timer_interrupt() to count
+   as usual. */
+void timer_irq_enter(void)
+{
+	uint8_t status;
+	uint16_t count;
+	int64_t elapsed;
+
+	ASSERT(intr_get_level() == INTR_OFF);
+
+	if (oneshot_ticks == 0)
+		return;
+
+	if (nohz_lapic)
+	{
+		/* Count whole ticks slept, leaving the last for the 8254 as
+		   above.  The local APIC timer may still be armed; if so, it
+		   fires for nothing and hires_interrupt() re-arms it. */
+		elapsed = (timer_ns() - nohz_start) / NSEC_PER_TICK;
+		if (elapsed > oneshot_ticks - 1)
+			elapsed = oneshot_ticks - 1;
+		pit_set_periodic();
+		nohz_lapic = false;
+		oneshot_ticks = 0;
+
+		ticks += elapsed;
+		nohz_skipped += elapsed;
+		thread_account_idle(elapsed);
+		return;
+	}
+
+	/* Read-back command: latch status and count of counter 0. */
+	outb(0x43, 0xc2);
+	status = inb(0x40);
+	count = inb(0x40);
+	count |= inb(0x40) << 8;
+
+	/* In mode 0 the OUT pin goes high at terminal count. */
+	if (status & 0x80)
+		elapsed = oneshot_ticks - 1;
+	else
+		elapsed = (oneshot_ticks * PIT_TICK_COUNT - count) / PIT_TICK_COUNT;
+
+	pit_set_periodic();
+	oneshot_ticks = 0;
+
+	ticks += elapsed;
+	nohz_skipped += elapsed;
+	thread_account_idle(elapsed);
+}
+
+/* Timer interrupt handler.  Only the bootstrap processor takes
+   the 8254's interrupt, so it forwards each tick to the other
+   CPUs. */
 static void
 timer_interrupt(struct intr_frame *args UNUSED)
 {
 	ticks++;
+	smp_broadcast(LAPIC_VEC_TICK);
 	thread_tick();
 
 	if (thread_mlfqs)
@@ -144,9 +464,267 @@ timer_interrupt(struct intr_frame *args UNUSED)
 		}
 	}
 
-	int64_t next_tick = get_next_tick_to_awake();
-	if (next_tick <= ticks)
-		thread_awake(ticks);
+	run_timeouts();
+}
+
+/* Handler for the tick that timer_interrupt() forwards to the
+   other CPUs.  The once-a-second MLFQS updates cover all CPUs
+   and are left to timer_interrupt(). */
+static void
+tick_interrupt(struct intr_frame *args UNUSED)
+{
+	thread_tick();
+
+	if (thread_mlfqs)
+	{
+		mlfqs_increment();
+		if (ticks % 4 == 0)
+			mlfqs_recalc_priority();
+	}
+}
+
+/* Initializes timeout TO to call FUNC with AUX when it expires.
+   The timeout is not queued until timeout_add() is called. */
+void timeout_init(struct timeout *to, timeout_func *func, void *aux)
+{
+	ASSERT(to != NULL);
+	ASSERT(func != NULL);
+
+	to->func = func;
+	to->aux = aux;
+	to->pending = false;
+}
+
+/* Queues TO to expire at tick EXPIRES.  If EXPIRES has already
+   passed, TO expires on the next timer tick.  TO must not
+   already be pending.
+
+   This function may be called from an interrupt handler. */
+void timeout_add(struct timeout *to, int64_t expires)
+{
+	enum intr_level old_level;
+
+	ASSERT(to != NULL);
+
+	old_level = intr_disable();
+	ASSERT(!to->pending);
+	to->expires = expires;
+	to->pending = true;
+	wheel_insert(to);
+	intr_set_level(old_level);
+}
+
+/* Dequeues TO if it has not expired yet.  Returns true if TO was
+   pending, false if it had already expired (or was never added).
+
+   This function may be called from an interrupt handler. */
+bool timeout_cancel(struct timeout *to)
+{
+	enum intr_level old_level;
+	bool pending;
+
+	ASSERT(to != NULL);
+
+	old_level = intr_disable();
+	pending = to->pending;
+	if (pending)
+	{
+		list_remove(&to->elem);
+		to->pending = false;
+	}
+	intr_set_level(old_level);
+
+	return pending;
+}
+
+/* Orders high-resolution timeouts by expiry. */
+static bool
+hires_less(const struct list_elem *a_, const struct list_elem *b_, void *aux UNUSED)
+{
+	const struct timeout *a = list_entry(a_, struct timeout, elem);
+	const struct timeout *b = list_entry(b_, struct timeout, elem);
+
+	return a->expires < b->expires;
+}
+
+/* Queues TO to expire at EXPIRES, in timer_ns() nanoseconds.  If
+   EXPIRES has already passed, TO expires as soon as possible.
+   Without a high-resolution timer, TO goes on the timer wheel
+   instead and expires on the first tick at or after EXPIRES.  TO
+   must not already be pending; timeout_cancel() dequeues it.
+
+   This function may be called from an interrupt handler. */
+void timeout_add_ns(struct timeout *to, int64_t expires)
+{
+	enum intr_level old_level;
+
+	ASSERT(to != NULL);
+
+	if (!timer_hires())
+	{
+		timeout_add(to, DIV_ROUND_UP(expires, NSEC_PER_TICK));
+		return;
+	}
+
+	old_level = intr_disable();
+	ASSERT(!to->pending);
+	to->expires = expires;
+	to->pending = true;
+	list_insert_ordered(&hires_list, &to->elem, hires_less, NULL);
+	if (list_begin(&hires_list) == &to->elem)
+		hires_program();
+	intr_set_level(old_level);
+}
+
+/* Arms the local APIC timer for the first high-resolution
+   timeout, or stops it if there is none.  A timeout that is
+   cancelled leaves the timer armed; it then fires for
+   nothing. */
+static void
+hires_program(void)
+{
+	struct timeout *first;
+	int64_t delta;
+	uint64_t count;
+
+	ASSERT(intr_get_level() == INTR_OFF);
+
+	if (list_empty(&hires_list))
+	{
+		lapic_timer_oneshot(0);
+		return;
+	}
+
+	first = list_entry(list_front(&hires_list), struct timeout, elem);
+	delta = first->expires - timer_ns();
+	if (delta > HIRES_MAX_NS)
+		delta = HIRES_MAX_NS;
+	count = delta > 0 ? (uint64_t)delta * lapic_hz / NSEC_PER_SEC : 0;
+	lapic_timer_oneshot(count > 0 ? count : 1);
+}
+
+/* Local APIC timer interrupt handler.  Runs the callbacks of all
+   high-resolution timeouts that are due. */
+static void
+hires_interrupt(struct intr_frame *args UNUSED)
+{
+	int64_t now = timer_ns();
+
+	while (!list_empty(&hires_list))
+	{
+		struct timeout *to = list_entry(list_front(&hires_list), struct timeout, elem);
+
+		if (to->expires > now)
+			break;
+		list_pop_front(&hires_list);
+		to->pending = false;
+		hires_fired++;
+		to->func(to->aux);
+	}
+	hires_program();
+}
+
+/* Returns the earliest tick at which the timer interrupt has
+   work to do: the first nonempty level-0 bucket, or else the
+   next cascade of the upper levels. */
+static int64_t
+next_timeout(void)
+{
+	int64_t t;
+
+	for (t = wheel_base; t < wheel_base + WHEEL0_SIZE; t++)
+	{
+		if (!list_empty(&wheel0[t & WHEEL0_MASK]))
+			return t;
+		if (t > wheel_base && (t & WHEEL0_MASK) == 0)
+			return t;
+	}
+	return t;
+}
+
+/* Puts the 8254 back in periodic mode, interrupting
+   TIMER_FREQ times per second. */
+static void
+pit_set_periodic(void)
+{
+	outb(0x43, 0x34); /* CW: counter 0, LSB then MSB, mode 2, binary. */
+	outb(0x40, PIT_TICK_COUNT & 0xff);
+	outb(0x40, PIT_TICK_COUNT >> 8);
+}
+
+/* Puts TO into the bucket matching its distance from
+   wheel_base.  Timeouts beyond the reach of the wheel are
+   parked in the farthest bucket and re-sorted when cascaded. */
+static void
+wheel_insert(struct timeout *to)
+{
+	int64_t expires = to->expires;
+	int64_t delta = expires - wheel_base;
+	struct list *bucket;
+
+	if (delta < 0)
+		bucket = &wheel0[wheel_base & WHEEL0_MASK];
+	else if (delta < WHEEL0_SIZE)
+		bucket = &wheel0[expires & WHEEL0_MASK];
+	else
+	{
+		int level;
+
+		if (delta >= WHEEL_MAX_DELTA)
+			expires = wheel_base + WHEEL_MAX_DELTA - 1;
+		for (level = 0; level < WHEEL_LEVELS - 1; level++)
+			if (delta < (int64_t)1 << (WHEEL0_BITS + (level + 1) * WHEELN_BITS) || level == WHEEL_LEVELS - 2)
+				break;
+		bucket = &wheeln[level][(expires >> (WHEEL0_BITS + level * WHEELN_BITS)) & WHEELN_MASK];
+	}
+	list_push_back(bucket, &to->elem);
+}
+
+/* Moves every timeout in the current bucket of wheel LEVEL down
+   into finer buckets.  Returns the index of that bucket, so that
+   the caller continues cascading upward only when it is 0. */
+static int
+wheel_cascade(int level)
+{
+	int idx = (wheel_base >> (WHEEL0_BITS + level * WHEELN_BITS)) & WHEELN_MASK;
+	struct list *bucket = &wheeln[level][idx];
+	struct list moved;
+
+	list_init(&moved);
+	while (!list_empty(bucket))
+		list_push_back(&moved, list_pop_front(bucket));
+	while (!list_empty(&moved))
+		wheel_insert(list_entry(list_pop_front(&moved), struct timeout, elem));
+
+	return idx;
+}
+
+/* Runs the callbacks of all timeouts that expired up to and
+   including the current tick.  Called from the timer interrupt
+   handler. */
+static void
+run_timeouts(void)
+{
+	while (wheel_base <= ticks)
+	{
+		int idx = wheel_base & WHEEL0_MASK;
+		struct list *bucket = &wheel0[idx];
+		int level;
+
+		if (idx == 0)
+			for (level = 0; level < WHEEL_LEVELS - 1; level++)
+				if (wheel_cascade(level) != 0)
+					break;
+
+		while (!list_empty(bucket))
+		{
+			struct timeout *to = list_entry(list_pop_front(bucket), struct timeout, elem);
+
+			to->pending = false;
+			to->func(to->aux);
+		}
+		wheel_base++;
+	}
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
@@ -202,6 +780,14 @@ real_time_sleep(int64_t num, int32_t denom)
 		   processes. */
 		timer_sleep(ticks);
 	}
+	else if (timer_hires())
+	{
+		/* Otherwise, block on a high-resolution timeout if we
+		   have one, for accurate sub-tick timing without tying
+		   up the CPU. */
+		if (num > 0)
+			thread_sleep_ns(timer_ns() + num * (NSEC_PER_SEC / denom));
+	}
 	else
 	{
 		/* Otherwise, use a busy-wait loop for more accurate
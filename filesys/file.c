@@ -2,6 +2,18 @@
 #include <debug.h>
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
+
+/* Object cache for struct file. */
+static struct kmem_cache *file_cache;
+
+/* Initializes the file module. */
+void file_init(void)
+{
+	file_cache = kmem_cache_create("file", sizeof(struct file), NULL);
+	if (file_cache == NULL)
+		PANIC("file_init: cannot create file cache");
+}
 
 /* Opens a file for the given INODE, of which it takes ownership,
  * and returns the new file.  Returns a null pointer if an
@@ -9,19 +21,21 @@
 struct file *
 file_open(struct inode *inode)
 {
-	struct file *file = calloc(1, sizeof *file);
+	struct file *file = kmem_cache_alloc(file_cache);
 	if (inode != NULL && file != NULL)
 	{
 		file->inode = inode;
 		file->pos = 0;
 		file->deny_write = false;
 		file->dup_cnt = 0;
+		file->pin_cnt = 0;
+		file->closed = false;
 		return file;
 	}
 	else
 	{
 		inode_close(inode);
-		free(file);
+		kmem_cache_free(file_cache, file);
 		return NULL;
 	}
 }
@@ -57,7 +71,7 @@ void file_close(struct file *file)
 	{
 		file_allow_write(file);
 		inode_close(file->inode);
-		free(file);
+		kmem_cache_free(file_cache, file);
 	}
 }
 
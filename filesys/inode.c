@@ -6,6 +6,10 @@
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
@@ -33,6 +37,7 @@ struct inode {
 	int open_cnt;                       /* Number of openers. */
 	bool removed;                       /* True if deleted, false otherwise. */
 	int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+	struct rwlock rw;                   /* Serializes writers against I/O. */
 	struct inode_disk data;             /* Inode content. */
 };
 
@@ -53,10 +58,20 @@ byte_to_sector (const struct inode *inode, off_t pos) {
  * returns the same `struct inode'. */
 static struct list open_inodes;
 
+/* Protects open_inodes and every inode's open_cnt. */
+static struct lock open_inodes_lock;
+
+/* Object cache for struct inode. */
+static struct kmem_cache *inode_cache;
+
 /* Initializes the inode module. */
 void
 inode_init (void) {
 	list_init (&open_inodes);
+	lock_init (&open_inodes_lock);
+	inode_cache = kmem_cache_create ("inode", sizeof (struct inode), NULL);
+	if (inode_cache == NULL)
+		PANIC ("inode_init: cannot create inode cache");
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -104,20 +119,25 @@ inode_open (disk_sector_t sector) {
 	struct list_elem *e;
 	struct inode *inode;
 
+	lock_acquire (&open_inodes_lock);
+
 	/* Check whether this inode is already open. */
 	for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
 			e = list_next (e)) {
 		inode = list_entry (e, struct inode, elem);
 		if (inode->sector == sector) {
-			inode_reopen (inode);
+			inode->open_cnt++;
+			lock_release (&open_inodes_lock);
 			return inode; 
 		}
 	}
 
 	/* Allocate memory. */
-	inode = malloc (sizeof *inode);
-	if (inode == NULL)
+	inode = kmem_cache_alloc (inode_cache);
+	if (inode == NULL) {
+		lock_release (&open_inodes_lock);
 		return NULL;
+	}
 
 	/* Initialize. */
 	list_push_front (&open_inodes, &inode->elem);
@@ -125,15 +145,20 @@ inode_open (disk_sector_t sector) {
 	inode->open_cnt = 1;
 	inode->deny_write_cnt = 0;
 	inode->removed = false;
+	rwlock_init (&inode->rw);
 	disk_read (filesys_disk, inode->sector, &inode->data);
+	lock_release (&open_inodes_lock);
 	return inode;
 }
 
 /* Reopens and returns INODE. */
 struct inode *
 inode_reopen (struct inode *inode) {
-	if (inode != NULL)
+	if (inode != NULL) {
+		lock_acquire (&open_inodes_lock);
 		inode->open_cnt++;
+		lock_release (&open_inodes_lock);
+	}
 	return inode;
 }
 
@@ -153,9 +178,11 @@ inode_close (struct inode *inode) {
 		return;
 
 	/* Release resources if this was the last opener. */
+	lock_acquire (&open_inodes_lock);
 	if (--inode->open_cnt == 0) {
 		/* Remove from inode list and release lock. */
 		list_remove (&inode->elem);
+		lock_release (&open_inodes_lock);
 
 		/* Deallocate blocks if removed. */
 		if (inode->removed) {
@@ -164,8 +191,9 @@ inode_close (struct inode *inode) {
 					bytes_to_sectors (inode->data.length)); 
 		}
 
-		free (inode); 
-	}
+		kmem_cache_free (inode_cache, inode);
+	} else
+		lock_release (&open_inodes_lock);
 }
 
 /* Marks INODE to be deleted when it is closed by the last caller who
@@ -176,12 +204,10 @@ inode_remove (struct inode *inode) {
 	inode->removed = true;
 }
 
-/* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
- * Returns the number of bytes actually read, which may be less
- * than SIZE if an error occurs or end of file is reached. */
-off_t
-inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
-	uint8_t *buffer = buffer_;
+/* Reads SIZE bytes from INODE into kernel BUFFER, starting at
+ * position OFFSET, with INODE's rwlock held for reading. */
+static off_t
+read_locked (struct inode *inode, uint8_t *buffer, off_t size, off_t offset) {
 	off_t bytes_read = 0;
 	uint8_t *bounce = NULL;
 
@@ -225,15 +251,11 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 	return bytes_read;
 }
 
-/* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
- * Returns the number of bytes actually written, which may be
- * less than SIZE if end of file is reached or an error occurs.
- * (Normally a write at end of file would extend the inode, but
- * growth is not yet implemented.) */
-off_t
-inode_write_at (struct inode *inode, const void *buffer_, off_t size,
+/* Writes SIZE bytes from kernel BUFFER into INODE, starting at
+ * OFFSET, with INODE's rwlock held for writing. */
+static off_t
+write_locked (struct inode *inode, const uint8_t *buffer, off_t size,
 		off_t offset) {
-	const uint8_t *buffer = buffer_;
 	off_t bytes_written = 0;
 	uint8_t *bounce = NULL;
 
@@ -287,6 +309,94 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 	return bytes_written;
 }
 
+/* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
+ * Returns the number of bytes actually read, which may be less
+ * than SIZE if an error occurs or end of file is reached.
+ *
+ * A user BUFFER may fault, and the fault may have to read a file
+ * itself, so the copy to it is done outside INODE's rwlock: the
+ * data is read a page at a time into a kernel page with the lock
+ * held, then copied out after releasing it. */
+off_t
+inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
+	uint8_t *buffer = buffer_;
+	off_t bytes_read = 0;
+	uint8_t *page;
+
+	if (!is_user_vaddr (buffer)) {
+		rwlock_acquire_read (&inode->rw);
+		bytes_read = read_locked (inode, buffer, size, offset);
+		rwlock_release_read (&inode->rw);
+		return bytes_read;
+	}
+
+	page = palloc_get_page (0);
+	if (page == NULL)
+		return 0;
+	while (size > 0) {
+		off_t chunk = size < PGSIZE ? size : PGSIZE;
+
+		rwlock_acquire_read (&inode->rw);
+		chunk = read_locked (inode, page, chunk, offset);
+		rwlock_release_read (&inode->rw);
+		memcpy (buffer + bytes_read, page, chunk);
+
+		size -= chunk;
+		offset += chunk;
+		bytes_read += chunk;
+		if (chunk < PGSIZE)
+			break;
+	}
+	palloc_free_page (page);
+
+	return bytes_read;
+}
+
+/* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
+ * Returns the number of bytes actually written, which may be
+ * less than SIZE if end of file is reached or an error occurs.
+ * (Normally a write at end of file would extend the inode, but
+ * growth is not yet implemented.)
+ *
+ * As in inode_read_at(), a user BUFFER is copied a page at a time
+ * into a kernel page before INODE's rwlock is taken. */
+off_t
+inode_write_at (struct inode *inode, const void *buffer_, off_t size,
+		off_t offset) {
+	const uint8_t *buffer = buffer_;
+	off_t bytes_written = 0;
+	uint8_t *page;
+
+	if (!is_user_vaddr (buffer)) {
+		rwlock_acquire_write (&inode->rw);
+		bytes_written = write_locked (inode, buffer, size, offset);
+		rwlock_release_write (&inode->rw);
+		return bytes_written;
+	}
+
+	page = palloc_get_page (0);
+	if (page == NULL)
+		return 0;
+	while (size > 0) {
+		off_t chunk = size < PGSIZE ? size : PGSIZE;
+		off_t written;
+
+		memcpy (page, buffer + bytes_written, chunk);
+		rwlock_acquire_write (&inode->rw);
+		written = write_locked (inode, page, chunk, offset);
+		rwlock_release_write (&inode->rw);
+
+		size -= written;
+		offset += written;
+		bytes_written += written;
+		if (written < chunk)
+			break;
+	}
+	palloc_free_page (page);
+
+	return bytes_written;
+}
+
 /* Disables writes to INODE.
    May be called at most once per inode opener. */
 	void
@@ -1,6 +1,7 @@
 /* page_cache.c: Implementation of Page Cache (Buffer Cache). */
 
 #include "vm/vm.h"
+#include "threads/workqueue.h"
 static bool page_cache_readahead (struct page *page, void *kva);
 static bool page_cache_writeback (struct page *page);
 static void page_cache_destroy (struct page *page);
@@ -13,12 +14,15 @@ static const struct page_operations page_cache_op = {
 	.type = VM_PAGE_CACHE,
 };
 
-tid_t page_cache_workerd;
+/* Runs page cache writeback and readahead off the fault path. */
+static struct workqueue *page_cache_wq;
 
 /* The initializer of file vm */
 void
 pagecache_init (void) {
-	/* TODO: Create a worker daemon for page cache with page_cache_kworkerd */
+	page_cache_wq = workqueue_create ("kworkerd", 1, PRI_DEFAULT);
+	if (page_cache_wq == NULL)
+		PANIC ("pagecache_init: cannot create workqueue");
 }
 
 /* Initialize the page cache */
@@ -43,8 +47,3 @@ page_cache_writeback (struct page *page) {
 static void
 page_cache_destroy (struct page *page) {
 }
-
-/* Worker thread for page cache */
-static void
-page_cache_kworkerd (void *aux) {
-}
@@ -0,0 +1,31 @@
+#ifndef DEVICES_LAPIC_H
+#define DEVICES_LAPIC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Local APIC interrupt vectors.  Like the 8259A's vectors
+   0x20...0x2f, these are external interrupts, but they are
+   acknowledged on the local APIC instead. */
+#define LAPIC_VEC_BASE 0xf0     /* First local APIC vector. */
+#define LAPIC_VEC_TIMER 0xf0    /* Local APIC timer. */
+#define LAPIC_VEC_TICK 0xf1     /* IPI: timer tick, forwarded by the BSP. */
+#define LAPIC_VEC_RESCHED 0xf2  /* IPI: a thread was queued on this CPU. */
+#define LAPIC_VEC_TLB 0xf3      /* IPI: flush the TLB. */
+#define LAPIC_VEC_SPURIOUS 0xff /* Spurious interrupt; never acknowledged. */
+
+bool lapic_init (void);
+void lapic_init_ap (void);
+bool lapic_present (void);
+uint8_t lapic_id (void);
+void lapic_eoi (void);
+
+void lapic_send_init (uint8_t apic_id);
+void lapic_send_startup (uint8_t apic_id, uint8_t page);
+void lapic_send_ipi (uint8_t apic_id, uint8_t vec);
+
+void lapic_timer_oneshot (uint32_t count);
+void lapic_timer_free_run (void);
+uint32_t lapic_timer_count (void);
+
+#endif /* devices/lapic.h */
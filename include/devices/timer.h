@@ -1,7 +1,9 @@
 #ifndef DEVICES_TIMER_H
 #define DEVICES_TIMER_H
 
+#include <list.h>
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /* Number of timer interrupts per second. */
@@ -12,6 +14,8 @@ void timer_calibrate (void);
 
 int64_t timer_ticks (void);
 int64_t timer_elapsed (int64_t);
+int64_t timer_ns (void);
+bool timer_hires (void);
 
 void timer_sleep (int64_t ticks);
 void timer_msleep (int64_t milliseconds);
@@ -20,4 +24,28 @@ void timer_nsleep (int64_t nanoseconds);
 
 void timer_print_stats (void);
 
+/* Tickless idle ("-tickless"). */
+extern bool timer_tickless;
+void timer_idle_enter (void);
+void timer_irq_enter (void);
+
+/* Function called when a timeout expires.  Runs in the timer
+   interrupt handler, with interrupts off, so it must not sleep. */
+typedef void timeout_func (void *aux);
+
+/* A one-shot kernel timeout, queued on the timer wheel, or with
+   timeout_add_ns() on the high-resolution timeout list. */
+struct timeout {
+	int64_t expires;            /* Tick, or nanosecond, at which FUNC is called. */
+	timeout_func *func;         /* Expiry callback. */
+	void *aux;                  /* Argument passed to FUNC. */
+	bool pending;               /* Queued on the wheel? */
+	struct list_elem elem;      /* Wheel bucket element. */
+};
+
+void timeout_init (struct timeout *, timeout_func *, void *aux);
+void timeout_add (struct timeout *, int64_t expires);
+void timeout_add_ns (struct timeout *, int64_t expires);
+bool timeout_cancel (struct timeout *);
+
 #endif /* devices/timer.h */
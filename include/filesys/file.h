@@ -13,8 +13,12 @@ struct file
     off_t pos;           /* Current position. */
     bool deny_write;     /* Has file_deny_write() been called? */
     int dup_cnt;
+    int pin_cnt;         /* System calls in progress on the file. */
+    bool closed;         /* Closed while pinned; freed when unpinned. */
 };
 
+void file_init(void);
+
 /* Opening and closing files. */
 struct file *file_open(struct inode *);
 struct file *file_reopen(struct file *);
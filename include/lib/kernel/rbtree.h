@@ -0,0 +1,64 @@
+#ifndef __LIB_KERNEL_RBTREE_H
+#define __LIB_KERNEL_RBTREE_H
+
+/* Red-black tree.
+ *
+ * A balanced binary search tree, ordered by a caller-supplied
+ * comparison function.  Insertion and removal take O(log n)
+ * time.  The tree caches its smallest element, so finding it
+ * takes O(1) time.  Elements that compare equal are kept in the
+ * order they were inserted.
+ *
+ * Like the elements of lists and hash tables, tree elements are
+ * embedded in the structures they order: each structure that
+ * can be in a tree embeds a struct rb_elem member, and the
+ * rb_entry macro converts a struct rb_elem back to the structure
+ * that contains it.  Refer to lib/kernel/list.h for a detailed
+ * explanation.  The tree does no dynamic allocation. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Tree element. */
+struct rb_elem {
+	struct rb_elem *parent;     /* Parent, or NULL for the root. */
+	struct rb_elem *left;       /* Smaller elements. */
+	struct rb_elem *right;      /* Larger and equal elements. */
+	bool red;                   /* Red or black? */
+};
+
+/* Converts pointer to tree element RB_ELEM into a pointer to the
+ * structure that RB_ELEM is embedded inside.  Supply the name of
+ * the outer structure STRUCT and the member name MEMBER of the
+ * tree element. */
+#define rb_entry(RB_ELEM, STRUCT, MEMBER)                       \
+	((STRUCT *) ((uint8_t *) &(RB_ELEM)->parent             \
+		- offsetof (STRUCT, MEMBER.parent)))
+
+/* Compares the value of two tree elements A and B, given
+ * auxiliary data AUX.  Returns true if A is less than B, or
+ * false if A is greater than or equal to B. */
+typedef bool rb_less_func (const struct rb_elem *a,
+                           const struct rb_elem *b,
+                           void *aux);
+
+/* Red-black tree. */
+struct rb_tree {
+	struct rb_elem *root;       /* Root, or NULL if empty. */
+	struct rb_elem *first;      /* Smallest element, or NULL if empty. */
+	size_t size;                /* Number of elements. */
+	rb_less_func *less;         /* Comparison function. */
+	void *aux;                  /* Auxiliary data for `less'. */
+};
+
+void rb_init (struct rb_tree *, rb_less_func *, void *aux);
+void rb_insert (struct rb_tree *, struct rb_elem *);
+void rb_remove (struct rb_tree *, struct rb_elem *);
+
+struct rb_elem *rb_first (const struct rb_tree *);
+struct rb_elem *rb_next (const struct rb_elem *);
+size_t rb_size (const struct rb_tree *);
+bool rb_empty (const struct rb_tree *);
+
+#endif /* lib/kernel/rbtree.h */
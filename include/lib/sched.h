@@ -0,0 +1,41 @@
+#ifndef __LIB_SCHED_H
+#define __LIB_SCHED_H
+
+#include <stdint.h>
+
+/* Scheduler statistics, as returned by the sched_stats() system
+   call and printed by thread_print_stats().
+
+   Times are measured with the CPU's time-stamp counter and kept
+   as log2 histograms: bucket I counts intervals of at least 2**I
+   but less than 2**(I+1) units of 1024 TSC cycles, except that
+   bucket 0 also counts shorter intervals and the last bucket
+   also counts longer ones. */
+#define SCHED_HIST_BUCKETS 24
+
+struct sched_stats {
+	uint64_t switches;          /* Times switched to. */
+	uint64_t voluntary;         /* Slices ended by blocking, yielding or exiting. */
+	uint64_t preempted;         /* Slices ended by preemption. */
+	uint64_t dl_misses;         /* Deadline-class jobs finished late. */
+	uint64_t dl_throttled;      /* Times throttled for using up the budget. */
+	uint32_t runq_wait[SCHED_HIST_BUCKETS];  /* Time runnable but not running. */
+	uint32_t slice[SCHED_HIST_BUCKETS];      /* Time run before switching away. */
+};
+
+/* Scopes for sched_stats(). */
+#define SCHED_STATS_SELF 0      /* The calling thread. */
+#define SCHED_STATS_ALL 1       /* Every thread but the idle thread. */
+
+/* Parameters of the deadline scheduling class, for
+   sched_setdeadline().  Times are in nanoseconds.  A thread in the
+   class gets RUNTIME of CPU time in every PERIOD, to be used
+   within DEADLINE of the period's start, where 0 < RUNTIME <=
+   DEADLINE <= PERIOD.  A RUNTIME of 0 leaves the class. */
+struct sched_deadline {
+	uint64_t runtime;           /* CPU time per period. */
+	uint64_t deadline;          /* Relative deadline. */
+	uint64_t period;            /* Period. */
+};
+
+#endif /* lib/sched.h */
@@ -36,6 +36,19 @@ enum {
 
 	SYS_MOUNT,
 	SYS_UMOUNT,
+
+	/* Scheduler extensions. */
+	SYS_SCHED_STATS,            /* Obtain scheduler statistics. */
+	SYS_CLOCK_GETTIME,          /* Read a clock. */
+	SYS_SCHED_SETDEADLINE,      /* Enter or leave the deadline class. */
+	SYS_TRACE_DUMP,             /* Dump the scheduler trace. */
+
+	/* Threads. */
+	SYS_THREAD_CREATE,          /* Start a thread in this process. */
+	SYS_THREAD_EXIT,            /* Terminate this thread. */
+	SYS_THREAD_JOIN,            /* Wait for a thread to terminate. */
+	SYS_FUTEX_WAIT,             /* Sleep while a word holds a value. */
+	SYS_FUTEX_WAKE,             /* Wake threads sleeping on a word. */
 };
 
 #endif /* lib/syscall-nr.h */
@@ -0,0 +1,15 @@
+#ifndef __LIB_TIME_H
+#define __LIB_TIME_H
+
+#include <stdint.h>
+
+/* A time, as returned by the clock_gettime() system call. */
+struct timespec {
+	int64_t tv_sec;             /* Seconds. */
+	long tv_nsec;               /* Nanoseconds, 0 to 999,999,999. */
+};
+
+/* Clocks for clock_gettime(). */
+#define CLOCK_MONOTONIC 1       /* Time since boot; never goes backward. */
+
+#endif /* lib/time.h */
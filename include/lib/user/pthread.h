@@ -0,0 +1,40 @@
+#ifndef __LIB_USER_PTHREAD_H
+#define __LIB_USER_PTHREAD_H
+
+#include <syscall.h>
+
+/* A minimal subset of POSIX threads on top of thread_create()
+   and futexes.  Functions return 0 on success and -1 on error.
+   A thread's return value passes through an int exit status, so
+   only its low 32 bits survive pthread_join(). */
+
+typedef tid_t pthread_t;
+
+/* Mutex.  0: unlocked, 1: locked, 2: locked, maybe waiters. */
+typedef struct {
+	int state;
+} pthread_mutex_t;
+#define PTHREAD_MUTEX_INITIALIZER { 0 }
+
+/* Condition variable.  Waiters sleep on `seq', which each signal
+   or broadcast changes. */
+typedef struct {
+	int seq;
+} pthread_cond_t;
+#define PTHREAD_COND_INITIALIZER { 0 }
+
+int pthread_create (pthread_t *, void *(*start) (void *), void *arg);
+void pthread_exit (void *retval) NO_RETURN;
+int pthread_join (pthread_t, void **retval);
+
+int pthread_mutex_init (pthread_mutex_t *);
+int pthread_mutex_lock (pthread_mutex_t *);
+int pthread_mutex_trylock (pthread_mutex_t *);
+int pthread_mutex_unlock (pthread_mutex_t *);
+
+int pthread_cond_init (pthread_cond_t *);
+int pthread_cond_wait (pthread_cond_t *, pthread_mutex_t *);
+int pthread_cond_signal (pthread_cond_t *);
+int pthread_cond_broadcast (pthread_cond_t *);
+
+#endif /* lib/user/pthread.h */
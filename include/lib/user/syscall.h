@@ -4,11 +4,17 @@
 #include <stdbool.h>
 #include <debug.h>
 #include <stddef.h>
+#include <sched.h>
+#include <time.h>
 
 /* Process identifier. */
 typedef int pid_t;
 #define PID_ERROR ((pid_t) -1)
 
+/* Thread identifier. */
+typedef int tid_t;
+#define TID_ERROR ((tid_t) -1)
+
 /* Map region identifier. */
 typedef int off_t;
 #define MAP_FAILED ((void *) NULL)
@@ -50,6 +56,20 @@ bool isdir (int fd);
 int inumber (int fd);
 int symlink (const char* target, const char* linkpath);
 
+/* Scheduler extensions. */
+bool sched_stats (int scope, struct sched_stats *stats);
+int clock_gettime (int clock_id, struct timespec *ts);
+int sched_setdeadline (const struct sched_deadline *dl);
+void trace_dump (void);
+
+/* Threads.  ENTRY must end by calling thread_exit(), not return.
+   See <pthread.h> for a friendlier interface. */
+tid_t thread_create (void (*entry) (void *, void *), void *arg0, void *arg1);
+void thread_exit (int status) NO_RETURN;
+int thread_join (tid_t, int *status);
+int futex_wait (int *uaddr, int val);
+int futex_wake (int *uaddr, int cnt);
+
 static inline void* get_phys_addr (void *user_addr) {
 	void* pa;
 	asm volatile ("movq %0, %%rax" ::"r"(user_addr));
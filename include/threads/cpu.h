@@ -0,0 +1,70 @@
+#ifndef THREADS_CPU_H
+#define THREADS_CPU_H
+
+#include <list.h>
+#include <rbtree.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Maximum number of CPUs. */
+#define NCPU_MAX 8
+
+/* Run queue of threads in THREAD_READY state, that is, threads
+   that are ready to run but not actually running.
+
+   There is one FIFO list per priority level plus a bitmap whose
+   bit N is set iff queues[N] is nonempty, so that inserting a
+   thread, removing it, and finding the highest-priority ready
+   thread are all constant time.  The priority scheduler and the
+   MLFQS both schedule out of this structure.
+
+   Threads in the deadline class are kept apart, in order of
+   absolute deadline, and always run first.  The fair-share
+   scheduler ("-fair") keeps the other threads in a red-black
+   tree ordered by virtual runtime instead of by priority. */
+struct run_queue
+{
+	struct list dl_queue;			 /* Deadline class, earliest first. */
+	struct list queues[PRI_MAX + 1]; /* One FIFO per priority. */
+	uint64_t bitmap;				 /* Bit N set: queues[N] nonempty. */
+	struct rb_tree fair_tree;		 /* Fair-share scheduler, by vruntime. */
+	int64_t min_vruntime;			 /* Floor for vruntimes in fair_tree. */
+	long fair_weight;				 /* Total weight of threads in fair_tree. */
+	size_t cnt;						 /* Total number of ready threads. */
+};
+
+/* Per-CPU scheduler state.  Each CPU schedules out of its own
+   run queue; a CPU whose queue runs dry steals from the busiest
+   other CPU before falling back to its idle thread. */
+struct cpu
+{
+	int id;						/* Index in cpus[]. */
+	uint8_t apic_id;			/* Local APIC ID. */
+	bool online;				/* Started and scheduling? */
+	struct spinlock rq_lock;	/* Protects RQ. */
+	struct run_queue rq;		/* Ready threads. */
+	struct thread *curr;		/* Running thread. */
+	volatile tid_t running;		/* CURR's tid, read by lock_spin(). */
+	struct thread *idle_thread; /* Runs when RQ is empty. */
+	unsigned thread_ticks;		/* # of timer ticks since last yield. */
+	struct thread *fpu_owner;	/* Thread whose state is in the FPU. */
+	uint64_t *pml4;				/* Page map loaded in CR3. */
+	volatile bool tlb_flush;	/* TLB flush requested by another CPU. */
+
+	/* Statistics. */
+	long long idle_ticks;	/* # of timer ticks spent idle. */
+	long long kernel_ticks; /* # of timer ticks in kernel threads. */
+	long long user_ticks;	/* # of timer ticks in user programs. */
+	long long steals;		/* # of threads stolen from other CPUs. */
+	long long lock_spins;	/* # of adaptive locks taken by spinning. */
+};
+
+extern struct cpu cpus[NCPU_MAX];
+extern int ncpu;
+
+struct cpu *this_cpu(void);
+
+#endif /* threads/cpu.h */
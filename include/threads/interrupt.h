@@ -14,6 +14,9 @@ enum intr_level intr_get_level (void);
 enum intr_level intr_set_level (enum intr_level);
 enum intr_level intr_enable (void);
 enum intr_level intr_disable (void);
+void intr_unlock (void);
+enum intr_level intr_disable_local (void);
+void intr_restore_local (enum intr_level);
 
 /* Interrupt stack frame. */
 struct gp_registers {
@@ -66,6 +69,7 @@ struct intr_frame {
 typedef void intr_handler_func (struct intr_frame *);
 
 void intr_init (void);
+void intr_init_ap (void);
 void intr_register_ext (uint8_t vec, intr_handler_func *, const char *name);
 void intr_register_int (uint8_t vec, int dpl, enum intr_level,
                         intr_handler_func *, const char *name);
@@ -1,6 +1,7 @@
 #ifndef THREADS_PALLOC_H
 #define THREADS_PALLOC_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
 
@@ -11,6 +12,24 @@ enum palloc_flags {
 	PAL_USER = 004              /* User page. */
 };
 
+/* Pool blocks are 2**0 to 2**(PAL_ORDERS - 1) pages. */
+#define PAL_ORDERS 16
+
+/* Page pool statistics. */
+struct palloc_stats {
+	size_t page_cnt;                    /* Pages in pool. */
+	size_t free_pages;                  /* Pages free, including cached
+	                                       and zeroed ones. */
+	size_t free_blocks[PAL_ORDERS];     /* Free blocks of each order. */
+	size_t cached_pages;                /* Free pages in CPU magazines. */
+	long long mag_hits;                 /* Allocations served by magazines. */
+	long long mag_refills;              /* Magazine refills from the pool. */
+	long long mag_drains;               /* Magazine drains to the pool. */
+	size_t zeroed_pages;                /* Free pages zeroed ahead. */
+	long long zero_reqs;                /* PAL_ZERO allocations. */
+	long long zero_hits;                /* ...served by zeroed pages. */
+};
+
 /* Maximum number of pages to put in user pool. */
 extern size_t user_page_limit;
 
@@ -19,5 +38,9 @@ void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
+void palloc_get_stats (bool user, struct palloc_stats *);
+void palloc_drain_magazines (void);
+bool palloc_zero_idle (void);
+void palloc_print_stats (void);
 
 #endif /* threads/palloc.h */
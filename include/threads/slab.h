@@ -0,0 +1,28 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <stddef.h>
+
+/* Constructor run on each object of a new slab.  Objects are
+   expected to be back in their constructed state when freed, so
+   it does not run again when an object is reused. */
+typedef void kmem_ctor (void *obj);
+
+/* Object cache statistics. */
+struct kmem_cache_stats {
+	size_t obj_size;            /* Size of each object, as created. */
+	size_t objs_per_slab;       /* Objects that fit in a slab page. */
+	size_t slabs;               /* Slab pages held. */
+	size_t live;                /* Objects allocated and not freed. */
+	long long allocs;           /* Allocations ever made. */
+};
+
+void kmem_cache_init (void);
+struct kmem_cache *kmem_cache_create (const char *name, size_t size,
+		kmem_ctor *);
+void *kmem_cache_alloc (struct kmem_cache *) __attribute__ ((malloc));
+void kmem_cache_free (struct kmem_cache *, void *);
+void kmem_cache_get_stats (struct kmem_cache *, struct kmem_cache_stats *);
+void kmem_cache_print_stats (void);
+
+#endif /* threads/slab.h */
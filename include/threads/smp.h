@@ -0,0 +1,24 @@
+#ifndef THREADS_SMP_H
+#define THREADS_SMP_H
+
+/* Physical address at which application processors start, in
+   real mode.  Must be page-aligned and below 1 MB, and is never
+   handed out by the page allocator. */
+#define SMP_TRAMPOLINE 0x8000
+
+#ifndef __ASSEMBLER__
+#include <stdint.h>
+
+struct cpu;
+
+/* Set by the kernel command-line option "-maxcpus". */
+extern int smp_max_cpus;
+
+void smp_init (void);
+void smp_send_resched (struct cpu *);
+void smp_broadcast (uint8_t vec);
+void smp_tlb_shootdown (uint64_t *pml4);
+void smp_tlb_flush (void);
+#endif
+
+#endif /* threads/smp.h */
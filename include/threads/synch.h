@@ -3,16 +3,70 @@
 
 #include <list.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
-/* A counting semaphore. */
+/* Element of a priority wait queue, embedded in the waiting
+   thread.  Elements form a pairing heap: each one points to its
+   leftmost child and to its siblings. */
+struct wait_elem
+{
+	struct wait_elem *child;  /* Leftmost child. */
+	struct wait_elem *next;	  /* Right sibling. */
+	struct wait_elem *prev;	  /* Left sibling, or parent if leftmost. */
+	struct wait_queue *queue; /* Queue we are on, or NULL. */
+	int priority;			  /* Priority we are queued at. */
+	uint64_t seq;			  /* Arrival order among equal priorities. */
+};
+
+/* Priority wait queue.  Wakes the highest-priority waiter first
+   and waiters of equal priority in arrival order. */
+struct wait_queue
+{
+	struct wait_elem *root; /* Highest-priority waiter. */
+	uint64_t seq;			/* Next arrival number. */
+};
+
+/* Converts pointer to wait element ELEM into a pointer to the
+   structure that ELEM is embedded inside. */
+#define waitq_entry(ELEM, STRUCT, MEMBER) \
+	((STRUCT *)((uint8_t *)(ELEM) - offsetof(STRUCT, MEMBER)))
+
+void waitq_init(struct wait_queue *);
+bool waitq_empty(const struct wait_queue *);
+void waitq_push(struct wait_queue *, struct wait_elem *, int priority);
+struct wait_elem *waitq_peek(const struct wait_queue *);
+struct wait_elem *waitq_pop(struct wait_queue *);
+void waitq_remove(struct wait_elem *);
+void waitq_reprioritize(struct wait_elem *, int priority);
+void waitq_pop_all(struct wait_queue *, void (*func)(struct wait_elem *));
+
+/* A counting semaphore.
+
+   COUNT holds the value shifted left by one, with the low bit
+   set while WAITERS may be nonempty, so that down and up can run
+   as a single compare-and-swap when nobody is waiting.  Use
+   sema_value() to read the value. */
 struct semaphore
 {
-	unsigned value;		 /* Current value. */
-	struct list waiters; /* List of waiting threads. */
+	unsigned count;				/* Value << 1 | SEMA_WAITERS. */
+	struct wait_queue waiters;	/* Waiting threads. */
 };
 
+#define SEMA_WAITERS 1u /* Low bit of `count': threads may be waiting. */
+#define SEMA_ONE 2u		/* One unit of the value in `count'. */
+
+/* Returns SEMA's value.  The value may change as soon as this
+   returns unless interrupts are off and no other CPU uses SEMA. */
+static inline unsigned
+sema_value(const struct semaphore *sema)
+{
+	return __atomic_load_n(&sema->count, __ATOMIC_RELAXED) / SEMA_ONE;
+}
+
 void sema_init(struct semaphore *, unsigned value);
 void sema_down(struct semaphore *);
+bool sema_down_timeout(struct semaphore *, int64_t ticks);
 bool sema_try_down(struct semaphore *);
 void sema_up(struct semaphore *);
 void sema_self_test(void);
@@ -21,10 +75,21 @@ void sema_self_test(void);
 struct lock
 {
 	struct thread *holder;		/* Thread holding lock (for debugging). */
+	int holder_tid;				/* HOLDER's tid, or -1 if none. */
+	int holder_cpu;				/* CPU that HOLDER took the lock on. */
 	struct semaphore semaphore; /* Binary semaphore controlling access. */
+	bool adaptive;				/* Spin before blocking? */
+	int max_priority;			/* Highest priority among waiters. */
+	int heap_idx;				/* Index in holder's held_locks, or -1. */
+	struct list_elem held_elem; /* In holder's held_overflow. */
 };
 
+/* Maximum number of iterations an adaptive lock spins while its
+   holder is running on another CPU. */
+#define LOCK_SPIN_LIMIT 1000
+
 void lock_init(struct lock *);
+void lock_init_adaptive(struct lock *);
 void lock_acquire(struct lock *);
 bool lock_try_acquire(struct lock *);
 void lock_release(struct lock *);
@@ -33,7 +98,7 @@ bool lock_held_by_current_thread(const struct lock *);
 /* Condition variable. */
 struct condition
 {
-	struct list waiters; /* List of waiting threads. */
+	struct wait_queue waiters; /* Waiting threads. */
 };
 
 void cond_init(struct condition *);
@@ -41,6 +106,35 @@ void cond_wait(struct condition *, struct lock *);
 void cond_signal(struct condition *, struct lock *);
 void cond_broadcast(struct condition *, struct lock *);
 
+/* Reader-writer lock. */
+struct rwlock
+{
+	struct lock lock;			/* Held by writers; briefly by readers. */
+	struct semaphore drained;	/* Upped when the last reader leaves. */
+	unsigned readers;			/* Number of readers holding the lock. */
+	bool draining;				/* A writer is waiting on `drained'. */
+	struct list reader_list;	/* Readers, by thread read_elem. */
+};
+
+void rwlock_init(struct rwlock *);
+void rwlock_acquire_read(struct rwlock *);
+void rwlock_release_read(struct rwlock *);
+void rwlock_acquire_write(struct rwlock *);
+void rwlock_release_write(struct rwlock *);
+bool rwlock_held_by_current_thread(const struct rwlock *);
+
+/* Spinlock.  Provides mutual exclusion against other CPUs; the
+   holder must also keep interrupts disabled so that it cannot be
+   preempted on its own CPU while holding it. */
+struct spinlock
+{
+	volatile uint32_t locked; /* Nonzero while held. */
+};
+
+void spinlock_init(struct spinlock *);
+void spin_lock(struct spinlock *);
+void spin_unlock(struct spinlock *);
+
 /* Optimization barrier.
  *
  * The compiler will not reorder operations across an
@@ -3,13 +3,18 @@
 
 #include <debug.h>
 #include <list.h>
+#include <rbtree.h>
 #include <stdint.h>
+#include <sched.h>
 #include "threads/interrupt.h"
 #include "threads/synch.h"
 #ifdef VM
 #include "vm/vm.h"
 #endif
 
+struct cpu;
+struct thread_group;
+
 /* States in a thread's life cycle. */
 enum thread_status
 {
@@ -30,6 +35,7 @@ typedef int tid_t;
 #define PRI_MAX 63	   /* Highest priority. */
 
 #define NESTED_DEPTH 8
+#define HELD_LOCKS_MAX 16 /* Size of a thread's held-lock heap. */
 
 #define FDT_LIMIT (1 << 9) * 3
 
@@ -84,12 +90,11 @@ typedef int tid_t;
  * the `magic' member of the running thread's `struct thread' is
  * set to THREAD_MAGIC.  Stack overflow will normally change this
  * value, triggering the assertion. */
-/* The `elem' member has a dual purpose.  It can be an element in
- * the run queue (thread.c), or it can be an element in a
- * semaphore wait list (synch.c).  It can be used these two ways
- * only because they are mutually exclusive: only a thread in the
- * ready state is on the run queue, whereas only a thread in the
- * blocked state is on a semaphore wait list. */
+/* The `elem' member is an element in the run queue (thread.c).
+ * A thread waiting on a semaphore or condition variable is
+ * instead on that object's priority wait queue through
+ * `wait_elem' (synch.c), which lets its position be adjusted
+ * when its priority changes through donation. */
 struct thread
 {
 	/* Owned by thread.c. */
@@ -100,18 +105,24 @@ struct thread
 
 	/* Shared between thread.c and synch.c. */
 	struct list_elem elem; /* List element. */
+	struct cpu *cpu;	   /* CPU running or queueing this thread. */
 
 	/**************** project 1: threads *******************/
-	int64_t wakeup_tick;
-
 	int init_priority;
 
 	struct lock *wait_on_lock;
-	struct list donations;
-	struct list_elem donation_elem;
+	uint8_t wait_reason;					 /* Why blocked, for tracing (trace.h). */
+	struct wait_elem wait_elem;				 /* Semaphore or condition wait queue. */
+	struct lock *held_locks[HELD_LOCKS_MAX]; /* Max-heap of contended locks held. */
+	int held_cnt;							 /* Number of entries in held_locks. */
+	struct list held_overflow;				 /* Those beyond HELD_LOCKS_MAX. */
+	struct rwlock *reading;					 /* rwlock held for reading, or null. */
+	struct list_elem read_elem;				 /* In reading->reader_list. */
+	struct lock read_donation;				 /* Carries a writer's donation. */
 
 	int nice;
 	int recent_cpu;
+	int64_t recent_cpu_sec; /* Second recent_cpu was last decayed. */
 	struct list_elem all_elem;
 
 	/**************** project 2: userprog *******************/
@@ -133,13 +144,17 @@ struct thread
 
 	struct file *run_file;
 
+	/* Owned by userprog/process.c. */
+	struct thread_group *group;	  /* Threads of our process, or NULL. */
+	struct list_elem member_elem; /* Element in group's members. */
+	int stack_slot;				  /* User stack slot, or -1 if main thread. */
+	bool joined;				  /* Claimed by a joiner or the reaper? */
+
 	/**************** project 3: virtual memory *******************/
 	uintptr_t user_rsp;
 	void *start_address;
 	struct list mmap_list;
 
-	struct list mmap_list;
-
 #ifdef USERPROG
 	/* Owned by userprog/process.c. */
 	uint64_t *pml4; /* Page map level 4 */
@@ -149,8 +164,33 @@ struct thread
 	struct supplemental_page_table spt;
 #endif
 
+	/* Owned by threads/fpu.c. */
+	void *fpu_area; /* Saved FPU/SSE state, or NULL if never used. */
+
 	/* Owned by thread.c. */
+	struct sched_stats sched; /* Scheduler statistics. */
+	uint64_t ready_tsc;		  /* TSC when last made ready. */
+	uint64_t run_tsc;		  /* TSC when last switched to. */
+	bool preempted;			  /* Yielding because of preemption? */
+
+	/* Deadline class (thread_set_deadline()).  Times in ns. */
+	int64_t dl_runtime;		 /* Budget per period, or 0 if not in the class. */
+	int64_t dl_deadline;	 /* Relative deadline. */
+	int64_t dl_period;		 /* Period. */
+	int64_t dl_budget;		 /* Budget left. */
+	int64_t dl_abs;			 /* Absolute scheduling deadline. */
+	int64_t dl_job_deadline; /* Deadline of the current job at its release. */
+	int64_t dl_charged;		 /* When the budget was last charged. */
+	bool dl_throttled;		 /* Blocked until the next period? */
+
+	/* Fair-share scheduler ("-fair").  Times in ns. */
+	struct rb_elem fair_elem; /* Element in the run queue's fair_tree. */
+	int64_t vruntime;		  /* Run time, weighted by nice. */
+	int64_t exec_start;		  /* When last charged to vruntime. */
+	int64_t slice_start;	  /* When last switched to. */
+
 	struct intr_frame tf; /* Information for switching */
+	uint64_t switch_rsp;  /* Saved stack pointer while switched out. */
 	unsigned magic;		  /* Detects stack overflow. */
 };
 
@@ -169,10 +209,18 @@ struct mmap_file {
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
+/* If true, use the fair-share scheduler.
+   Controlled by kernel command-line option "-fair". */
+extern bool thread_fair;
+
 void thread_init(void);
 void thread_start(void);
+struct thread *thread_init_cpu(int id, uint8_t apic_id);
+void thread_start_cpu(void);
+bool thread_cpus_idle(void);
 
 void thread_tick(void);
+void thread_account_idle(int64_t n);
 void thread_print_stats(void);
 
 typedef void thread_func(void *aux);
@@ -187,11 +235,16 @@ const char *thread_name(void);
 
 void thread_exit(void) NO_RETURN;
 void thread_yield(void);
+void thread_preempt(void);
+void thread_get_sched_stats(int scope, struct sched_stats *);
+bool thread_set_deadline(const struct sched_deadline *);
 
 int thread_get_priority(void);
 void thread_set_priority(int);
 
 void donate_priority(void);
+void donate_priority_to(struct thread *holder, struct lock *lock, int priority);
+void add_held_lock(struct lock *lock);
 void remove_with_lock(struct lock *lock);
 void refresh_priority(void);
 
@@ -209,10 +262,8 @@ int thread_get_load_avg(void);
 
 void do_iret(struct intr_frame *tf);
 
-void thread_sleep(int64_t ticks);
-void thread_awake(int64_t ticks);
-void update_next_tick_to_awake(int64_t ticks);
-int64_t get_next_tick_to_awake(void);
+void thread_sleep(int64_t wakeup);
+void thread_sleep_ns(int64_t wakeup);
 void test_max_priority(void);
 bool cmp_priority(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED);
 
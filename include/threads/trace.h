@@ -0,0 +1,58 @@
+#ifndef THREADS_TRACE_H
+#define THREADS_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Scheduler event types. */
+enum trace_type {
+	TRACE_SWITCH_IN = 1,    /* Thread starts running; AUX: previous tid. */
+	TRACE_SWITCH_OUT,       /* Thread stops running; ARG: its new status. */
+	TRACE_BLOCK,            /* Thread blocks; ARG: TRACE_WAIT_*. */
+	TRACE_UNBLOCK,          /* Thread made ready; AUX: waker's tid. */
+	TRACE_DONATE,           /* Priority donated; ARG: priority, AUX: donor. */
+	TRACE_PRIORITY,         /* Priority changed; ARG: new, AUX: old. */
+	TRACE_CREATE,           /* Thread created; AUX: creator's tid. */
+};
+
+/* Why a thread blocked. */
+enum trace_wait {
+	TRACE_WAIT_OTHER,       /* Called thread_block() directly. */
+	TRACE_WAIT_SEMA,        /* Semaphore. */
+	TRACE_WAIT_LOCK,        /* Lock. */
+	TRACE_WAIT_COND,        /* Condition variable. */
+	TRACE_WAIT_SLEEP,       /* timer_sleep(). */
+	TRACE_WAIT_DISK,        /* Disk I/O completion. */
+	TRACE_WAIT_THROTTLE,    /* Deadline class budget used up. */
+};
+
+/* One recorded event, as dumped. */
+struct trace_event {
+	uint64_t tsc;           /* Time-stamp counter. */
+	int32_t tid;            /* Thread the event is about. */
+	uint8_t type;           /* TRACE_* event type. */
+	uint8_t arg;            /* Type-specific. */
+	uint32_t aux;           /* Type-specific. */
+} __attribute__((packed));
+
+/* Set by the kernel command-line option "-trace". */
+extern bool trace_enabled;
+
+/* Key, Ctrl+T, that dumps the trace when typed on the keyboard or
+   the serial port. */
+#define TRACE_DUMP_KEY 0x14
+
+void trace_init (void);
+void trace_record (enum trace_type, int tid, int arg, int aux);
+void trace_name (int tid, const char *name);
+void trace_dump (void);
+bool trace_request_dump (void);
+
+/* Records an event if tracing is enabled. */
+static inline void
+trace_event (enum trace_type type, int tid, int arg, int aux) {
+	if (trace_enabled)
+		trace_record (type, tid, arg, aux);
+}
+
+#endif /* threads/trace.h */
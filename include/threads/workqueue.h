@@ -0,0 +1,53 @@
+#ifndef THREADS_WORKQUEUE_H
+#define THREADS_WORKQUEUE_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "devices/timer.h"
+
+/* Function run by a worker thread for a queued work item.  Runs
+   in a kernel thread, so unlike a timeout callback it may
+   sleep. */
+typedef void work_func (void *aux);
+
+/* A deferred work item. */
+struct work {
+	work_func *func;            /* Function to run. */
+	void *aux;                  /* Argument passed to FUNC. */
+	struct workqueue *wq;       /* Queue it was last queued on. */
+	bool pending;               /* Queued and not yet started? */
+	struct list_elem elem;      /* Element in the queue's list. */
+};
+
+/* A work item that is queued after a delay. */
+struct delayed_work {
+	struct work work;
+	struct timeout timer;       /* Queues WORK when it expires. */
+};
+
+/* Shared queue served by "-kworkers" worker threads. */
+extern struct workqueue *system_wq;
+extern int system_wq_workers;
+
+void workqueue_init (void);
+struct workqueue *workqueue_create (const char *name, int workers,
+                                    int priority);
+
+void work_init (struct work *, work_func *, void *aux);
+void delayed_work_init (struct delayed_work *, work_func *, void *aux);
+
+bool queue_work (struct workqueue *, struct work *);
+bool queue_delayed_work (struct workqueue *, struct delayed_work *,
+                         int64_t ticks);
+bool schedule_work (struct work *);
+bool schedule_delayed_work (struct delayed_work *, int64_t ticks);
+
+void flush_work (struct work *);
+void flush_workqueue (struct workqueue *);
+bool cancel_work (struct work *);
+bool cancel_delayed_work (struct delayed_work *);
+
+void workqueue_print_stats (void);
+
+#endif /* threads/workqueue.h */
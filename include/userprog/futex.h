@@ -0,0 +1,10 @@
+#ifndef USERPROG_FUTEX_H
+#define USERPROG_FUTEX_H
+
+struct thread_group;
+
+int futex_wait (const int *uaddr, int val);
+int futex_wake (const int *uaddr, int cnt);
+void futex_wake_all (struct thread_group *);
+
+#endif /* userprog/futex.h */
@@ -3,6 +3,11 @@
 
 #include "threads/loader.h"
 
+/* Selector of the TSS of CPU number ID.  A TSS descriptor takes
+   two GDT entries; CPU 0's is at SEL_TSS. */
+#define SEL_TSS_CPU(ID) (SEL_TSS + 16 * (ID))
+
 void gdt_init (void);
+void gdt_init_ap (void);
 
 #endif /* userprog/gdt.h */
@@ -1,6 +1,9 @@
 #ifndef USERPROG_PROCESS_H
 #define USERPROG_PROCESS_H
 
+#include <list.h>
+#include <stdint.h>
+#include "threads/synch.h"
 #include "threads/thread.h"
 
 struct file_info
@@ -11,8 +14,41 @@ struct file_info
     uint32_t page_zero_bytes;
 };
 
+/* Object cache for struct file_info (vm/file.c). */
+extern struct kmem_cache *file_info_cache;
+
+/* The threads of a process beyond its main thread, which are
+   created with process_thread_create() and share the main
+   thread's page tables, SPT, mmaps and fd table.  Allocated the
+   first time the process creates a thread or uses a futex, and
+   freed when the process exits or execs. */
+struct thread_group
+{
+	struct thread *leader;	 /* Main thread, owner of the shared state. */
+	struct lock lock;		 /* Protects the members below. */
+	struct list members;	 /* Other threads, through member_elem. */
+	struct condition reaped; /* Signaled when a member is reaped. */
+	struct list futexes;	 /* Threads in futex_wait() (futex.c). */
+	uint32_t stack_slots;	 /* Bit N set: stack slot N in use. */
+	bool exiting;			 /* Set when members must exit. */
+	struct lock fd_lock;	 /* Protects the leader's fd table. */
+	struct lock mmap_lock;	 /* Protects the leader's mmap_list. */
+};
+
+struct thread *process_current(void);
+struct thread_group *process_group(void);
+bool process_exiting(void);
+void process_stack_bounds(uintptr_t *bottom, uintptr_t *top);
+bool process_terminate(int status);
+void process_lock_files(void);
+void process_unlock_files(void);
+void process_lock_mmaps(void);
+void process_unlock_mmaps(void);
+
 int process_add_file(struct file *f);
 struct file *process_get_file(int fd);
+struct file *process_pin_file(int fd);
+void process_unpin_file(struct file *f);
 
 tid_t process_create_initd(const char *file_name);
 tid_t process_fork(const char *name, struct intr_frame *if_);
@@ -21,22 +57,14 @@ int process_wait(tid_t);
 void process_exit(void);
 void process_activate(struct thread *next);
 
+tid_t process_thread_create(uintptr_t entry, uint64_t arg0, uint64_t arg1);
+bool process_thread_join(tid_t, int *status);
+
 
 /********* project 3 ***********/
 bool lazy_load_segment(struct page *page, void *aux);
 
 
-struct file_info
-{
-	struct file *file;
-	off_t ofs;
-	uint32_t page_read_bytes;
-	uint32_t page_zero_bytes;
-
-    /* mmap */
-    // struct list mmap_list;
-    // struct list_elem mmap_elem;
-};
 
 
 
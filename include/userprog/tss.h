@@ -25,6 +25,7 @@ struct task_state {
 struct task_state;
 void tss_init (void);
 struct task_state *tss_get (void);
+struct task_state *tss_get_cpu (int id);
 void tss_update (struct thread *next);
 
 #endif /* userprog/tss.h */
@@ -3,6 +3,7 @@
 #include <stdbool.h>
 #include <hash.h>
 #include "threads/palloc.h"
+#include "threads/synch.h"
 
 enum vm_type
 {
@@ -50,6 +51,7 @@ struct page
 
 	/* Your implementation */
 	bool writable;
+	bool claiming;		 /* Being read in by vm_do_claim_page(). */
 
 	/* spt 관련  */
 	struct hash_elem hash_elem;
@@ -85,7 +87,6 @@ struct frame
 	struct list_elem frame_elem;
 	// struct semaphore change;
 };
-struct list frame_list;
 
 /* The function table for page operations.
  * This is one way of implementing "interface" in C.
@@ -113,14 +114,8 @@ struct page_operations
 struct supplemental_page_table
 {
 	struct hash table;
-};
-
-struct mmap_file
-{
-	int map_id;
-	struct file *file;
-	struct list_elem elem;
-	struct list page_list;
+	struct lock lock; /* Serializes the threads of a process. */
+	struct condition claimed; /* Signaled when a claim finishes. */
 };
 
 #include "threads/thread.h"
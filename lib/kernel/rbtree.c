@@ -0,0 +1,306 @@
+/* Red-black tree.
+
+   See rbtree.h for basic information.  The algorithms are those
+   of Cormen, Leiserson, Rivest and Stein, "Introduction to
+   Algorithms", chapter 13, with null pointers as the leaves. */
+
+#include "rbtree.h"
+#include "../debug.h"
+
+static void rotate_left (struct rb_tree *, struct rb_elem *);
+static void rotate_right (struct rb_tree *, struct rb_elem *);
+static void replace_child (struct rb_tree *, struct rb_elem *old,
+		struct rb_elem *new);
+static void insert_fixup (struct rb_tree *, struct rb_elem *);
+static void remove_fixup (struct rb_tree *, struct rb_elem *,
+		struct rb_elem *parent);
+
+/* Returns true if E is a red element.  Leaves are black. */
+static inline bool
+is_red (const struct rb_elem *e) {
+	return e != NULL && e->red;
+}
+
+/* Returns the smallest element in the subtree rooted at E. */
+static struct rb_elem *
+subtree_min (struct rb_elem *e) {
+	while (e->left != NULL)
+		e = e->left;
+	return e;
+}
+
+/* Initializes TREE as an empty tree that compares elements
+   using LESS, given auxiliary data AUX. */
+void
+rb_init (struct rb_tree *tree, rb_less_func *less, void *aux) {
+	ASSERT (tree != NULL);
+	ASSERT (less != NULL);
+
+	tree->root = NULL;
+	tree->first = NULL;
+	tree->size = 0;
+	tree->less = less;
+	tree->aux = aux;
+}
+
+/* Inserts E into TREE, after any elements equal to it. */
+void
+rb_insert (struct rb_tree *tree, struct rb_elem *e) {
+	struct rb_elem **link = &tree->root;
+	struct rb_elem *parent = NULL;
+	bool leftmost = true;
+
+	ASSERT (e != NULL);
+
+	while (*link != NULL) {
+		parent = *link;
+		if (tree->less (e, parent, tree->aux))
+			link = &parent->left;
+		else {
+			link = &parent->right;
+			leftmost = false;
+		}
+	}
+
+	e->parent = parent;
+	e->left = e->right = NULL;
+	e->red = true;
+	*link = e;
+	if (leftmost)
+		tree->first = e;
+	tree->size++;
+
+	insert_fixup (tree, e);
+}
+
+/* Removes E, which must be in TREE, from TREE. */
+void
+rb_remove (struct rb_tree *tree, struct rb_elem *e) {
+	struct rb_elem *child, *parent;
+	bool removed_red;
+
+	ASSERT (e != NULL);
+	ASSERT (tree->size > 0);
+
+	if (tree->first == e)
+		tree->first = rb_next (e);
+
+	if (e->left == NULL || e->right == NULL) {
+		/* E has at most one child, which takes its place. */
+		child = e->left != NULL ? e->left : e->right;
+		parent = e->parent;
+		removed_red = e->red;
+		replace_child (tree, e, child);
+	} else {
+		/* E's successor, which has no left child, takes its
+		   place, and the successor's right child takes the
+		   successor's. */
+		struct rb_elem *next = subtree_min (e->right);
+
+		removed_red = next->red;
+		child = next->right;
+		if (next->parent == e)
+			parent = next;
+		else {
+			parent = next->parent;
+			replace_child (tree, next, child);
+			next->right = e->right;
+			next->right->parent = next;
+		}
+		replace_child (tree, e, next);
+		next->left = e->left;
+		next->left->parent = next;
+		next->red = e->red;
+	}
+	tree->size--;
+
+	if (!removed_red)
+		remove_fixup (tree, child, parent);
+}
+
+/* Returns the smallest element in TREE, or a null pointer if
+   TREE is empty. */
+struct rb_elem *
+rb_first (const struct rb_tree *tree) {
+	return tree->first;
+}
+
+/* Returns the element that follows E in its tree, or a null
+   pointer if E is the largest element. */
+struct rb_elem *
+rb_next (const struct rb_elem *e) {
+	if (e->right != NULL)
+		return subtree_min (e->right);
+	while (e->parent != NULL && e == e->parent->right)
+		e = e->parent;
+	return e->parent;
+}
+
+/* Returns the number of elements in TREE. */
+size_t
+rb_size (const struct rb_tree *tree) {
+	return tree->size;
+}
+
+/* Returns true if TREE contains no elements, false otherwise. */
+bool
+rb_empty (const struct rb_tree *tree) {
+	return tree->size == 0;
+}
+
+/* Makes NEW take OLD's place as a child of OLD's parent, or as
+   the root of TREE.  NEW may be null. */
+static void
+replace_child (struct rb_tree *tree, struct rb_elem *old,
+		struct rb_elem *new) {
+	if (old->parent == NULL)
+		tree->root = new;
+	else if (old == old->parent->left)
+		old->parent->left = new;
+	else
+		old->parent->right = new;
+	if (new != NULL)
+		new->parent = old->parent;
+}
+
+/* Rotates the subtree rooted at E to the left, so that E's right
+   child takes its place. */
+static void
+rotate_left (struct rb_tree *tree, struct rb_elem *e) {
+	struct rb_elem *r = e->right;
+
+	e->right = r->left;
+	if (r->left != NULL)
+		r->left->parent = e;
+	replace_child (tree, e, r);
+	r->left = e;
+	e->parent = r;
+}
+
+/* Rotates the subtree rooted at E to the right, so that E's left
+   child takes its place. */
+static void
+rotate_right (struct rb_tree *tree, struct rb_elem *e) {
+	struct rb_elem *l = e->left;
+
+	e->left = l->right;
+	if (l->right != NULL)
+		l->right->parent = e;
+	replace_child (tree, e, l);
+	l->right = e;
+	e->parent = l;
+}
+
+/* Restores the red-black properties after red element E was
+   inserted. */
+static void
+insert_fixup (struct rb_tree *tree, struct rb_elem *e) {
+	struct rb_elem *parent;
+
+	while ((parent = e->parent) != NULL && parent->red) {
+		/* A red parent is not the root, so E has a grandparent. */
+		struct rb_elem *grand = parent->parent;
+
+		if (parent == grand->left) {
+			struct rb_elem *uncle = grand->right;
+
+			if (is_red (uncle)) {
+				parent->red = uncle->red = false;
+				grand->red = true;
+				e = grand;
+				continue;
+			}
+			if (e == parent->right) {
+				rotate_left (tree, parent);
+				e = parent;
+				parent = e->parent;
+			}
+			parent->red = false;
+			grand->red = true;
+			rotate_right (tree, grand);
+		} else {
+			struct rb_elem *uncle = grand->left;
+
+			if (is_red (uncle)) {
+				parent->red = uncle->red = false;
+				grand->red = true;
+				e = grand;
+				continue;
+			}
+			if (e == parent->left) {
+				rotate_right (tree, parent);
+				e = parent;
+				parent = e->parent;
+			}
+			parent->red = false;
+			grand->red = true;
+			rotate_left (tree, grand);
+		}
+	}
+	tree->root->red = false;
+}
+
+/* Restores the red-black properties after a black element was
+   removed from between PARENT and its child E, which may be
+   null, leaving every path through E one black element short. */
+static void
+remove_fixup (struct rb_tree *tree, struct rb_elem *e,
+		struct rb_elem *parent) {
+	while (e != tree->root && !is_red (e)) {
+		if (e == parent->left) {
+			struct rb_elem *sibling = parent->right;
+
+			if (sibling->red) {
+				sibling->red = false;
+				parent->red = true;
+				rotate_left (tree, parent);
+				sibling = parent->right;
+			}
+			if (!is_red (sibling->left) && !is_red (sibling->right)) {
+				sibling->red = true;
+				e = parent;
+				parent = e->parent;
+			} else {
+				if (!is_red (sibling->right)) {
+					sibling->left->red = false;
+					sibling->red = true;
+					rotate_right (tree, sibling);
+					sibling = parent->right;
+				}
+				sibling->red = parent->red;
+				parent->red = false;
+				sibling->right->red = false;
+				rotate_left (tree, parent);
+				e = tree->root;
+			}
+		} else {
+			struct rb_elem *sibling = parent->left;
+
+			if (sibling->red) {
+				sibling->red = false;
+				parent->red = true;
+				rotate_right (tree, parent);
+				sibling = parent->left;
+			}
+			if (!is_red (sibling->left) && !is_red (sibling->right)) {
+				sibling->red = true;
+				e = parent;
+				parent = e->parent;
+			} else {
+				if (!is_red (sibling->left)) {
+					sibling->right->red = false;
+					sibling->red = true;
+					rotate_left (tree, sibling);
+					sibling = parent->left;
+				}
+				sibling->red = parent->red;
+				parent->red = false;
+				sibling->left->red = false;
+				rotate_right (tree, parent);
+				e = tree->root;
+			}
+		}
+	}
+	if (e != NULL)
+		e->red = false;
+}
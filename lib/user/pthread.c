@@ -0,0 +1,122 @@
+#include <pthread.h>
+#include <limits.h>
+#include <stdint.h>
+#include <syscall.h>
+
+/* Runs in a new thread: calls START_ with ARG and exits with
+   its return value. */
+static void
+pthread_start (void *start_, void *arg) {
+	void *(*start) (void *) = start_;
+
+	pthread_exit (start (arg));
+}
+
+/* Starts a thread that runs START with ARG, storing its id in
+   *THREAD. */
+int
+pthread_create (pthread_t *thread, void *(*start) (void *), void *arg) {
+	tid_t tid = thread_create (pthread_start, start, arg);
+
+	if (tid == TID_ERROR)
+		return -1;
+	*thread = tid;
+	return 0;
+}
+
+/* Exits the calling thread with RETVAL.  In the main thread, exits
+   the whole process. */
+void
+pthread_exit (void *retval) {
+	thread_exit ((int) (intptr_t) retval);
+}
+
+/* Waits for THREAD to exit and, if RETVAL is not null, stores its
+   return value in *RETVAL. */
+int
+pthread_join (pthread_t thread, void **retval) {
+	int status;
+
+	if (thread_join (thread, &status) < 0)
+		return -1;
+	if (retval != NULL)
+		*retval = (void *) (intptr_t) status;
+	return 0;
+}
+
+int
+pthread_mutex_init (pthread_mutex_t *m) {
+	m->state = 0;
+	return 0;
+}
+
+/* Locks M, sleeping on its futex while another thread holds it.
+   This is the three-state mutex of Drepper's "Futexes Are
+   Tricky": unlocking only makes a system call when state 2 says
+   a thread may be asleep. */
+int
+pthread_mutex_lock (pthread_mutex_t *m) {
+	int c = 0;
+
+	if (__atomic_compare_exchange_n (&m->state, &c, 1, false,
+				__ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		return 0;
+
+	if (c != 2)
+		c = __atomic_exchange_n (&m->state, 2, __ATOMIC_ACQUIRE);
+	while (c != 0) {
+		futex_wait (&m->state, 2);
+		c = __atomic_exchange_n (&m->state, 2, __ATOMIC_ACQUIRE);
+	}
+	return 0;
+}
+
+/* Locks M if no thread holds it.  Returns -1 otherwise. */
+int
+pthread_mutex_trylock (pthread_mutex_t *m) {
+	int c = 0;
+
+	return __atomic_compare_exchange_n (&m->state, &c, 1, false,
+			__ATOMIC_ACQUIRE, __ATOMIC_RELAXED) ? 0 : -1;
+}
+
+int
+pthread_mutex_unlock (pthread_mutex_t *m) {
+	if (__atomic_fetch_sub (&m->state, 1, __ATOMIC_RELEASE) != 1) {
+		__atomic_store_n (&m->state, 0, __ATOMIC_RELEASE);
+		futex_wake (&m->state, 1);
+	}
+	return 0;
+}
+
+int
+pthread_cond_init (pthread_cond_t *c) {
+	c->seq = 0;
+	return 0;
+}
+
+/* Unlocks M, sleeps until C is signaled, and locks M again.  As
+   with POSIX, the wait may also end spuriously. */
+int
+pthread_cond_wait (pthread_cond_t *c, pthread_mutex_t *m) {
+	int seq = __atomic_load_n (&c->seq, __ATOMIC_RELAXED);
+
+	pthread_mutex_unlock (m);
+	futex_wait (&c->seq, seq);
+	pthread_mutex_lock (m);
+	return 0;
+}
+
+int
+pthread_cond_signal (pthread_cond_t *c) {
+	__atomic_fetch_add (&c->seq, 1, __ATOMIC_RELEASE);
+	futex_wake (&c->seq, 1);
+	return 0;
+}
+
+int
+pthread_cond_broadcast (pthread_cond_t *c) {
+	__atomic_fetch_add (&c->seq, 1, __ATOMIC_RELEASE);
+	futex_wake (&c->seq, INT_MAX);
+	return 0;
+}
@@ -194,3 +194,49 @@ int
 umount (const char *path) {
 	return syscall1 (SYS_UMOUNT, path);
 }
+
+bool
+sched_stats (int scope, struct sched_stats *stats) {
+	return syscall2 (SYS_SCHED_STATS, scope, stats);
+}
+
+int
+clock_gettime (int clock_id, struct timespec *ts) {
+	return syscall2 (SYS_CLOCK_GETTIME, clock_id, ts);
+}
+
+int
+sched_setdeadline (const struct sched_deadline *dl) {
+	return syscall1 (SYS_SCHED_SETDEADLINE, dl);
+}
+
+void
+trace_dump (void) {
+	syscall0 (SYS_TRACE_DUMP);
+}
+
+tid_t
+thread_create (void (*entry) (void *, void *), void *arg0, void *arg1) {
+	return (tid_t) syscall3 (SYS_THREAD_CREATE, entry, arg0, arg1);
+}
+
+void
+thread_exit (int status) {
+	syscall1 (SYS_THREAD_EXIT, status);
+	NOT_REACHED ();
+}
+
+int
+thread_join (tid_t tid, int *status) {
+	return syscall2 (SYS_THREAD_JOIN, tid, status);
+}
+
+int
+futex_wait (int *uaddr, int val) {
+	return syscall2 (SYS_FUTEX_WAIT, uaddr, val);
+}
+
+int
+futex_wake (int *uaddr, int cnt) {
+	return syscall2 (SYS_FUTEX_WAKE, uaddr, cnt);
+}
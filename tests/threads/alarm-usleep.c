@@ -0,0 +1,67 @@
+/* Sleeps for 500 microseconds, well under a timer tick, 10
+   times in a row, while a lower-priority thread spins counting.
+   Checks that each sleep lasted at least as long as requested
+   and that the sleeps blocked rather than busy-waited, by
+   checking that the spinning thread got to run in between. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define SLEEPS 10
+#define SLEEP_US 500
+
+static struct semaphore done_sema;
+static volatile bool stop;
+static volatile int64_t spins;
+
+static thread_func spinner;
+
+void
+test_alarm_usleep (void) 
+{
+  int64_t spins_before;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  if (!timer_hires ())
+    fail ("no high-resolution timer");
+
+  sema_init (&done_sema, 0);
+  stop = false;
+  spins = 0;
+  thread_create ("spinner", PRI_DEFAULT - 1, spinner, NULL);
+
+  spins_before = spins;
+  for (i = 0; i < SLEEPS; i++)
+    {
+      int64_t start = timer_ns ();
+      int64_t elapsed;
+
+      timer_usleep (SLEEP_US);
+      elapsed = timer_ns () - start;
+      if (elapsed < SLEEP_US * 1000)
+        fail ("sleep %d lasted only %lld ns", i, elapsed);
+    }
+  msg ("All %d sleeps lasted at least %d us.", SLEEPS, SLEEP_US);
+
+  if (spins == spins_before)
+    fail ("lower-priority thread never ran: sleeps busy-waited");
+  msg ("Lower-priority thread ran during the sleeps.");
+
+  stop = true;
+  sema_down (&done_sema);
+}
+
+static void
+spinner (void *aux UNUSED) 
+{
+  while (!stop)
+    spins++;
+  sema_up (&done_sema);
+}
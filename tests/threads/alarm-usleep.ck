@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(alarm-usleep) begin
+(alarm-usleep) All 10 sleeps lasted at least 500 us.
+(alarm-usleep) Lower-priority thread ran during the sleeps.
+(alarm-usleep) end
+EOF
+pass;
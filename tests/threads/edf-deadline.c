@@ -0,0 +1,148 @@
+/* Runs a periodic thread in the deadline class, needing 5 ms of
+   CPU every 100 ms, for 20 periods, under load from two batch
+   threads and from a second deadline-class thread that spins
+   without ever blocking.  Checks that no job misses its deadline,
+   that the spinning thread is throttled to its budget so that
+   the batch threads still get to run, and that admission control
+   turns away a thread that would oversubscribe the CPU. */
+
+#include <stdio.h>
+#include <sched.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define MSEC 1000000LL
+#define JOBS 20
+#define PERIOD_TICKS (TIMER_FREQ / 10)
+#define PERIOD_NS (100 * MSEC)
+#define WORK_NS (5 * MSEC)
+#define BATCH_CNT 2
+
+static struct semaphore done_sema;
+static volatile bool stop;
+
+/* Results, printed by the main thread. */
+static bool periodic_admitted, hog_admitted;
+static struct sched_stats periodic_stats, hog_stats;
+static bool greedy_invalid, greedy_over, greedy_fits, greedy_left;
+static volatile int64_t batch_spins[BATCH_CNT];
+
+static thread_func periodic, hog, greedy, batch;
+
+void
+test_edf_deadline (void) 
+{
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&done_sema, 0);
+  stop = false;
+
+  /* Create everything before any of it runs.  The two
+     deadline-class threads start first and are admitted before
+     the greedy one asks. */
+  thread_set_priority (PRI_MAX);
+  thread_create ("periodic", PRI_DEFAULT + 2, periodic, NULL);
+  thread_create ("hog", PRI_DEFAULT + 2, hog, NULL);
+  thread_create ("greedy", PRI_DEFAULT + 1, greedy, NULL);
+  for (i = 0; i < BATCH_CNT; i++)
+    thread_create ("batch", PRI_DEFAULT + 1, batch, (void *) &batch_spins[i]);
+  for (i = 0; i < 3 + BATCH_CNT; i++)
+    sema_down (&done_sema);
+
+  if (!periodic_admitted || !hog_admitted)
+    fail ("deadline class refused a thread within its bandwidth");
+
+  if (periodic_stats.dl_misses != 0)
+    fail ("%llu of %d jobs missed their deadlines",
+          periodic_stats.dl_misses, JOBS);
+  msg ("%d jobs, no deadline misses.", JOBS);
+
+  if (hog_stats.dl_throttled == 0)
+    fail ("overrunning thread was never throttled");
+  msg ("Overrunning thread was throttled.");
+
+  for (i = 0; i < BATCH_CNT; i++)
+    if (batch_spins[i] == 0)
+      fail ("batch thread %d never ran", i);
+  msg ("Batch threads ran alongside the deadline class.");
+
+  if (!greedy_invalid)
+    fail ("runtime longer than deadline accepted");
+  if (!greedy_over)
+    fail ("oversubscription accepted");
+  if (!greedy_fits || !greedy_left)
+    fail ("thread within the remaining bandwidth refused");
+  msg ("Admission control turned away oversubscription.");
+}
+
+/* Does WORK_NS of work every period until JOBS periods have
+   passed, then stops the other threads. */
+static void
+periodic (void *aux UNUSED) 
+{
+  struct sched_deadline dl = {20 * MSEC, PERIOD_NS, PERIOD_NS};
+  int64_t release;
+  int i;
+
+  periodic_admitted = thread_set_deadline (&dl);
+  release = timer_ticks ();
+  for (i = 0; i < JOBS; i++)
+    {
+      int64_t start = timer_ns ();
+
+      while (timer_ns () - start < WORK_NS)
+        continue;
+      release += PERIOD_TICKS;
+      timer_sleep (release - timer_ticks ());
+    }
+  thread_get_sched_stats (SCHED_STATS_SELF, &periodic_stats);
+  stop = true;
+  sema_up (&done_sema);
+}
+
+/* Asks for 30 ms every period but spins until stopped. */
+static void
+hog (void *aux UNUSED) 
+{
+  struct sched_deadline dl = {30 * MSEC, PERIOD_NS, PERIOD_NS};
+
+  hog_admitted = thread_set_deadline (&dl);
+  while (!stop)
+    continue;
+  thread_get_sched_stats (SCHED_STATS_SELF, &hog_stats);
+  sema_up (&done_sema);
+}
+
+/* Tries to enter the deadline class after the other two, which
+   hold half of the CPU between them. */
+static void
+greedy (void *aux UNUSED) 
+{
+  struct sched_deadline invalid = {20 * MSEC, 10 * MSEC, PERIOD_NS};
+  struct sched_deadline over = {50 * MSEC, PERIOD_NS, PERIOD_NS};
+  struct sched_deadline fits = {40 * MSEC, PERIOD_NS, PERIOD_NS};
+  struct sched_deadline leave = {0, 0, 0};
+
+  greedy_invalid = !thread_set_deadline (&invalid);
+  greedy_over = !thread_set_deadline (&over);
+  greedy_fits = thread_set_deadline (&fits);
+  greedy_left = thread_set_deadline (&leave);
+  sema_up (&done_sema);
+}
+
+/* Spins until stopped, counting in *AUX. */
+static void
+batch (void *spins_) 
+{
+  volatile int64_t *spins = spins_;
+
+  while (!stop)
+    (*spins)++;
+  sema_up (&done_sema);
+}
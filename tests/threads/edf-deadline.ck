@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(edf-deadline) begin
+(edf-deadline) 20 jobs, no deadline misses.
+(edf-deadline) Overrunning thread was throttled.
+(edf-deadline) Batch threads ran alongside the deadline class.
+(edf-deadline) Admission control turned away oversubscription.
+(edf-deadline) end
+EOF
+pass;
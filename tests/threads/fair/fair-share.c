@@ -0,0 +1,144 @@
+/* Measures how evenly the fair-share scheduler ("-fair") divides
+   the CPU.
+
+   The fair-20 test runs 20 threads all niced to 0, which should
+   all receive the same number of ticks.  The test runs for 30
+   seconds, so the ticks should sum to about 30 * 100 == 3000
+   ticks, 150 for each thread.
+
+   The fair-nice-2 test runs 2 threads, one with nice 0, the other
+   with nice 5, and fair-nice-10 runs 10 threads with nice 0
+   through 9.  Each thread should receive ticks in proportion to
+   the weight of its nice value, as computed in fair.pm.
+
+   The load threads take turns noting the time from timer_ns() in
+   a shared record.  Time since the previous note counts for the
+   thread that made it, or is split evenly between the two threads
+   when the CPU has switched from one to the other, so that each
+   thread is charged its share of the switch itself.  Counting each
+   new timer_ticks() value, as the MLFQS tests do, would instead
+   credit a thread with a whole tick whenever it was switched in
+   partway through one.  The times are reported as shares of the
+   30 seconds' worth of ticks that the threads spin for, because
+   under virtualization the tick may run ahead of timer_ns() to
+   catch up on ticks it missed. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+static void test_fair_share (int thread_cnt, int nice_min, int nice_step);
+
+void
+test_fair_20 (void) 
+{
+  test_fair_share (20, 0, 0);
+}
+
+void
+test_fair_nice_2 (void) 
+{
+  test_fair_share (2, 0, 5);
+}
+
+void
+test_fair_nice_10 (void) 
+{
+  test_fair_share (10, 0, 1);
+}
+
+#define MAX_THREAD_CNT 20
+
+struct thread_info 
+  {
+    int64_t start_time;
+    int64_t run_ns;
+    int nice;
+  };
+
+/* The thread that last noted the time, and the time it noted. */
+static struct thread_info *last_info;
+static int64_t last_ns;
+
+static void load_thread (void *aux);
+
+static void
+test_fair_share (int thread_cnt, int nice_min, int nice_step)
+{
+  struct thread_info info[MAX_THREAD_CNT];
+  int64_t start_time;
+  int64_t total_ns;
+  int nice;
+  int i;
+
+  ASSERT (thread_fair);
+  ASSERT (thread_cnt <= MAX_THREAD_CNT);
+  ASSERT (nice_min >= -10);
+  ASSERT (nice_step >= 0);
+  ASSERT (nice_min + nice_step * (thread_cnt - 1) <= 20);
+
+  thread_set_nice (-20);
+  last_info = NULL;
+
+  start_time = timer_ticks ();
+  msg ("Starting %d threads...", thread_cnt);
+  nice = nice_min;
+  for (i = 0; i < thread_cnt; i++) 
+    {
+      struct thread_info *ti = &info[i];
+      char name[16];
+
+      ti->start_time = start_time;
+      ti->run_ns = 0;
+      ti->nice = nice;
+
+      snprintf(name, sizeof name, "load %d", i);
+      thread_create (name, PRI_DEFAULT, load_thread, ti);
+
+      nice += nice_step;
+    }
+  msg ("Starting threads took %"PRId64" ticks.", timer_elapsed (start_time));
+
+  msg ("Sleeping 40 seconds to let threads run, please wait...");
+  timer_sleep (40 * TIMER_FREQ);
+  
+  total_ns = 0;
+  for (i = 0; i < thread_cnt; i++)
+    total_ns += info[i].run_ns;
+  for (i = 0; i < thread_cnt; i++)
+    msg ("Thread %d received %d ticks.", i,
+         (int) ((info[i].run_ns * 30 * TIMER_FREQ + total_ns / 2) / total_ns));
+}
+
+static void
+load_thread (void *ti_) 
+{
+  struct thread_info *ti = ti_;
+  int64_t sleep_time = 5 * TIMER_FREQ;
+  int64_t spin_time = sleep_time + 30 * TIMER_FREQ;
+
+  thread_set_nice (ti->nice);
+  timer_sleep (sleep_time - timer_elapsed (ti->start_time));
+  while (timer_elapsed (ti->start_time) < spin_time) 
+    {
+      enum intr_level old_level = intr_disable ();
+      int64_t cur_ns = timer_ns ();
+      int64_t delta = cur_ns - last_ns;
+
+      if (last_info == ti)
+        ti->run_ns += delta;
+      else if (last_info != NULL)
+        {
+          last_info->run_ns += delta / 2;
+          ti->run_ns += delta - delta / 2;
+        }
+      last_info = ti;
+      last_ns = cur_ns;
+      intr_set_level (old_level);
+    }
+}
@@ -0,0 +1,98 @@
+/* Contends on an adaptive lock from two CPUs, each thread holding
+   it only briefly, and checks that some acquisitions were won by
+   spinning rather than by blocking.
+
+   Must be run with at least two CPUs. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/cpu.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define ROUNDS 2000
+#define HOLD_PAUSES 50
+
+static struct lock adaptive_lock;
+static struct semaphore done;
+static volatile bool started;
+static int counter;
+
+static thread_func holder_thread;
+static void hold (void);
+static long long total_lock_spins (void);
+
+void
+test_lock_spin (void) 
+{
+  long long spins;
+  int i;
+
+  ASSERT (ncpu > 1);
+
+  lock_init_adaptive (&adaptive_lock);
+  sema_init (&done, 0);
+  counter = 0;
+  started = false;
+  spins = total_lock_spins ();
+
+  /* The new thread goes to the idle CPU.  Wait until it is
+     actually running there. */
+  thread_create ("holder", thread_get_priority (), holder_thread, NULL);
+  while (!started)
+    barrier ();
+
+  for (i = 0; i < ROUNDS; i++)
+    hold ();
+  sema_down (&done);
+
+  if (counter != 2 * ROUNDS)
+    fail ("counter is %d, expected %d", counter, 2 * ROUNDS);
+  msg ("Counter reached %d.", counter);
+
+  spins = total_lock_spins () - spins;
+  if (spins == 0)
+    fail ("no acquisition was won by spinning");
+  msg ("Some acquisitions were won by spinning.");
+}
+
+static void
+holder_thread (void *aux UNUSED) 
+{
+  int i;
+
+  started = true;
+  for (i = 0; i < ROUNDS; i++)
+    hold ();
+  sema_up (&done);
+}
+
+/* Takes the lock, keeps it for a moment, and releases it. */
+static void
+hold (void) 
+{
+  int i;
+
+  lock_acquire (&adaptive_lock);
+  counter++;
+  for (i = 0; i < HOLD_PAUSES; i++)
+    asm volatile ("pause");
+  lock_release (&adaptive_lock);
+}
+
+/* Returns the number of adaptive lock acquisitions won by
+   spinning, on all CPUs. */
+static long long
+total_lock_spins (void) 
+{
+  enum intr_level old_level = intr_disable ();
+  long long spins = 0;
+  int i;
+
+  for (i = 0; i < ncpu; i++)
+    spins += cpus[i].lock_spins;
+  intr_set_level (old_level);
+  return spins;
+}
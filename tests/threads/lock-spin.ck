@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+grep (/^\(lock-spin\) Counter reached 4000\.$/, @output)
+  or fail "Counter is wrong.\n";
+grep (/^\(lock-spin\) Some acquisitions were won by spinning\.$/, @output)
+  or fail "No acquisition was won by spinning.\n";
+pass;
@@ -0,0 +1,58 @@
+/* Exercises malloc() size classes and the big block cache:
+   requests between powers of 2 take less than the next power of
+   2, blocks of each class keep their contents through realloc(),
+   and a freed big block is handed out again for a request of the
+   same page count. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/vaddr.h"
+
+static const size_t sizes[] = {1, 17, 100, 300, 700, 1100, 1500, 3000, 6000};
+#define SIZE_CNT (sizeof sizes / sizeof *sizes)
+
+void
+test_malloc_classes (void)
+{
+  uint8_t *p, *q;
+  size_t i;
+
+  /* 1100 bytes used to take a 2 kB block, half an arena. */
+  if (malloc_footprint (1100) >= PGSIZE / 2)
+    fail ("1100 bytes take %zu bytes", malloc_footprint (1100));
+  if (malloc_footprint (300) >= PGSIZE / 8)
+    fail ("300 bytes take %zu bytes", malloc_footprint (300));
+  msg ("Sizes between powers of 2 round up less.");
+
+  p = NULL;
+  for (i = 0; i < SIZE_CNT; i++)
+    {
+      size_t j;
+
+      q = realloc (p, sizes[i]);
+      if (q == NULL)
+        fail ("realloc to %zu bytes failed", sizes[i]);
+      if (i > 0)
+        for (j = 0; j < sizes[i - 1]; j++)
+          if (q[j] != (uint8_t) (j + i - 1))
+            fail ("byte %zu lost growing to %zu bytes", j, sizes[i]);
+      for (j = 0; j < sizes[i]; j++)
+        q[j] = j + i;
+      p = q;
+    }
+  free (p);
+  msg ("Blocks keep their contents across classes.");
+
+  p = malloc (6000);
+  if (p == NULL)
+    fail ("malloc (6000) failed");
+  free (p);
+  q = malloc (5000);
+  if (q != p)
+    fail ("freed big block not reused");
+  free (q);
+  msg ("Freed big blocks are reused.");
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(malloc-classes) begin
+(malloc-classes) Sizes between powers of 2 round up less.
+(malloc-classes) Blocks keep their contents across classes.
+(malloc-classes) Freed big blocks are reused.
+(malloc-classes) end
+EOF
+pass;
@@ -0,0 +1,70 @@
+/* Starts 1000 threads that spend nearly all of their time
+   blocked in timer_sleep(), waking up every 20 to 69 ticks,
+   while the main thread spins for 10 seconds counting loop
+   iterations.
+
+   The MLFQS bookkeeping done in the timer interrupt used to walk
+   every thread in the system, blocked or not, every 4 ticks and
+   every second, so the spin rate of the main thread dropped as
+   the number of sleepers grew.  The rate is printed for
+   comparison between kernels; only completion is checked. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 1000
+#define SPIN_SECONDS 10
+
+static int64_t start_time;
+static struct semaphore done;
+
+static void sleeper_thread (void *aux);
+
+void
+test_mlfqs_scale_1000 (void) 
+{
+  int64_t spin_start, iterations;
+  int i;
+
+  ASSERT (thread_mlfqs);
+
+  sema_init (&done, 0);
+  start_time = timer_ticks ();
+  msg ("Starting %d sleeper threads...", THREAD_CNT);
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "sleeper %d", i);
+      if (thread_create (name, PRI_DEFAULT, sleeper_thread,
+                         (void *) (intptr_t) i) == TID_ERROR)
+        fail ("could not create thread %d", i);
+    }
+
+  msg ("Main thread spinning for %d seconds...", SPIN_SECONDS);
+  spin_start = timer_ticks ();
+  iterations = 0;
+  while (timer_elapsed (spin_start) < SPIN_SECONDS * TIMER_FREQ)
+    iterations++;
+  printf ("mlfqs-scale-1000: %lld spin iterations per tick\n",
+          iterations / (SPIN_SECONDS * TIMER_FREQ));
+
+  msg ("Waiting for sleeper threads to exit...");
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done);
+  msg ("All sleeper threads exited.");
+}
+
+static void
+sleeper_thread (void *i_) 
+{
+  int64_t period = (intptr_t) i_ % 50 + 20;
+  int64_t exit_time = start_time + (SPIN_SECONDS + 2) * TIMER_FREQ;
+
+  while (timer_ticks () < exit_time)
+    timer_sleep (period);
+  sema_up (&done);
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+grep (/^mlfqs-scale-1000: \d+ spin iterations per tick$/, @output)
+  or fail "Spin rate was not reported.\n";
+grep (/^\(mlfqs-scale-1000\) All sleeper threads exited\.$/, @output)
+  or fail "Sleeper threads did not all exit.\n";
+pass;
@@ -0,0 +1,111 @@
+/* Exercises the buddy page allocator: odd-sized allocations take
+   exactly the pages asked for, PAL_ZERO pages are zeroed, and
+   freeing everything merges the free blocks back into the same
+   set of blocks as before.  Also checks that single pages are
+   served from the per-CPU magazine after one refill, and that an
+   allocation that fails returns the magazine's pages to the pool
+   before giving up. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+#define ALLOC_CNT 8
+
+static const size_t sizes[ALLOC_CNT] = {1, 3, 8, 5, 1, 2, 7, 16};
+
+void
+test_palloc_buddy (void) 
+{
+  struct palloc_stats before, during, after;
+  uint8_t *pages[ALLOC_CNT], *zeroed;
+  size_t total = 0;
+  uint8_t *a, *b;
+  int i;
+
+  palloc_drain_magazines ();
+  palloc_get_stats (false, &before);
+
+  for (i = 0; i < ALLOC_CNT; i++)
+    {
+      pages[i] = palloc_get_multiple (0, sizes[i]);
+      if (pages[i] == NULL)
+        fail ("allocation of %zu pages failed", sizes[i]);
+      memset (pages[i], i, sizes[i] * PGSIZE);
+      total += sizes[i];
+    }
+  palloc_get_stats (false, &during);
+  if (before.free_pages - during.free_pages != total)
+    fail ("%zu pages allocated, but %zu left the pool",
+          total, before.free_pages - during.free_pages);
+  msg ("Allocations took exactly the pages asked for.");
+
+  for (i = 0; i < ALLOC_CNT; i++)
+    {
+      size_t j;
+
+      for (j = 0; j < sizes[i] * PGSIZE; j++)
+        if (pages[i][j] != i)
+          fail ("allocation %d overlaps another", i);
+    }
+  msg ("Allocations do not overlap.");
+
+  /* Free every other allocation first, to force merges later. */
+  for (i = 0; i < ALLOC_CNT; i += 2)
+    palloc_free_multiple (pages[i], sizes[i]);
+  zeroed = palloc_get_multiple (PAL_ZERO, 3);
+  if (zeroed == NULL)
+    fail ("PAL_ZERO allocation failed");
+  for (i = 0; i < 3 * PGSIZE; i++)
+    if (zeroed[i] != 0)
+      fail ("PAL_ZERO page byte %d is %d", i, zeroed[i]);
+  palloc_free_multiple (zeroed, 3);
+  msg ("PAL_ZERO pages are zeroed.");
+  for (i = 1; i < ALLOC_CNT; i += 2)
+    palloc_free_multiple (pages[i], sizes[i]);
+
+  palloc_drain_magazines ();
+  palloc_get_stats (false, &after);
+  if (after.free_pages != before.free_pages)
+    fail ("%zu pages free before, %zu after",
+          before.free_pages, after.free_pages);
+  for (i = 0; i < PAL_ORDERS; i++)
+    if (after.free_blocks[i] != before.free_blocks[i])
+      fail ("order %d: %zu free blocks before, %zu after",
+            i, before.free_blocks[i], after.free_blocks[i]);
+  msg ("Freed blocks merged back.");
+
+  if (palloc_get_multiple (0, (size_t) 1 << PAL_ORDERS) != NULL)
+    fail ("allocation beyond the largest order succeeded");
+  msg ("Oversized allocation fails.");
+
+  /* The magazine is empty now, so the first page refills it and
+     the second is a hit. */
+  a = palloc_get_page (0);
+  b = palloc_get_page (0);
+  palloc_get_stats (false, &during);
+  if (a == NULL || b == NULL)
+    fail ("single page allocation failed");
+  if (during.mag_refills != after.mag_refills + 1)
+    fail ("%lld refills for two pages from an empty magazine",
+          during.mag_refills - after.mag_refills);
+  if (during.mag_hits != after.mag_hits + 1)
+    fail ("%lld magazine hits, not 1", during.mag_hits - after.mag_hits);
+  palloc_free_page (a);
+  palloc_free_page (b);
+  msg ("Single pages come from the magazine.");
+
+  palloc_get_stats (false, &during);
+  if (during.cached_pages == 0)
+    fail ("no pages in the magazine after freeing two to it");
+  if (palloc_get_multiple (0, (size_t) 1 << PAL_ORDERS) != NULL)
+    fail ("allocation beyond the largest order succeeded");
+  palloc_get_stats (false, &during);
+  if (during.cached_pages != 0)
+    fail ("%zu pages still in magazines after a failed allocation",
+          during.cached_pages);
+  msg ("Failed allocations reclaim magazine pages.");
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(palloc-buddy) begin
+(palloc-buddy) Allocations took exactly the pages asked for.
+(palloc-buddy) Allocations do not overlap.
+(palloc-buddy) PAL_ZERO pages are zeroed.
+(palloc-buddy) Freed blocks merged back.
+(palloc-buddy) Oversized allocation fails.
+(palloc-buddy) Single pages come from the magazine.
+(palloc-buddy) Failed allocations reclaim magazine pages.
+(palloc-buddy) end
+EOF
+pass;
@@ -0,0 +1,62 @@
+/* Checks that the idle thread fills the kernel pool's
+   stack of pre-zeroed pages while the CPU is otherwise idle, that
+   PAL_ZERO pages come from it, and that every PAL_ZERO page is
+   zeroed whether it came pre-zeroed or not. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+
+#define PAGE_CNT 64
+
+static void
+check_zeroed (const uint64_t *page)
+{
+  size_t i;
+
+  for (i = 0; i < PGSIZE / sizeof *page; i++)
+    if (page[i] != 0)
+      fail ("PAL_ZERO page word %zu is %#llx", i, page[i]);
+}
+
+void
+test_palloc_zero (void)
+{
+  struct palloc_stats before, after;
+  uint64_t *pages[PAGE_CNT];
+  int i;
+
+  /* Sleep, so that the idle thread gets to zero pages. */
+  timer_sleep (TIMER_FREQ / 10);
+  palloc_get_stats (false, &before);
+  if (before.zeroed_pages == 0)
+    fail ("no pages zeroed ahead while idle");
+  msg ("Pages are zeroed ahead while idle.");
+
+  pages[0] = palloc_get_page (PAL_ZERO);
+  if (pages[0] == NULL)
+    fail ("PAL_ZERO allocation failed");
+  check_zeroed (pages[0]);
+  palloc_get_stats (false, &after);
+  if (after.zero_reqs != before.zero_reqs + 1
+      || after.zero_hits != before.zero_hits + 1)
+    fail ("PAL_ZERO page was not taken from the zeroed pages");
+  palloc_free_page (pages[0]);
+  msg ("PAL_ZERO pages come pre-zeroed.");
+
+  /* More pages than are zeroed ahead, so that some are zeroed
+     inline. */
+  for (i = 0; i < PAGE_CNT; i++)
+    {
+      pages[i] = palloc_get_page (PAL_ZERO);
+      if (pages[i] == NULL)
+        fail ("PAL_ZERO allocation %d failed", i);
+      check_zeroed (pages[i]);
+    }
+  for (i = 0; i < PAGE_CNT; i++)
+    palloc_free_page (pages[i]);
+  msg ("All PAL_ZERO pages are zeroed.");
+}
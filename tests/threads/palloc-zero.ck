@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(palloc-zero) begin
+(palloc-zero) Pages are zeroed ahead while idle.
+(palloc-zero) PAL_ZERO pages come pre-zeroed.
+(palloc-zero) All PAL_ZERO pages are zeroed.
+(palloc-zero) end
+EOF
+pass;
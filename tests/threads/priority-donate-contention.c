@@ -0,0 +1,86 @@
+/* Has the main thread hold 8 locks while 64 higher-priority
+   threads pile up behind them, checks that main inherits the
+   highest waiter's priority, and then lets the threads fight
+   over the locks for 100 iterations each.
+
+   Every contended acquire donates along the chain of holders
+   and every release recomputes the releaser's priority, so the
+   number of timer ticks the whole run takes is printed for
+   comparison between kernels; only correctness of the
+   donations is checked. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 64
+#define LOCK_CNT 8
+#define ITER_CNT 100
+
+static struct lock locks[LOCK_CNT];
+static struct semaphore done;
+
+static void contender_thread (void *aux);
+
+void
+test_priority_donate_contention (void) 
+{
+  int64_t start;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  sema_init (&done, 0);
+  for (i = 0; i < LOCK_CNT; i++)
+    {
+      lock_init (&locks[i]);
+      lock_acquire (&locks[i]);
+    }
+  msg ("main got %d locks.", LOCK_CNT);
+
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "contender %d", i);
+      if (thread_create (name, PRI_DEFAULT + 1 + i % (PRI_MAX - PRI_DEFAULT),
+                         contender_thread, (void *) (intptr_t) i) == TID_ERROR)
+        fail ("could not create thread %d", i);
+    }
+  msg ("main should have priority %d.  Actual priority: %d.",
+       PRI_MAX, thread_get_priority ());
+
+  start = timer_ticks ();
+  for (i = 0; i < LOCK_CNT; i++)
+    lock_release (&locks[i]);
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done);
+  printf ("priority-donate-contention: %d acquires in %lld ticks\n",
+          THREAD_CNT * ITER_CNT, timer_elapsed (start));
+
+  msg ("main should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT, thread_get_priority ());
+}
+
+static void
+contender_thread (void *i_) 
+{
+  int i = (intptr_t) i_;
+  int k;
+
+  for (k = 0; k < ITER_CNT; k++)
+    {
+      struct lock *lock = &locks[(i + k) % LOCK_CNT];
+
+      lock_acquire (lock);
+      thread_yield ();
+      lock_release (lock);
+    }
+  sema_up (&done);
+}
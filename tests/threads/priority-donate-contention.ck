@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+grep (/^\(priority-donate-contention\) main got 8 locks\.$/, @output)
+  or fail "Main did not report acquiring its locks.\n";
+grep (/^\(priority-donate-contention\) main should have priority 63\.  Actual priority: 63\.$/, @output)
+  or fail "Main did not inherit the highest waiter's priority.\n";
+grep (/^priority-donate-contention: \d+ acquires in \d+ ticks$/, @output)
+  or fail "Run time was not reported.\n";
+grep (/^\(priority-donate-contention\) main should have priority 31\.  Actual priority: 31\.$/, @output)
+  or fail "Main did not return to its own priority.\n";
+pass;
@@ -0,0 +1,65 @@
+/* The main thread acquires more locks than fit in its held-lock
+   heap and puts a higher-priority waiter on each, so that some
+   of the locks go on its overflow list.  Checks that main's
+   priority follows its highest waiter as the locks are released,
+   first the lowest waiters' locks, whose heap slots the
+   overflowed locks then move into, and then the rest from the
+   highest down. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define LOCK_CNT 20
+
+static struct lock locks[LOCK_CNT];
+
+static thread_func waiter_thread;
+
+void
+test_priority_donate_overflow (void) 
+{
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  ASSERT (LOCK_CNT > HELD_LOCKS_MAX);
+  for (i = 0; i < LOCK_CNT; i++)
+    {
+      char name[16];
+
+      lock_init (&locks[i]);
+      lock_acquire (&locks[i]);
+      snprintf (name, sizeof name, "waiter %d", i);
+      thread_create (name, PRI_DEFAULT + 1 + i, waiter_thread, &locks[i]);
+    }
+  msg ("Main holds %d contended locks.  Actual priority: %d.",
+       LOCK_CNT, thread_get_priority ());
+
+  for (i = 0; i < LOCK_CNT / 2; i++)
+    lock_release (&locks[i]);
+  msg ("Released the lowest %d.  Actual priority: %d.",
+       LOCK_CNT / 2, thread_get_priority ());
+
+  for (i = LOCK_CNT - 1; i >= LOCK_CNT / 2; i--)
+    {
+      lock_release (&locks[i]);
+      msg ("Released lock %d.  Actual priority: %d.",
+           i, thread_get_priority ());
+    }
+}
+
+static void
+waiter_thread (void *lock_) 
+{
+  struct lock *lock = lock_;
+
+  lock_acquire (lock);
+  lock_release (lock);
+}
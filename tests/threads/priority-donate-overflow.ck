@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(priority-donate-overflow) begin
+(priority-donate-overflow) Main holds 20 contended locks.  Actual priority: 51.
+(priority-donate-overflow) Released the lowest 10.  Actual priority: 51.
+(priority-donate-overflow) Released lock 19.  Actual priority: 50.
+(priority-donate-overflow) Released lock 18.  Actual priority: 49.
+(priority-donate-overflow) Released lock 17.  Actual priority: 48.
+(priority-donate-overflow) Released lock 16.  Actual priority: 47.
+(priority-donate-overflow) Released lock 15.  Actual priority: 46.
+(priority-donate-overflow) Released lock 14.  Actual priority: 45.
+(priority-donate-overflow) Released lock 13.  Actual priority: 44.
+(priority-donate-overflow) Released lock 12.  Actual priority: 43.
+(priority-donate-overflow) Released lock 11.  Actual priority: 42.
+(priority-donate-overflow) Released lock 10.  Actual priority: 31.
+(priority-donate-overflow) end
+EOF
+pass;
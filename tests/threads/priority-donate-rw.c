@@ -0,0 +1,46 @@
+/* The main thread holds an rwlock for reading.  Then it creates
+   a higher-priority thread that blocks acquiring the rwlock for
+   writing, waiting for the readers to drain.  The writer should
+   donate its priority to the reader, and the reader should give
+   it back when it releases the rwlock. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func writer_thread_func;
+
+void
+test_priority_donate_rw (void) 
+{
+  struct rwlock rw;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rwlock_init (&rw);
+  rwlock_acquire_read (&rw);
+  thread_create ("writer", PRI_DEFAULT + 2, writer_thread_func, &rw);
+  msg ("This thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 2, thread_get_priority ());
+  rwlock_release_read (&rw);
+  msg ("writer must already have finished.");
+  msg ("This thread should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT, thread_get_priority ());
+}
+
+static void
+writer_thread_func (void *rw_) 
+{
+  struct rwlock *rw = rw_;
+
+  rwlock_acquire_write (rw);
+  msg ("writer: got the rwlock");
+  rwlock_release_write (rw);
+  msg ("writer: done");
+}
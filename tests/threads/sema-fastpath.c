@@ -0,0 +1,143 @@
+/* Times uncontended semaphore and lock operations, which take
+   the compare-and-swap fast path, then checks that the fast and
+   slow paths stay consistent when threads contend, and times a
+   lock that threads on every CPU take and release in a tight
+   loop.
+
+   Cycle counts are printed for comparison between kernels; only
+   correctness is checked. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "intrinsic.h"
+
+#define ITERATIONS 10000
+#define THREAD_CNT 4
+#define ROUNDS 200
+#define HAMMER_CNT 2
+#define HAMMER_OPS 5000
+
+static struct lock counter_lock;
+static struct semaphore done;
+static int counter;
+
+static thread_func adder_thread;
+static thread_func hammer_thread;
+
+void
+test_sema_fastpath (void) 
+{
+  struct semaphore sema;
+  struct lock lock;
+  uint64_t start;
+  int i;
+
+  /* Uncontended timings. */
+  sema_init (&sema, 1);
+  start = rdtsc ();
+  for (i = 0; i < ITERATIONS; i++)
+    {
+      sema_down (&sema);
+      sema_up (&sema);
+    }
+  printf ("sema-fastpath: sema_down+sema_up %llu cycles\n",
+          (rdtsc () - start) / ITERATIONS);
+
+  lock_init (&lock);
+  start = rdtsc ();
+  for (i = 0; i < ITERATIONS; i++)
+    {
+      lock_acquire (&lock);
+      lock_release (&lock);
+    }
+  printf ("sema-fastpath: lock_acquire+lock_release %llu cycles\n",
+          (rdtsc () - start) / ITERATIONS);
+
+  /* Counting. */
+  sema_init (&sema, 3);
+  for (i = 0; i < 3; i++)
+    ASSERT (sema_try_down (&sema));
+  ASSERT (!sema_try_down (&sema));
+  ASSERT (!sema_down_timeout (&sema, 0));
+  sema_up (&sema);
+  ASSERT (sema_value (&sema) == 1);
+  ASSERT (sema_down_timeout (&sema, 1));
+  ASSERT (!sema_down_timeout (&sema, 2));
+  ASSERT (sema_value (&sema) == 0);
+  msg ("Counting semaphore behaves.");
+
+  /* Contention: each adder yields while holding the lock, so the
+     others queue on it and lock_release() must take the slow
+     path to wake them. */
+  lock_init (&counter_lock);
+  sema_init (&done, 0);
+  counter = 0;
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      char name[16];
+
+      snprintf (name, sizeof name, "adder %d", i);
+      thread_create (name, thread_get_priority (), adder_thread, NULL);
+    }
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done);
+  if (counter != THREAD_CNT * ROUNDS)
+    fail ("counter is %d, expected %d", counter, THREAD_CNT * ROUNDS);
+  msg ("Counter reached %d.", counter);
+
+  /* Throughput: with one hammer per CPU, most acquires still
+     find the lock free and take the fast path, racing with
+     releases and slow-path waiters on the other CPU. */
+  lock_init (&counter_lock);
+  counter = 0;
+  start = rdtsc ();
+  for (i = 0; i < HAMMER_CNT; i++)
+    {
+      char name[16];
+
+      snprintf (name, sizeof name, "hammer %d", i);
+      thread_create (name, thread_get_priority (), hammer_thread, NULL);
+    }
+  for (i = 0; i < HAMMER_CNT; i++)
+    sema_down (&done);
+  printf ("sema-fastpath: shared lock_acquire+lock_release %llu cycles\n",
+          (rdtsc () - start) / (HAMMER_CNT * HAMMER_OPS));
+  if (counter != HAMMER_CNT * HAMMER_OPS)
+    fail ("counter is %d, expected %d", counter, HAMMER_CNT * HAMMER_OPS);
+  msg ("Shared counter reached %d.", counter);
+}
+
+static void
+adder_thread (void *aux UNUSED) 
+{
+  int i;
+
+  for (i = 0; i < ROUNDS; i++)
+    {
+      int value;
+
+      lock_acquire (&counter_lock);
+      value = counter;
+      thread_yield ();
+      counter = value + 1;
+      lock_release (&counter_lock);
+    }
+  sema_up (&done);
+}
+
+static void
+hammer_thread (void *aux UNUSED) 
+{
+  int i;
+
+  for (i = 0; i < HAMMER_OPS; i++)
+    {
+      lock_acquire (&counter_lock);
+      counter++;
+      lock_release (&counter_lock);
+    }
+  sema_up (&done);
+}
@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+grep (/^sema-fastpath: sema_down\+sema_up \d+ cycles$/, @output)
+  or fail "Semaphore timing was not reported.\n";
+grep (/^sema-fastpath: lock_acquire\+lock_release \d+ cycles$/, @output)
+  or fail "Lock timing was not reported.\n";
+grep (/^\(sema-fastpath\) Counting semaphore behaves\.$/, @output)
+  or fail "Counting check did not finish.\n";
+grep (/^\(sema-fastpath\) Counter reached 800\.$/, @output)
+  or fail "Counter is wrong.\n";
+grep (/^sema-fastpath: shared lock_acquire\+lock_release \d+ cycles$/, @output)
+  or fail "Shared lock timing was not reported.\n";
+grep (/^\(sema-fastpath\) Shared counter reached 10000\.$/, @output)
+  or fail "Shared counter is wrong.\n";
+pass;
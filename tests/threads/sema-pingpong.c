@@ -0,0 +1,62 @@
+/* Bounces control between the main thread and a second thread of
+   the same priority through a pair of semaphores for 5 seconds.
+   Each round trip blocks both threads once, so it costs two
+   context switches.
+
+   The switch rate is printed for comparison between kernels;
+   only completion is checked. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define RUN_SECONDS 5
+
+static struct semaphore ping, pong;
+static bool stop;
+
+static thread_func pong_thread;
+
+void
+test_sema_pingpong (void) 
+{
+  int64_t start, round_trips;
+
+  sema_init (&ping, 0);
+  sema_init (&pong, 0);
+  stop = false;
+  thread_create ("pong", thread_get_priority (), pong_thread, NULL);
+
+  msg ("Ping-ponging for %d seconds...", RUN_SECONDS);
+  start = timer_ticks ();
+  round_trips = 0;
+  while (timer_elapsed (start) < RUN_SECONDS * TIMER_FREQ)
+    {
+      sema_up (&ping);
+      sema_down (&pong);
+      round_trips++;
+    }
+  printf ("sema-pingpong: %lld switches per second\n",
+          round_trips * 2 / RUN_SECONDS);
+
+  stop = true;
+  sema_up (&ping);
+  sema_down (&pong);
+  msg ("Pong thread exited.");
+}
+
+static void
+pong_thread (void *aux UNUSED) 
+{
+  for (;;)
+    {
+      sema_down (&ping);
+      if (stop)
+        break;
+      sema_up (&pong);
+    }
+  sema_up (&pong);
+}
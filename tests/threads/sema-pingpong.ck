@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+grep (/^sema-pingpong: \d+ switches per second$/, @output)
+  or fail "Switch rate was not reported.\n";
+grep (/^\(sema-pingpong\) Pong thread exited\.$/, @output)
+  or fail "Pong thread did not exit.\n";
+pass;
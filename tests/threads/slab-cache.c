@@ -0,0 +1,98 @@
+/* Exercises object caches: objects from several slabs are
+   distinct, each comes constructed, freed objects keep their
+   constructed state, emptied slabs go back to the page
+   allocator but one, and a slab holds more objects than malloc()
+   fits in a page. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/slab.h"
+#include "threads/vaddr.h"
+
+#define OBJ_MAGIC 0x0b1ec7
+
+struct obj
+  {
+    int magic;                  /* Set by the constructor. */
+    int id;
+    char payload[192];
+  };
+
+#define OBJ_CNT 64
+
+static void
+obj_ctor (void *obj_)
+{
+  struct obj *obj = obj_;
+
+  obj->magic = OBJ_MAGIC;
+}
+
+void
+test_slab_cache (void)
+{
+  struct kmem_cache *cache;
+  struct kmem_cache_stats stats;
+  struct obj *objs[OBJ_CNT];
+  int i;
+
+  cache = kmem_cache_create ("test", sizeof (struct obj), obj_ctor);
+  if (cache == NULL)
+    fail ("kmem_cache_create failed");
+
+  for (i = 0; i < OBJ_CNT; i++)
+    {
+      objs[i] = kmem_cache_alloc (cache);
+      if (objs[i] == NULL)
+        fail ("allocation %d failed", i);
+      if (objs[i]->magic != OBJ_MAGIC)
+        fail ("object %d not constructed", i);
+      objs[i]->id = i;
+      memset (objs[i]->payload, i, sizeof objs[i]->payload);
+    }
+  kmem_cache_get_stats (cache, &stats);
+  if (stats.live != OBJ_CNT)
+    fail ("%zu live objects, not %d", stats.live, OBJ_CNT);
+  if (stats.slabs != (OBJ_CNT + stats.objs_per_slab - 1) / stats.objs_per_slab)
+    fail ("%zu slabs hold %d objects of %zu per slab",
+          stats.slabs, OBJ_CNT, stats.objs_per_slab);
+  msg ("Objects come constructed from several slabs.");
+
+  for (i = 0; i < OBJ_CNT; i++)
+    {
+      size_t j;
+
+      if (objs[i]->magic != OBJ_MAGIC || objs[i]->id != i)
+        fail ("object %d overlaps another", i);
+      for (j = 0; j < sizeof objs[i]->payload; j++)
+        if (objs[i]->payload[j] != (char) i)
+          fail ("object %d overlaps another", i);
+    }
+  msg ("Objects do not overlap.");
+
+  for (i = 0; i < OBJ_CNT; i++)
+    kmem_cache_free (cache, objs[i]);
+  kmem_cache_get_stats (cache, &stats);
+  if (stats.live != 0)
+    fail ("%zu live objects after freeing all", stats.live);
+  if (stats.slabs != 1)
+    fail ("%zu slabs kept after freeing all, not 1", stats.slabs);
+  msg ("Empty slabs are released but one.");
+
+  objs[0] = kmem_cache_alloc (cache);
+  if (objs[0] == NULL)
+    fail ("allocation from kept slab failed");
+  if (objs[0]->magic != OBJ_MAGIC)
+    fail ("reused object lost its constructed state");
+  kmem_cache_free (cache, objs[0]);
+  msg ("Reused objects keep their constructed state.");
+
+  if (stats.objs_per_slab <= PGSIZE / malloc_footprint (sizeof (struct obj)))
+    fail ("%zu objects per slab, but malloc fits %zu in a page",
+          stats.objs_per_slab,
+          PGSIZE / malloc_footprint (sizeof (struct obj)));
+  msg ("Slabs pack objects tighter than malloc.");
+}
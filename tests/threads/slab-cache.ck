@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(slab-cache) begin
+(slab-cache) Objects come constructed from several slabs.
+(slab-cache) Objects do not overlap.
+(slab-cache) Empty slabs are released but one.
+(slab-cache) Reused objects keep their constructed state.
+(slab-cache) Slabs pack objects tighter than malloc.
+(slab-cache) end
+EOF
+pass;
@@ -17,6 +17,7 @@ static const struct test tests[] =
         {"alarm-priority", test_alarm_priority},
         {"alarm-zero", test_alarm_zero},
         {"alarm-negative", test_alarm_negative},
+        {"alarm-usleep", test_alarm_usleep},
         {"priority-change", test_priority_change},
         {"priority-donate-one", test_priority_donate_one},
         {"priority-donate-multiple", test_priority_donate_multiple},
@@ -25,10 +26,23 @@ static const struct test tests[] =
         {"priority-donate-sema", test_priority_donate_sema},
         {"priority-donate-lower", test_priority_donate_lower},
         {"priority-donate-chain", test_priority_donate_chain},
+        {"priority-donate-contention", test_priority_donate_contention},
+        {"priority-donate-overflow", test_priority_donate_overflow},
+        {"priority-donate-rw", test_priority_donate_rw},
         {"priority-fifo", test_priority_fifo},
         {"priority-preempt", test_priority_preempt},
         {"priority-sema", test_priority_sema},
         {"priority-condvar", test_priority_condvar},
+        {"sema-pingpong", test_sema_pingpong},
+        {"sema-fastpath", test_sema_fastpath},
+        {"lock-spin", test_lock_spin},
+        {"trace-dump", test_trace_dump},
+        {"workqueue", test_workqueue},
+        {"edf-deadline", test_edf_deadline},
+        {"palloc-buddy", test_palloc_buddy},
+        {"slab-cache", test_slab_cache},
+        {"malloc-classes", test_malloc_classes},
+        {"palloc-zero", test_palloc_zero},
         {"mlfqs-load-1", test_mlfqs_load_1},
         {"mlfqs-load-60", test_mlfqs_load_60},
         {"mlfqs-load-avg", test_mlfqs_load_avg},
@@ -38,6 +52,10 @@ static const struct test tests[] =
         {"mlfqs-nice-2", test_mlfqs_nice_2},
         {"mlfqs-nice-10", test_mlfqs_nice_10},
         {"mlfqs-block", test_mlfqs_block},
+        {"mlfqs-scale-1000", test_mlfqs_scale_1000},
+        {"fair-20", test_fair_20},
+        {"fair-nice-2", test_fair_nice_2},
+        {"fair-nice-10", test_fair_nice_10},
 };
 
 static const char *test_name;
@@ -11,6 +11,7 @@ extern test_func test_alarm_simultaneous;
 extern test_func test_alarm_priority;
 extern test_func test_alarm_zero;
 extern test_func test_alarm_negative;
+extern test_func test_alarm_usleep;
 extern test_func test_priority_change;
 extern test_func test_priority_donate_one;
 extern test_func test_priority_donate_multiple;
@@ -19,10 +20,23 @@ extern test_func test_priority_donate_sema;
 extern test_func test_priority_donate_nest;
 extern test_func test_priority_donate_lower;
 extern test_func test_priority_donate_chain;
+extern test_func test_priority_donate_contention;
+extern test_func test_priority_donate_overflow;
+extern test_func test_priority_donate_rw;
 extern test_func test_priority_fifo;
 extern test_func test_priority_preempt;
 extern test_func test_priority_sema;
 extern test_func test_priority_condvar;
+extern test_func test_sema_pingpong;
+extern test_func test_sema_fastpath;
+extern test_func test_lock_spin;
+extern test_func test_trace_dump;
+extern test_func test_workqueue;
+extern test_func test_edf_deadline;
+extern test_func test_palloc_buddy;
+extern test_func test_slab_cache;
+extern test_func test_malloc_classes;
+extern test_func test_palloc_zero;
 extern test_func test_mlfqs_load_1;
 extern test_func test_mlfqs_load_60;
 extern test_func test_mlfqs_load_avg;
@@ -32,6 +46,10 @@ extern test_func test_mlfqs_fair_20;
 extern test_func test_mlfqs_nice_2;
 extern test_func test_mlfqs_nice_10;
 extern test_func test_mlfqs_block;
+extern test_func test_mlfqs_scale_1000;
+extern test_func test_fair_20;
+extern test_func test_fair_nice_2;
+extern test_func test_fair_nice_10;
 
 void msg (const char *, ...);
 void fail (const char *, ...);
@@ -0,0 +1,30 @@
+/* Presses TRACE_DUMP_KEY, as if typed on the serial port, and
+   checks that the scheduler trace is dumped while the test is
+   still running, rather than only at power off.
+
+   Must be run with -trace. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "devices/input.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/trace.h"
+#include "threads/workqueue.h"
+
+void
+test_trace_dump (void) 
+{
+  enum intr_level old_level;
+
+  ASSERT (trace_enabled);
+
+  msg ("Pressing the trace dump key.");
+  old_level = intr_disable ();
+  input_putc (TRACE_DUMP_KEY);
+  intr_set_level (old_level);
+
+  /* The dump runs on the system workqueue. */
+  flush_workqueue (system_wq);
+  msg ("Trace dumped.");
+}
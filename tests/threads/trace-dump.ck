@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+# The requested dump must come between the two messages, before
+# the one at power off.
+my ($pressed) = grep ($output[$_] =~ /^\(trace-dump\) Pressing the trace dump key\.$/, 0...$#output);
+my ($dumped) = grep ($output[$_] =~ /^\(trace-dump\) Trace dumped\.$/, 0...$#output);
+defined $pressed && defined $dumped or fail "Test did not finish.\n";
+grep (/^TRACE-BEGIN 2 /, @output[$pressed...$dumped])
+  or fail "Trace was not dumped on request.\n";
+grep (/^TRACE-END$/, @output[$pressed...$dumped])
+  or fail "Requested dump did not finish.\n";
+pass;
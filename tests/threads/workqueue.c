@@ -0,0 +1,86 @@
+/* Exercises workqueues: 100 work items spread over a pool of 4
+   workers must each run exactly once before flush_workqueue()
+   returns; delayed work must not run before its delay; and
+   cancelled delayed work must not run at all. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/workqueue.h"
+#include "devices/timer.h"
+
+#define WORK_CNT 100
+#define WORKERS 4
+#define DELAY 10
+
+static struct work works[WORK_CNT];
+static int run_cnt[WORK_CNT];
+static struct lock count_lock;
+
+static work_func count_work;
+static work_func note_time;
+
+void
+test_workqueue (void) 
+{
+  struct workqueue *wq;
+  struct delayed_work dw, cancelled;
+  int64_t queued_at, ran_at = -1, never = -1;
+  int i;
+
+  lock_init (&count_lock);
+  wq = workqueue_create ("test-wq", WORKERS, PRI_DEFAULT);
+  ASSERT (wq != NULL);
+
+  for (i = 0; i < WORK_CNT; i++)
+    {
+      work_init (&works[i], count_work, &run_cnt[i]);
+      queue_work (wq, &works[i]);
+    }
+  flush_workqueue (wq);
+  for (i = 0; i < WORK_CNT; i++)
+    if (run_cnt[i] != 1)
+      fail ("work %d ran %d times", i, run_cnt[i]);
+  msg ("All %d works ran once.", WORK_CNT);
+
+  delayed_work_init (&dw, note_time, &ran_at);
+  queued_at = timer_ticks ();
+  queue_delayed_work (wq, &dw, DELAY);
+  if (queue_delayed_work (wq, &dw, DELAY))
+    fail ("pending delayed work was queued twice");
+  flush_work (&dw.work);
+  if (ran_at < queued_at + DELAY)
+    fail ("delayed work ran after %lld ticks, not %d", ran_at - queued_at, DELAY);
+  msg ("Delayed work waited its delay.");
+
+  delayed_work_init (&cancelled, note_time, &never);
+  queue_delayed_work (wq, &cancelled, DELAY);
+  if (!cancel_delayed_work (&cancelled))
+    fail ("cancel_delayed_work() found nothing pending");
+  timer_sleep (DELAY * 2);
+  if (never != -1)
+    fail ("cancelled work ran");
+  msg ("Cancelled work did not run.");
+}
+
+static void
+count_work (void *count_) 
+{
+  int *count = count_;
+
+  /* Give other workers a chance to run concurrently. */
+  thread_yield ();
+  lock_acquire (&count_lock);
+  (*count)++;
+  lock_release (&count_lock);
+}
+
+static void
+note_time (void *when_) 
+{
+  int64_t *when = when_;
+
+  *when = timer_ticks ();
+}
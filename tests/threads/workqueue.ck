@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(workqueue) begin
+(workqueue) All 100 works ran once.
+(workqueue) Delayed work waited its delay.
+(workqueue) Cancelled work did not run.
+(workqueue) end
+EOF
+pass;
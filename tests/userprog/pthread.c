@@ -0,0 +1,70 @@
+/* Runs threads that share a counter under a pthread mutex, hands
+   off between threads with a condition variable, and checks
+   that join returns each thread's value. */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define THREAD_CNT 4
+#define ITERS 2000
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static volatile int counter;
+static int ready;
+
+static void *
+adder (void *aux)
+{
+  int i;
+
+  for (i = 0; i < ITERS; i++)
+    {
+      int c;
+
+      pthread_mutex_lock (&mutex);
+      c = counter;
+      counter = c + 1;
+      pthread_mutex_unlock (&mutex);
+    }
+  return aux;
+}
+
+static void *
+waiter (void *aux UNUSED)
+{
+  pthread_mutex_lock (&mutex);
+  while (!ready)
+    pthread_cond_wait (&cond, &mutex);
+  pthread_mutex_unlock (&mutex);
+  return (void *) 42;
+}
+
+void
+test_main (void)
+{
+  pthread_t threads[THREAD_CNT], w;
+  void *ret;
+  int i;
+
+  for (i = 0; i < THREAD_CNT; i++)
+    CHECK (pthread_create (&threads[i], adder, (void *) (intptr_t) i) == 0,
+           "create thread %d", i);
+  for (i = 0; i < THREAD_CNT; i++)
+    CHECK (pthread_join (threads[i], &ret) == 0 && ret == (void *) (intptr_t) i,
+           "join thread %d", i);
+  msg ("counter = %d", counter);
+  CHECK (pthread_join (threads[0], NULL) == -1, "join a joined thread fails");
+
+  CHECK (pthread_create (&w, waiter, NULL) == 0, "create waiter");
+  pthread_mutex_lock (&mutex);
+  ready = 1;
+  pthread_cond_signal (&cond);
+  pthread_mutex_unlock (&mutex);
+  CHECK (pthread_join (w, &ret) == 0 && ret == (void *) 42, "join waiter");
+
+  CHECK (futex_wait (&ready, 0) == -1, "futex_wait on a changed value fails");
+}
@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pthread) begin
+(pthread) create thread 0
+(pthread) create thread 1
+(pthread) create thread 2
+(pthread) create thread 3
+(pthread) join thread 0
+(pthread) join thread 1
+(pthread) join thread 2
+(pthread) join thread 3
+(pthread) counter = 8000
+(pthread) join a joined thread fails
+(pthread) create waiter
+(pthread) join waiter
+(pthread) futex_wait on a changed value fails
+(pthread) end
+pthread: exit(0)
+EOF
+pass;
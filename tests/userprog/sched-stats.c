@@ -0,0 +1,26 @@
+/* Checks that the scheduler statistics count the switch away
+   from a process that blocks in wait(), and that the global
+   totals include the calling process. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  struct sched_stats before, after, all;
+  int pid;
+
+  CHECK (sched_stats (SCHED_STATS_SELF, &before), "get own statistics");
+  if ((pid = fork ("child")) == 0)
+    exit (7);
+  msg ("wait(fork()) = %d", wait (pid));
+  CHECK (sched_stats (SCHED_STATS_SELF, &after), "get own statistics again");
+  CHECK (after.voluntary > before.voluntary, "blocking in wait() was counted");
+  CHECK (after.switches > before.switches, "being switched back to was counted");
+
+  CHECK (sched_stats (SCHED_STATS_ALL, &all), "get global statistics");
+  CHECK (all.switches >= after.switches, "global switches include ours");
+  CHECK (!sched_stats (2, &all), "reject unknown scope");
+}
@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(sched-stats) begin
+(sched-stats) get own statistics
+child: exit(7)
+(sched-stats) wait(fork()) = 7
+(sched-stats) get own statistics again
+(sched-stats) blocking in wait() was counted
+(sched-stats) being switched back to was counted
+(sched-stats) get global statistics
+(sched-stats) global switches include ours
+(sched-stats) reject unknown scope
+(sched-stats) end
+sched-stats: exit(0)
+EOF
+pass;
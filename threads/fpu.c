@@ -0,0 +1,326 @@
+#include "threads/fpu.h"
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+#include "threads/loader.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "intrinsic.h"
+
+/* Lazy FPU context switching.
+
+   The x87, SSE and (when the CPU has XSAVE) AVX registers are
+   not saved and restored on every thread switch.  Instead, each
+   CPU remembers which thread's state is live in its registers,
+   and a switch to any other thread sets CR0.TS.  The first FPU
+   or SSE instruction that thread executes then raises #NM
+   (device not available), and only at that point is the old
+   owner's state saved and the new thread's restored.  Threads
+   that never touch the FPU, which includes all kernel code since
+   the kernel is built with -mno-sse -msoft-float, never pay for
+   it.
+
+   A thread's save area is allocated on its first #NM and starts
+   out as a copy of the FPU's state right after FNINIT.
+
+   With more than one CPU, a thread may next run on a CPU other
+   than the one holding its state, so the owner's state is saved
+   as soon as it is switched out, and a CPU that loads a thread's
+   state takes ownership away from any other.  The registers are
+   still only restored on #NM. */
+
+/* CR0 bits. */
+#define CR0_MP (1 << 1)          /* Monitor coprocessor: WAIT obeys TS. */
+#define CR0_EM (1 << 2)          /* Emulation: all FPU instructions trap. */
+#define CR0_TS (1 << 3)          /* Task switched: FPU instructions trap. */
+#define CR0_NE (1 << 5)          /* Native x87 error reporting. */
+
+/* CR4 bits. */
+#define CR4_OSFXSR (1 << 9)      /* OS supports FXSAVE/FXRSTOR and SSE. */
+#define CR4_OSXMMEXCPT (1 << 10) /* OS handles #XF. */
+#define CR4_OSXSAVE (1 << 18)    /* OS supports XSAVE and XCR0. */
+
+/* CPUID leaf 1 feature bits. */
+#define CPUID_EDX_FXSR (1 << 24)
+#define CPUID_EDX_SSE (1 << 25)
+#define CPUID_ECX_XSAVE (1 << 26)
+#define CPUID_ECX_AVX (1 << 28)
+
+/* XCR0 state components. */
+#define XCR0_X87 (1 << 0)
+#define XCR0_SSE (1 << 1)
+#define XCR0_AVX (1 << 2)
+
+#define FXSAVE_SIZE 512          /* Size of an FXSAVE area. */
+#define FPU_ALIGN 64             /* XSAVE areas must be 64-byte aligned. */
+#define MXCSR_DEFAULT 0x1f80     /* All SIMD exceptions masked. */
+
+static bool fpu_enabled;         /* FPU and SSE usable? */
+static bool use_xsave;           /* Save with XSAVE rather than FXSAVE? */
+static bool use_xsaveopt;        /* Save with XSAVEOPT? */
+static uint64_t xcr0;            /* State components we manage. */
+static size_t fpu_size;          /* Bytes in a save area. */
+static void *fpu_init_area;      /* State right after FNINIT. */
+
+/* Statistics. */
+static long long fpu_traps;      /* # of #NM traps taken. */
+static long long fpu_saves;      /* # of states saved for another thread. */
+
+static void fpu_trap (struct intr_frame *);
+
+/* Returns the aligned save area within AREA, a block returned by
+   fpu_alloc(). */
+static void *
+fpu_state (void *area) {
+	return (void *) ROUND_UP ((uintptr_t) area, FPU_ALIGN);
+}
+
+/* Allocates a save area, or returns a null pointer if memory is
+   short. */
+static void *
+fpu_alloc (void) {
+	return malloc (fpu_size + FPU_ALIGN - 1);
+}
+
+/* Saves the FPU registers into AREA.  CR0.TS must be clear. */
+static void
+fpu_save (void *area) {
+	void *state = fpu_state (area);
+	uint32_t lo = xcr0, hi = xcr0 >> 32;
+
+	if (use_xsaveopt)
+		asm volatile ("xsaveopt64 (%0)" : : "r" (state), "a" (lo), "d" (hi) : "memory");
+	else if (use_xsave)
+		asm volatile ("xsave64 (%0)" : : "r" (state), "a" (lo), "d" (hi) : "memory");
+	else
+		asm volatile ("fxsave64 (%0)" : : "r" (state) : "memory");
+}
+
+/* Loads the FPU registers from AREA.  CR0.TS must be clear. */
+static void
+fpu_restore (void *area) {
+	void *state = fpu_state (area);
+	uint32_t lo = xcr0, hi = xcr0 >> 32;
+
+	if (use_xsave)
+		asm volatile ("xrstor64 (%0)" : : "r" (state), "a" (lo), "d" (hi) : "memory");
+	else
+		asm volatile ("fxrstor64 (%0)" : : "r" (state) : "memory");
+}
+
+/* Sets or clears CR0.TS, writing CR0 only if it changes. */
+static void
+fpu_set_ts (bool ts) {
+	uint64_t cr0 = rcr0 ();
+
+	if (ts && !(cr0 & CR0_TS))
+		lcr0 (cr0 | CR0_TS);
+	else if (!ts && (cr0 & CR0_TS))
+		clts ();
+}
+
+/* Enables the FPU and SSE, and XSAVE-managed state if the CPU
+   supports it, and installs the #NM handler.  If the CPU lacks
+   FXSAVE, FPU instructions keep trapping and a process that uses
+   them is killed. */
+void
+fpu_init (void) {
+	uint32_t eax, ebx, ecx, edx;
+	uint32_t mxcsr = MXCSR_DEFAULT;
+	uint64_t cr0 = rcr0 ();
+
+	intr_register_int (7, 0, INTR_OFF, fpu_trap,
+			"#NM Device Not Available Exception");
+
+	cpuid (1, 0, &eax, &ebx, &ecx, &edx);
+	if (!(edx & CPUID_EDX_FXSR) || !(edx & CPUID_EDX_SSE)) {
+		lcr0 (cr0 | CR0_EM);
+		return;
+	}
+
+	lcr0 ((cr0 & ~CR0_EM) | CR0_MP | CR0_NE);
+	lcr4 (rcr4 () | CR4_OSFXSR | CR4_OSXMMEXCPT);
+	fpu_size = FXSAVE_SIZE;
+
+	if (ecx & CPUID_ECX_XSAVE) {
+		use_xsave = true;
+		xcr0 = XCR0_X87 | XCR0_SSE;
+		if (ecx & CPUID_ECX_AVX)
+			xcr0 |= XCR0_AVX;
+		lcr4 (rcr4 () | CR4_OSXSAVE);
+		xsetbv (0, xcr0);
+
+		/* Size of the area for the components enabled in XCR0. */
+		cpuid (0xd, 0, &eax, &ebx, &ecx, &edx);
+		fpu_size = ebx;
+		cpuid (0xd, 1, &eax, &ebx, &ecx, &edx);
+		use_xsaveopt = eax & 1;
+	}
+
+	fpu_init_area = fpu_alloc ();
+	if (fpu_init_area == NULL)
+		PANIC ("fpu_init: out of memory");
+	memset (fpu_state (fpu_init_area), 0, fpu_size);
+	clts ();
+	asm volatile ("fninit");
+	asm volatile ("ldmxcsr %0" : : "m" (mxcsr));
+	fpu_save (fpu_init_area);
+	lcr0 (rcr0 () | CR0_TS);
+
+	fpu_enabled = true;
+}
+
+/* Sets up the FPU of an application processor the way
+   fpu_init() set up the bootstrap processor's. */
+void
+fpu_init_ap (void) {
+	uint64_t cr0 = rcr0 ();
+
+	if (!fpu_enabled) {
+		lcr0 (cr0 | CR0_EM);
+		return;
+	}
+
+	lcr0 ((cr0 & ~CR0_EM) | CR0_MP | CR0_NE | CR0_TS);
+	lcr4 (rcr4 () | CR4_OSFXSR | CR4_OSXMMEXCPT);
+	if (use_xsave) {
+		lcr4 (rcr4 () | CR4_OSXSAVE);
+		xsetbv (0, xcr0);
+	}
+}
+
+/* Called by the scheduler, with interrupts off, just before
+   switching from PREV to NEXT.  Arms the #NM trap unless NEXT's
+   state is already in the FPU. */
+void
+fpu_switch (struct thread *prev, struct thread *next) {
+	struct cpu *c = this_cpu ();
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (!fpu_enabled)
+		return;
+	if (ncpu > 1 && prev != next && c->fpu_owner == prev) {
+		/* PREV may run next on another CPU. */
+		clts ();
+		fpu_save (prev->fpu_area);
+		fpu_saves++;
+	}
+	fpu_set_ts (next != c->fpu_owner);
+}
+
+/* #NM handler.  Makes the FPU registers hold the current thread's
+   state, saving the previous owner's first. */
+static void
+fpu_trap (struct intr_frame *f) {
+	struct thread *curr = thread_current ();
+	struct cpu *c;
+
+	if (!fpu_enabled || f->cs != SEL_UCSEG) {
+		if (f->cs == SEL_UCSEG) {
+			printf ("%s: dying due to interrupt %#04llx (%s).\n",
+					thread_name (), f->vec_no, intr_name (f->vec_no));
+			intr_enable ();
+			thread_exit ();
+		}
+		intr_dump_frame (f);
+		PANIC ("Kernel bug - FPU used in kernel");
+	}
+
+	if (curr->fpu_area == NULL) {
+		void *area;
+
+		/* May sleep on the allocator's lock. */
+		intr_enable ();
+		area = fpu_alloc ();
+		if (area == NULL) {
+			printf ("%s: out of memory for FPU state\n", thread_name ());
+			thread_exit ();
+		}
+		intr_disable ();
+		memcpy (fpu_state (area), fpu_state (fpu_init_area), fpu_size);
+		curr->fpu_area = area;
+	}
+
+	fpu_traps++;
+	clts ();
+	c = this_cpu ();
+	if (c->fpu_owner != curr) {
+		int i;
+
+		/* With more than one CPU, fpu_switch() already saved the
+		   owner, which may have run elsewhere since. */
+		if (c->fpu_owner != NULL && ncpu == 1) {
+			fpu_save (c->fpu_owner->fpu_area);
+			fpu_saves++;
+		}
+		fpu_restore (curr->fpu_area);
+		for (i = 0; i < ncpu; i++)
+			if (cpus[i].fpu_owner == curr)
+				cpus[i].fpu_owner = NULL;
+		c->fpu_owner = curr;
+	}
+}
+
+/* Gives the current thread, which must not have used the FPU
+   yet, a copy of PARENT's FPU state.  Returns false if memory is
+   short. */
+bool
+fpu_fork (struct thread *parent) {
+	struct thread *curr = thread_current ();
+	enum intr_level old_level;
+	void *area;
+
+	ASSERT (curr->fpu_area == NULL);
+
+	if (parent->fpu_area == NULL)
+		return true;
+	area = fpu_alloc ();
+	if (area == NULL)
+		return false;
+
+	old_level = intr_disable ();
+	if (this_cpu ()->fpu_owner == parent) {
+		/* PARENT's latest state is only in the registers. */
+		clts ();
+		fpu_save (parent->fpu_area);
+		fpu_set_ts (true);
+	}
+	memcpy (fpu_state (area), fpu_state (parent->fpu_area), fpu_size);
+	curr->fpu_area = area;
+	intr_set_level (old_level);
+	return true;
+}
+
+/* Throws away T's FPU state, so that its next FPU instruction
+   starts over from the initial state.  Called when T execs or
+   exits. */
+void
+fpu_discard (struct thread *t) {
+	enum intr_level old_level;
+	void *area;
+	int i;
+
+	old_level = intr_disable ();
+	for (i = 0; i < ncpu; i++)
+		if (cpus[i].fpu_owner == t)
+			cpus[i].fpu_owner = NULL;
+	if (fpu_enabled && t == thread_current ())
+		fpu_set_ts (true);
+	area = t->fpu_area;
+	t->fpu_area = NULL;
+	intr_set_level (old_level);
+
+	free (area);
+}
+
+/* Prints FPU statistics. */
+void
+fpu_print_stats (void) {
+	if (fpu_enabled)
+		printf ("FPU: %lld traps, %lld state saves\n", fpu_traps, fpu_saves);
+}
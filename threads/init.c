@@ -13,6 +13,7 @@
 #include "devices/serial.h"
 #include "devices/timer.h"
 #include "devices/vga.h"
+#include "threads/fpu.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
 #include "threads/loader.h"
@@ -20,7 +21,11 @@
 #include "threads/mmu.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
+#include "threads/slab.h"
+#include "threads/smp.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
+#include "threads/workqueue.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
@@ -85,7 +90,9 @@ main (void) {
 	/* Initialize memory system. */
 	mem_end = palloc_init ();
 	malloc_init ();
+	kmem_cache_init ();
 	paging_init (mem_end);
+	trace_init ();
 
 #ifdef USERPROG
 	tss_init ();
@@ -94,6 +101,7 @@ main (void) {
 
 	/* Initialize interrupt handlers. */
 	intr_init ();
+	fpu_init ();
 	timer_init ();
 	kbd_init ();
 	input_init ();
@@ -105,6 +113,8 @@ main (void) {
 	thread_start ();
 	serial_init_queue ();
 	timer_calibrate ();
+	smp_init ();
+	workqueue_init ();
 
 #ifdef FILESYS
 	/* Initialize file system. */
@@ -221,6 +231,16 @@ parse_options (char **argv) {
 			random_init (atoi (value));
 		else if (!strcmp (name, "-mlfqs"))
 			thread_mlfqs = true;
+		else if (!strcmp (name, "-fair"))
+			thread_fair = true;
+		else if (!strcmp (name, "-tickless"))
+			timer_tickless = true;
+		else if (!strcmp (name, "-trace"))
+			trace_enabled = true;
+		else if (!strcmp (name, "-kworkers"))
+			system_wq_workers = atoi (value);
+		else if (!strcmp (name, "-maxcpus"))
+			smp_max_cpus = atoi (value);
 #ifdef USERPROG
 		else if (!strcmp (name, "-ul"))
 			user_page_limit = atoi (value);
@@ -230,6 +250,8 @@ parse_options (char **argv) {
 		else
 			PANIC ("unknown option `%s' (use -h for help)", name);
 	}
+	if (thread_mlfqs && thread_fair)
+		PANIC ("-mlfqs and -fair are mutually exclusive");
 
 	return argv;
 }
@@ -326,6 +348,11 @@ usage (void) {
 			"  -f                 Format file system disk during startup.\n"
 			"  -rs=SEED           Set random number seed to SEED.\n"
 			"  -mlfqs             Use multi-level feedback queue scheduler.\n"
+			"  -fair              Use fair-share (virtual runtime) scheduler.\n"
+			"  -tickless          Stop the timer tick while the CPU is idle.\n"
+			"  -trace             Record scheduler events; dump them at power off.\n"
+			"  -kworkers=N        Serve the system workqueue with N threads.\n"
+			"  -maxcpus=N         Use at most N CPUs.\n"
 #ifdef USERPROG
 			"  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
@@ -343,6 +370,7 @@ power_off (void) {
 #endif
 
 	print_stats ();
+	trace_dump ();
 
 	printf ("Powering off...\n");
 	outw (0x604, 0x2000);               /* Poweroff command for qemu */
@@ -354,6 +382,11 @@ static void
 print_stats (void) {
 	timer_print_stats ();
 	thread_print_stats ();
+	fpu_print_stats ();
+	palloc_print_stats ();
+	malloc_print_stats ();
+	kmem_cache_print_stats ();
+	workqueue_print_stats ();
 #ifdef FILESYS
 	disk_print_stats ();
 #endif
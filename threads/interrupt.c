@@ -3,16 +3,20 @@
 #include <inttypes.h>
 #include <stdint.h>
 #include <stdio.h>
+#include "threads/cpu.h"
 #include "threads/flags.h"
 #include "threads/intr-stubs.h"
 #include "threads/io.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
+#include "threads/smp.h"
 #include "threads/vaddr.h"
+#include "devices/lapic.h"
 #include "devices/timer.h"
 #include "intrinsic.h"
 #ifdef USERPROG
 #include "userprog/gdt.h"
+#include "userprog/process.h"
 #endif
 
 /* Number of x86_64 interrupts. */
@@ -99,10 +103,33 @@ static const char *intr_names[INTR_CNT];
    pre-empted.  Handlers for external interrupts also may not
    sleep, although they may invoke intr_yield_on_return() to
    request that a new process be scheduled just before the
-   interrupt returns. */
+   interrupt returns.
+
+   Only the CPU holding the interrupt lock (see below) can be in
+   an external interrupt, so these need not be per-CPU. */
 static bool in_external_intr;   /* Are we processing an external interrupt? */
 static bool yield_on_return;    /* Should we yield on interrupt return? */
 
+/* Interrupt lock.
+
+   Pintos protects shared data by turning interrupts off, which
+   on a single CPU keeps anything else from running.  To keep
+   that so with several CPUs, turning interrupts off also takes
+   this lock and turning them back on releases it: a CPU holds
+   the lock exactly while its interrupts are off, and at most one
+   CPU at a time runs with interrupts off.  An interrupt that
+   arrives while interrupts are on takes the lock on entry, as
+   intr_disable() would, and gives it back on return.  The
+   bootstrap processor boots with interrupts off, so it starts
+   out holding the lock.
+
+   A CPU waiting for the lock has interrupts off, so it answers
+   TLB flush requests (see smp.c) while it spins. */
+static volatile uint32_t intr_lock = 1;
+
+static void intr_lock_acquire (void);
+static void intr_lock_release (void);
+
 /* Programmable Interrupt Controller helpers. */
 static void pic_init (void);
 static void pic_end_of_interrupt (int irq);
@@ -141,7 +168,9 @@ intr_enable (void) {
 
 	   See [IA32-v2b] "STI" and [IA32-v3a] 5.8.1 "Masking Maskable
 	   Hardware Interrupts". */
-	asm volatile ("sti");
+	if (old_level == INTR_OFF)
+		intr_lock_release ();
+	asm volatile ("sti" : : : "memory");
 
 	return old_level;
 }
@@ -155,10 +184,66 @@ intr_disable (void) {
 	   See [IA32-v2b] "CLI" and [IA32-v3a] 5.8.1 "Masking Maskable
 	   Hardware Interrupts". */
 	asm volatile ("cli" : : : "memory"); // 추후 보자
+	if (old_level == INTR_ON)
+		intr_lock_acquire ();
+
+	return old_level;
+}
+
+/* Disables interrupts on the running CPU only, without taking
+   the interrupt lock, and returns the previous interrupt status.
+   This keeps the running thread on its CPU and keeps interrupt
+   handlers from running on it, but does not exclude other CPUs,
+   so it suits short sections that touch only per-CPU data under
+   spinlocks.  Such a section must end with intr_restore_local(),
+   not intr_enable() or intr_set_level(), and must not rely on
+   intr_disable() within it, which would find interrupts already
+   off and not take the lock. */
+enum intr_level
+intr_disable_local (void) {
+	enum intr_level old_level = intr_get_level ();
 
+	asm volatile ("cli" : : : "memory");
 	return old_level;
 }
 
+/* Ends a section begun by intr_disable_local(), which returned
+   OLD_LEVEL. */
+void
+intr_restore_local (enum intr_level old_level) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	if (old_level == INTR_ON)
+		asm volatile ("sti" : : : "memory");
+}
+
+/* Releases the interrupt lock without enabling interrupts, for
+   code that is about to enable them itself with `sti' or by
+   returning with `iretq' to a context that had them on.
+   Interrupts must be off. */
+void
+intr_unlock (void) {
+	ASSERT (intr_get_level () == INTR_OFF);
+	intr_lock_release ();
+}
+
+/* Acquires the interrupt lock.  Interrupts must be off. */
+static void
+intr_lock_acquire (void) {
+	while (__atomic_exchange_n (&intr_lock, 1, __ATOMIC_ACQUIRE))
+		while (intr_lock) {
+			smp_tlb_flush ();
+			asm volatile ("pause");
+		}
+}
+
+/* Releases the interrupt lock. */
+static void
+intr_lock_release (void) {
+	ASSERT (intr_lock);
+	__atomic_store_n (&intr_lock, 0, __ATOMIC_RELEASE);
+}
+
 /* Initializes the interrupt system. */
 void
 intr_init (void) {
@@ -203,6 +288,20 @@ intr_init (void) {
 	intr_names[19] = "#XF SIMD Floating-Point Exception";
 }
 
+/* Sets up interrupts on an application processor, which starts
+   out, like the bootstrap processor, with interrupts off, and
+   takes the interrupt lock to match. */
+void
+intr_init_ap (void) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	intr_lock_acquire ();
+#ifdef USERPROG
+	ltr (SEL_TSS_CPU (this_cpu ()->id));
+#endif
+	lidt (&idt_desc);
+}
+
 /* Registers interrupt VEC_NO to invoke HANDLER with descriptor
    privilege level DPL.  Names the interrupt NAME for debugging
    purposes.  The interrupt handler will be invoked with
@@ -221,13 +320,20 @@ register_handler (uint8_t vec_no, int dpl, enum intr_level level,
 	intr_names[vec_no] = name;
 }
 
+/* Returns true if VEC_NO is an external interrupt, that is, one
+   from the 8259A PICs or the local APIC. */
+static bool
+is_external (uint8_t vec_no) {
+	return (vec_no >= 0x20 && vec_no <= 0x2f) || vec_no >= LAPIC_VEC_BASE;
+}
+
 /* Registers external interrupt VEC_NO to invoke HANDLER, which
    is named NAME for debugging purposes.  The handler will
    execute with interrupts disabled. */
 void
 intr_register_ext (uint8_t vec_no, intr_handler_func *handler,
 		const char *name) {
-	ASSERT (vec_no >= 0x20 && vec_no <= 0x2f);
+	ASSERT (is_external (vec_no));
 	register_handler (vec_no, 0, INTR_OFF, handler, name);
 }
 
@@ -248,7 +354,7 @@ void
 intr_register_int (uint8_t vec_no, int dpl, enum intr_level level,
 		intr_handler_func *handler, const char *name)
 {
-	ASSERT (vec_no < 0x20 || vec_no > 0x2f);
+	ASSERT (!is_external (vec_no));
 	register_handler (vec_no, dpl, level, handler, name);
 }
 
@@ -256,7 +362,9 @@ intr_register_int (uint8_t vec_no, int dpl, enum intr_level level,
    and false at all other times. */
 bool
 intr_context (void) {
-	return in_external_intr;
+	/* With interrupts on we cannot be in a handler, and another
+	   CPU may be. */
+	return intr_get_level () == INTR_OFF && in_external_intr;
 }
 
 /* During processing of an external interrupt, directs the
@@ -333,24 +441,43 @@ intr_handler (struct intr_frame *frame) {
 	bool external;
 	intr_handler_func *handler;
 
+	/* The CPU that asks for a TLB flush waits for it with the
+	   interrupt lock held, so answer without taking the lock. */
+	if (frame->vec_no == LAPIC_VEC_TLB) {
+		smp_tlb_flush ();
+		lapic_eoi ();
+		return;
+	}
+
+	/* If the interrupted code had interrupts on, take the
+	   interrupt lock for it, as intr_disable() would.  Handlers
+	   entered through trap gates still have interrupts on. */
+	if ((frame->eflags & FLAG_IF) && intr_get_level () == INTR_OFF)
+		intr_lock_acquire ();
+
 	/* External interrupts are special.
 	   We only handle one at a time (so interrupts must be off)
-	   and they need to be acknowledged on the PIC (see below).
+	   and they need to be acknowledged on the PIC or the local
+	   APIC (see below).
 	   An external interrupt handler cannot sleep. */
-	external = frame->vec_no >= 0x20 && frame->vec_no < 0x30;
+	external = is_external (frame->vec_no);
 	if (external) {
 		ASSERT (intr_get_level () == INTR_OFF);
 		ASSERT (!intr_context ());
 
 		in_external_intr = true;
 		yield_on_return = false;
+
+		/* Catch up on ticks skipped by a tickless idle. */
+		timer_irq_enter ();
 	}
 
 	/* Invoke the interrupt's handler. */
 	handler = intr_handlers[frame->vec_no];
 	if (handler != NULL)
 		handler (frame);
-	else if (frame->vec_no == 0x27 || frame->vec_no == 0x2f) {
+	else if (frame->vec_no == 0x27 || frame->vec_no == 0x2f
+			|| frame->vec_no == LAPIC_VEC_SPURIOUS) {
 		/* There is no handler, but this interrupt can trigger
 		   spuriously due to a hardware fault or hardware race
 		   condition.  Ignore it. */
@@ -367,11 +494,28 @@ intr_handler (struct intr_frame *frame) {
 		ASSERT (intr_context ());
 
 		in_external_intr = false;
-		pic_end_of_interrupt (frame->vec_no);
+		if (frame->vec_no < LAPIC_VEC_BASE)
+			pic_end_of_interrupt (frame->vec_no);
+		else if (frame->vec_no != LAPIC_VEC_SPURIOUS)
+			lapic_eoi ();
 
 		if (yield_on_return)
-			thread_yield ();
+			thread_preempt ();
 	}
+
+#ifdef USERPROG
+	/* Another thread of the process called exit(): stop on the
+	   way back to user mode. */
+	if (frame->cs == SEL_UCSEG && process_exiting ()) {
+		intr_enable ();
+		thread_exit ();
+	}
+#endif
+
+	/* Returning to code that had interrupts on gives the lock
+	   back, whether or not the handler turned them on itself. */
+	if ((frame->eflags & FLAG_IF) && intr_get_level () == INTR_OFF)
+		intr_lock_release ();
 }
 
 /* Dumps interrupt frame F to the console, for debugging. */
@@ -11,9 +11,15 @@
 
 /* A simple implementation of malloc().
 
-   The size of each request, in bytes, is rounded up to a power
-   of 2 and assigned to the "descriptor" that manages blocks of
-   that size.  The descriptor keeps a list of free blocks.  If
+   The size of each request, in bytes, is rounded up to the next
+   size class and assigned to the "descriptor" that manages
+   blocks of that size.  Size classes step by a quarter of each
+   power of 2 (16, 24, 32, 40, 48, 56, 64, 80, 96, ...), which
+   bounds the space lost to rounding to about 20% instead of 50%.
+   Each class is then stretched to the largest size that still
+   fits as many blocks in an arena, and classes that would fit
+   no more blocks than the next larger one are dropped.  The
+   descriptor keeps a list of free blocks.  If
    the free list is nonempty, one of its blocks is used to
    satisfy the request.
 
@@ -32,7 +38,14 @@
    because they're too big to fit in a single page with a
    descriptor.  We handle those by allocating contiguous pages
    with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   the beginning of the allocated block's arena header.
+
+   Freed big blocks of up to LARGE_CACHE_PAGES pages are kept in
+   a small cache, by page count, so that buffers that come and go
+   (paths, argument vectors, bounce buffers) do not go through
+   the page allocator each time.  The cache holds at most
+   LARGE_CACHE_MAX pages and is emptied whenever a big block
+   cannot get pages. */
 
 /* Descriptor. */
 struct desc {
@@ -40,6 +53,12 @@ struct desc {
 	size_t blocks_per_arena;    /* Number of blocks in an arena. */
 	struct list free_list;      /* List of free blocks. */
 	struct lock lock;           /* Lock. */
+
+	/* Statistics, protected by LOCK. */
+	size_t live;                /* Blocks in use. */
+	size_t arenas;              /* Arenas held. */
+	long long allocs;           /* # of allocations. */
+	long long req_bytes;        /* Bytes requested by all allocations. */
 };
 
 /* Magic number for detecting arena corruption. */
@@ -58,25 +77,139 @@ struct block {
 };
 
 /* Our set of descriptors. */
-static struct desc descs[10];   /* Descriptors. */
+static struct desc descs[32];   /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
+/* Big blocks of at most this many pages are cached when freed. */
+#define LARGE_CACHE_PAGES 8
+
+/* Most pages held by the big block cache. */
+#define LARGE_CACHE_MAX 32
+
+/* Big blocks. */
+static struct lock large_lock;  /* Protects everything below. */
+static struct list large_cache[LARGE_CACHE_PAGES + 1]; /* By page count. */
+static size_t large_cached;     /* Pages in large_cache. */
+static size_t large_live;       /* Big blocks in use. */
+static size_t large_pages;      /* Pages of big blocks in use. */
+static long long large_allocs;  /* # of big block allocations. */
+static long long large_hits;    /* # served from large_cache. */
+
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
 
 /* Initializes the malloc() descriptors. */
 void
 malloc_init (void) {
-	size_t block_size;
-
-	for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2) {
-		struct desc *d = &descs[desc_cnt++];
-		ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
-		d->block_size = block_size;
-		d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
-		list_init (&d->free_list);
-		lock_init (&d->lock);
+	const size_t usable = PGSIZE - sizeof (struct arena);
+	size_t base, step;
+
+	for (base = 16; base < PGSIZE / 2; base *= 2)
+		for (step = 0; step < 4; step++) {
+			size_t size = ROUND_UP (base + step * base / 4, sizeof (void *));
+			size_t blocks = usable / size;
+			struct desc *d;
+
+			/* Drop classes that fit no more blocks than the last one,
+			   and those that no longer fit two blocks in an arena. */
+			if (blocks < 2
+					|| (desc_cnt > 0 && descs[desc_cnt - 1].blocks_per_arena == blocks))
+				continue;
+
+			d = &descs[desc_cnt++];
+			ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
+			d->block_size = ROUND_DOWN (usable / blocks, sizeof (void *));
+			d->blocks_per_arena = blocks;
+			list_init (&d->free_list);
+			lock_init_adaptive (&d->lock);
+		}
+
+	lock_init (&large_lock);
+	for (step = 0; step <= LARGE_CACHE_PAGES; step++)
+		list_init (&large_cache[step]);
+}
+
+/* Gives every cached big block back to the page allocator. */
+static void
+large_flush (void) {
+	size_t i;
+
+	lock_acquire (&large_lock);
+	for (i = 1; i <= LARGE_CACHE_PAGES; i++)
+		while (!list_empty (&large_cache[i])) {
+			struct block *b = list_entry (list_pop_front (&large_cache[i]),
+					struct block, free_elem);
+
+			palloc_free_multiple (block_to_arena (b), i);
+			large_cached -= i;
+		}
+	lock_release (&large_lock);
+}
+
+/* Obtains and returns a big block of at least SIZE bytes, from
+   the cache if one of the right page count is there.  Returns a
+   null pointer if memory is not available. */
+static void *
+large_alloc (size_t size) {
+	size_t page_cnt = DIV_ROUND_UP (size + sizeof (struct arena), PGSIZE);
+	struct arena *a = NULL;
+
+	lock_acquire (&large_lock);
+	if (page_cnt <= LARGE_CACHE_PAGES && !list_empty (&large_cache[page_cnt])) {
+		struct block *b = list_entry (list_pop_front (&large_cache[page_cnt]),
+				struct block, free_elem);
+
+		a = block_to_arena (b);
+		large_cached -= page_cnt;
+		large_hits++;
 	}
+	lock_release (&large_lock);
+
+	if (a == NULL) {
+		a = palloc_get_multiple (0, page_cnt);
+		if (a == NULL && large_cached > 0) {
+			large_flush ();
+			a = palloc_get_multiple (0, page_cnt);
+		}
+		if (a == NULL)
+			return NULL;
+
+		/* Initialize the arena to indicate a big block of PAGE_CNT
+		   pages. */
+		a->magic = ARENA_MAGIC;
+		a->desc = NULL;
+		a->free_cnt = page_cnt;
+	}
+
+	lock_acquire (&large_lock);
+	large_live++;
+	large_pages += page_cnt;
+	large_allocs++;
+	lock_release (&large_lock);
+	return a + 1;
+}
+
+/* Frees big block A, keeping it in the cache if there is room. */
+static void
+large_free (struct arena *a) {
+	size_t page_cnt = a->free_cnt;
+	bool cached = false;
+
+	lock_acquire (&large_lock);
+	large_live--;
+	large_pages -= page_cnt;
+	if (page_cnt <= LARGE_CACHE_PAGES
+			&& large_cached + page_cnt <= LARGE_CACHE_MAX) {
+		struct block *b = (struct block *) (a + 1);
+
+		list_push_front (&large_cache[page_cnt], &b->free_elem);
+		large_cached += page_cnt;
+		cached = true;
+	}
+	lock_release (&large_lock);
+
+	if (!cached)
+		palloc_free_multiple (a, page_cnt);
 }
 
 /* Obtains and returns a new block of at least SIZE bytes.
@@ -99,17 +232,7 @@ malloc (size_t size) {
 	if (d == descs + desc_cnt) {
 		/* SIZE is too big for any descriptor.
 		   Allocate enough pages to hold SIZE plus an arena. */
-		size_t page_cnt = DIV_ROUND_UP (size + sizeof *a, PGSIZE);
-		a = palloc_get_multiple (0, page_cnt);
-		if (a == NULL)
-			return NULL;
-
-		/* Initialize the arena to indicate a big block of PAGE_CNT
-		   pages, and return it. */
-		a->magic = ARENA_MAGIC;
-		a->desc = NULL;
-		a->free_cnt = page_cnt;
-		return a + 1;
+		return large_alloc (size);
 	}
 
 	lock_acquire (&d->lock);
@@ -133,12 +256,16 @@ malloc (size_t size) {
 			struct block *b = arena_to_block (a, i);
 			list_push_back (&d->free_list, &b->free_elem);
 		}
+		d->arenas++;
 	}
 
 	/* Get a block from free list and return it. */
 	b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
 	a = block_to_arena (b);
 	a->free_cnt--;
+	d->live++;
+	d->allocs++;
+	d->req_bytes += size;
 	lock_release (&d->lock);
 	return b;
 }
@@ -163,6 +290,19 @@ calloc (size_t a, size_t b) {
 	return p;
 }
 
+/* Returns the bytes of memory that malloc(SIZE) ties up, counting
+   the block's share of its arena, or the whole pages of a big
+   block. */
+size_t
+malloc_footprint (size_t size) {
+	struct desc *d;
+
+	for (d = descs; d < descs + desc_cnt; d++)
+		if (d->block_size >= size)
+			return PGSIZE / d->blocks_per_arena;
+	return DIV_ROUND_UP (size + sizeof (struct arena), PGSIZE) * PGSIZE;
+}
+
 /* Returns the number of bytes allocated for BLOCK. */
 static size_t
 block_size (void *block) {
@@ -217,6 +357,7 @@ free (void *p) {
 
 			/* Add block to free list. */
 			list_push_front (&d->free_list, &b->free_elem);
+			d->live--;
 
 			/* If the arena is now entirely unused, free it. */
 			if (++a->free_cnt >= d->blocks_per_arena) {
@@ -228,17 +369,53 @@ free (void *p) {
 					list_remove (&b->free_elem);
 				}
 				palloc_free_page (a);
+				d->arenas--;
 			}
 
 			lock_release (&d->lock);
 		} else {
-			/* It's a big block.  Free its pages. */
-			palloc_free_multiple (a, a->free_cnt);
+			/* It's a big block.  Cache or free its pages. */
+			large_free (a);
 			return;
 		}
 	}
 }
 
+/* Prints statistics for each descriptor that has been used and
+   for big blocks.  "In use" is the share of the descriptor's
+   arena pages taken by live blocks; "waste" is the share of
+   allocated block bytes that requests did not ask for. */
+void
+malloc_print_stats (void) {
+	struct desc *d;
+
+	for (d = descs; d < descs + desc_cnt; d++) {
+		size_t live, arenas;
+		long long allocs, req_bytes;
+
+		lock_acquire (&d->lock);
+		live = d->live;
+		arenas = d->arenas;
+		allocs = d->allocs;
+		req_bytes = d->req_bytes;
+		lock_release (&d->lock);
+
+		if (allocs == 0)
+			continue;
+		printf ("Malloc %zu: %zu live in %zu arenas (%zu%% in use), "
+				"%lld allocs, %lld%% waste\n",
+				d->block_size, live, arenas,
+				arenas > 0 ? live * d->block_size * 100 / (arenas * PGSIZE) : 0,
+				allocs, 100 - req_bytes * 100 / (allocs * (long long) d->block_size));
+	}
+
+	lock_acquire (&large_lock);
+	printf ("Malloc big: %zu live in %zu pages, %lld allocs, "
+			"%lld from cache, %zu pages cached\n",
+			large_live, large_pages, large_allocs, large_hits, large_cached);
+	lock_release (&large_lock);
+}
+
 /* Returns the arena that block B is inside. */
 static struct arena *
 block_to_arena (struct block *b) {
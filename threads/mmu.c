@@ -4,6 +4,9 @@
 #include "threads/init.h"
 #include "threads/pte.h"
 #include "threads/palloc.h"
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+#include "threads/smp.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
 #include "intrinsic.h"
@@ -203,7 +206,23 @@ pml4_destroy (uint64_t *pml4) {
  * register. */
 void
 pml4_activate (uint64_t *pml4) {
+	enum intr_level old_level = intr_disable ();
+
 	lcr3 (vtop (pml4 ? pml4 : base_pml4));
+	this_cpu ()->pml4 = pml4;
+	intr_set_level (old_level);
+}
+
+/* Drops any TLB entry for VPAGE in PML4, on this CPU and on every
+ * other CPU that has PML4 loaded. */
+static void
+tlb_invalidate (uint64_t *pml4, const void *vpage) {
+	enum intr_level old_level = intr_disable ();
+
+	if (rcr3 () == vtop (pml4))
+		invlpg ((uint64_t) vpage);
+	smp_tlb_shootdown (pml4);
+	intr_set_level (old_level);
 }
 
 /* Looks up the physical address that corresponds to user virtual
@@ -257,8 +276,7 @@ pml4_clear_page (uint64_t *pml4, void *upage) {
 
 	if (pte != NULL && (*pte & PTE_P) != 0) {
 		*pte &= ~PTE_P;
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) upage);
+		tlb_invalidate (pml4, upage);
 	}
 }
 
@@ -283,8 +301,7 @@ pml4_set_dirty (uint64_t *pml4, const void *vpage, bool dirty) {
 		else
 			*pte &= ~(uint32_t) PTE_D;
 
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) vpage);
+		tlb_invalidate (pml4, vpage);
 	}
 }
 
@@ -309,7 +326,6 @@ pml4_set_accessed (uint64_t *pml4, const void *vpage, bool accessed) {
 		else
 			*pte &= ~(uint32_t) PTE_A;
 
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) vpage);
+		tlb_invalidate (pml4, vpage);
 	}
 }
@@ -1,15 +1,18 @@
 #include "threads/palloc.h"
-#include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
 
 /* Page allocator.  Hands out memory in page-size (or
@@ -24,24 +27,106 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Each pool is a binary buddy allocator.  Free pages form blocks
+   of 2**ORDER pages, aligned to their size relative to the pool
+   base, kept on one free list per order.  An allocation takes a
+   block of the smallest sufficient order, splitting larger ones,
+   and returns the pages it does not need to the free lists; a
+   free merges each block with its buddy for as long as the buddy
+   is free too.  Both take O(log n) steps.
+
+   A free block's list_elem lives in its first page.  The only
+   other state is a byte per page, so that the buddy of a block
+   can be checked without touching its memory.  The byte also
+   records whether the page is free, or cached in a magazine or
+   the zeroed pages below, so that freeing a page twice trips an
+   assertion instead of corrupting the free lists.
+
+   Single pages, which are most allocations (user frames, page
+   tables, thread stacks), are first served from and freed to a
+   small per-CPU stack of free pages for each pool, a magazine.
+   A magazine is guarded by a spinlock of its own that other CPUs
+   take only to reclaim its pages.  Its own CPU turns interrupts
+   off around it with intr_disable_local(), which skips the
+   interrupt lock that intr_disable() takes with several CPUs, so
+   the common case neither contends nor sleeps.  An empty magazine
+   is refilled, and a full one drained, MAG_BATCH pages at a time
+   under the pool lock.
+   When an allocation fails, the pages cached in every CPU's
+   magazine are handed back to the buddy allocator and the
+   allocation is retried, since a multi-page block may be split
+   across them.
+
+   Each pool also keeps a small stack of free pages that are
+   already zeroed, for single-page PAL_ZERO allocations (page
+   tables, argument copies, user stacks).  The idle thread tops
+   the stack up from the pool's free blocks, one page each time
+   its CPU finds nothing else to run, so the zeroing only uses
+   time that would otherwise be spent halted and never competes
+   with a ready thread.  It zeroes with non-temporal stores, which
+   do not evict the working set of whoever runs next from the
+   cache.  Zeroed pages still count as free: when a
+   pool runs out of other pages, its zeroed pages are handed back
+   to the buddy allocator. */
+
+#define ZERO_MAX 32             /* Pre-zeroed pages a pool keeps. */
+
+/* Bits of a pool's page_state bytes.  A page that is allocated
+   and not cached has state 0. */
+#define PS_ORDER 0x1f           /* 1 + order, if first page of a free
+                                   block, else 0. */
+#define PS_CACHED 0x40          /* In a magazine or the zeroed pages. */
+#define PS_FREE 0x80            /* In a free block. */
 
 /* A memory pool. */
 struct pool {
 	struct lock lock;               /* Mutual exclusion. */
-	struct bitmap *used_map;        /* Bitmap of free pages. */
 	uint8_t *base;                  /* Base of pool. */
+	size_t page_cnt;                /* Number of pages in pool. */
+	uint8_t *page_state;            /* Per page: PS_* bits. */
+	struct list free[PAL_ORDERS];   /* Free blocks of each order. */
+	size_t free_cnt[PAL_ORDERS];    /* Number of blocks in each list. */
+
+	/* Pre-zeroed free pages.  The holder of ZERO_LOCK must keep
+	   interrupts off. */
+	struct spinlock zero_lock;      /* Protects the members below. */
+	void *zeroed[ZERO_MAX];         /* Zeroed pages, most recent last. */
+	size_t zeroed_cnt;              /* Number of pages in ZEROED. */
+	long long zero_reqs;            /* PAL_ZERO allocations. */
+	long long zero_hits;            /* ...served from ZEROED. */
 };
 
 /* Two pools: one for kernel data, one for user pages. */
 static struct pool kernel_pool, user_pool;
 
+#define MAG_SIZE 32             /* Pages a magazine holds. */
+#define MAG_BATCH 16            /* Pages per refill or drain. */
+
+/* A CPU's cache of free pages from one pool. */
+struct magazine {
+	struct spinlock lock;       /* Protects CNT and PAGES. */
+	size_t cnt;                 /* Number of pages in PAGES. */
+	void *pages[MAG_SIZE];      /* Free pages, most recent last. */
+
+	/* Statistics. */
+	long long hits;             /* Allocations served from PAGES. */
+	long long refills;          /* Batches taken from the pool. */
+	long long drains;           /* Batches returned to the pool. */
+};
+
+/* Magazines of each CPU, for the kernel pool and the user pool. */
+static struct magazine magazines[NCPU_MAX][2];
+
 /* Maximum number of pages to put in user pool. */
 size_t user_page_limit = SIZE_MAX;
+
 static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end);
 
 static bool page_from_pool (const struct pool *, void *page);
+static void free_range (struct pool *, size_t page_idx, size_t page_cnt);
 
 /* multiboot info */
 struct multiboot_info {
@@ -219,16 +304,16 @@ split:
 			else
 				NOT_REACHED ();
 
-			pool_end = pool->base + bitmap_size (pool->used_map) * PGSIZE;
+			pool_end = pool->base + pool->page_cnt * PGSIZE;
 			page_idx = pg_no (start) - pg_no (pool->base);
 			if ((uint64_t) pool_end < end) {
 				page_cnt = ((uint64_t) pool_end - start) / PGSIZE;
-				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+				free_range (pool, page_idx, page_cnt);
 				start = (uint64_t) pool_end;
 				goto split;
 			} else {
 				page_cnt = ((uint64_t) end - start) / PGSIZE;
-				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+				free_range (pool, page_idx, page_cnt);
 			}
 		}
 	}
@@ -253,25 +338,449 @@ palloc_init (void) {
 	return ext_mem.end;
 }
 
+/* Returns the smallest order whose blocks hold PAGE_CNT pages. */
+static int
+order_of (size_t page_cnt) {
+	int order = 0;
+
+	while (((size_t) 1 << order) < page_cnt)
+		order++;
+	return order;
+}
+
+/* Returns the list_elem stored in the first page of free block
+   PAGE_IDX of POOL. */
+static struct list_elem *
+block_elem (struct pool *pool, size_t page_idx) {
+	return (struct list_elem *) (pool->base + PGSIZE * page_idx);
+}
+
+/* Puts free block PAGE_IDX of 2**ORDER pages on POOL's free
+   list, without merging it. */
+static void
+push_block (struct pool *pool, size_t page_idx, int order) {
+	pool->page_state[page_idx] = PS_FREE | (order + 1);
+	list_push_front (&pool->free[order], block_elem (pool, page_idx));
+	pool->free_cnt[order]++;
+}
+
+/* Takes free block PAGE_IDX of 2**ORDER pages off POOL's free
+   list. */
+static void
+pop_block (struct pool *pool, size_t page_idx, int order) {
+	ASSERT (pool->page_state[page_idx] == (PS_FREE | (order + 1)));
+
+	pool->page_state[page_idx] = PS_FREE;
+	list_remove (block_elem (pool, page_idx));
+	pool->free_cnt[order]--;
+}
+
+/* Frees block PAGE_IDX of 2**ORDER pages in POOL, merging it
+   with its buddy while the buddy is free.  Every page of the block
+   must be allocated. */
+static void
+free_block (struct pool *pool, size_t page_idx, int order) {
+	size_t i;
+
+	for (i = page_idx; i < page_idx + ((size_t) 1 << order); i++) {
+		ASSERT (pool->page_state[i] == 0);
+		pool->page_state[i] = PS_FREE;
+	}
+
+	while (order < PAL_ORDERS - 1) {
+		size_t buddy = page_idx ^ ((size_t) 1 << order);
+
+		if (buddy + ((size_t) 1 << order) > pool->page_cnt
+				|| pool->page_state[buddy] != (PS_FREE | (order + 1)))
+			break;
+		pop_block (pool, buddy, order);
+		if (buddy < page_idx)
+			page_idx = buddy;
+		order++;
+	}
+	push_block (pool, page_idx, order);
+}
+
+/* Frees the PAGE_CNT pages of POOL starting at PAGE_IDX, as the
+   largest aligned blocks that cover them. */
+static void
+free_range (struct pool *pool, size_t page_idx, size_t page_cnt) {
+	while (page_cnt > 0) {
+		int order = 0;
+
+		while (order < PAL_ORDERS - 1
+				&& page_idx % ((size_t) 2 << order) == 0
+				&& ((size_t) 2 << order) <= page_cnt)
+			order++;
+		free_block (pool, page_idx, order);
+		page_idx += (size_t) 1 << order;
+		page_cnt -= (size_t) 1 << order;
+	}
+}
+
+/* Allocates PAGE_CNT contiguous pages from POOL and returns the
+   index of the first one, or SIZE_MAX if no block is big
+   enough.  POOL's lock must be held. */
+static size_t
+alloc_range (struct pool *pool, size_t page_cnt) {
+	int order = order_of (page_cnt);
+	size_t page_idx;
+	int o;
+
+	for (o = order; o < PAL_ORDERS; o++)
+		if (!list_empty (&pool->free[o]))
+			break;
+	if (o >= PAL_ORDERS)
+		return SIZE_MAX;
+
+	page_idx = ((uint8_t *) list_front (&pool->free[o]) - pool->base) / PGSIZE;
+	pop_block (pool, page_idx, o);
+
+	/* Split down to ORDER, freeing the upper halves. */
+	while (o > order) {
+		o--;
+		push_block (pool, page_idx + ((size_t) 1 << o), o);
+	}
+
+	/* Mark the block allocated, then give back the tail we do not
+	   need. */
+	memset (pool->page_state + page_idx, 0, (size_t) 1 << order);
+	free_range (pool, page_idx + page_cnt, ((size_t) 1 << order) - page_cnt);
+	return page_idx;
+}
+
+/* Marks PAGE, an allocated page of POOL, as cached. */
+static void
+cache_page (struct pool *pool, void *page) {
+	size_t page_idx = pg_no (page) - pg_no (pool->base);
+
+	ASSERT (pool->page_state[page_idx] == 0);
+	pool->page_state[page_idx] = PS_CACHED;
+}
+
+/* Marks PAGE, a cached page of POOL, as allocated again. */
+static void
+uncache_page (struct pool *pool, void *page) {
+	size_t page_idx = pg_no (page) - pg_no (pool->base);
+
+	ASSERT (pool->page_state[page_idx] == PS_CACHED);
+	pool->page_state[page_idx] = 0;
+}
+
+/* Frees the CNT cached pages in BATCH to POOL's free blocks. */
+static void
+free_cached (struct pool *pool, void **batch, size_t cnt) {
+	size_t i;
+
+	if (cnt == 0)
+		return;
+
+	lock_acquire (&pool->lock);
+	for (i = 0; i < cnt; i++) {
+		uncache_page (pool, batch[i]);
+		free_range (pool, pg_no (batch[i]) - pg_no (pool->base), 1);
+	}
+	lock_release (&pool->lock);
+}
+
+/* Locks and returns the running CPU's magazine for POOL.
+   Interrupts must be off. */
+static struct magazine *
+this_magazine (const struct pool *pool) {
+	struct magazine *m;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	m = &magazines[this_cpu ()->id][pool == &user_pool];
+	spin_lock (&m->lock);
+	return m;
+}
+
+/* Allocates a page from POOL through the running CPU's magazine,
+   refilling the magazine from POOL if it is empty.  Returns a
+   null pointer if POOL has no free page. */
+static void *
+mag_get (struct pool *pool) {
+	void *batch[MAG_BATCH];
+	enum intr_level old_level;
+	struct magazine *m;
+	void *page = NULL;
+	size_t cnt, i;
+
+	old_level = intr_disable_local ();
+	m = this_magazine (pool);
+	if (m->cnt > 0) {
+		page = m->pages[--m->cnt];
+		uncache_page (pool, page);
+		m->hits++;
+	}
+	spin_unlock (&m->lock);
+	intr_restore_local (old_level);
+	if (page != NULL)
+		return page;
+
+	/* Refill.  We may sleep on the lock, so the magazine may
+	   have changed, or be another CPU's, by the time we put the
+	   batch in it. */
+	lock_acquire (&pool->lock);
+	for (cnt = 0; cnt < MAG_BATCH; cnt++) {
+		size_t page_idx = alloc_range (pool, 1);
+
+		if (page_idx == SIZE_MAX)
+			break;
+		batch[cnt] = pool->base + PGSIZE * page_idx;
+	}
+	lock_release (&pool->lock);
+	if (cnt == 0)
+		return NULL;
+
+	page = batch[--cnt];
+	old_level = intr_disable_local ();
+	m = this_magazine (pool);
+	m->refills++;
+	while (cnt > 0 && m->cnt < MAG_SIZE)
+	{
+		cache_page (pool, batch[--cnt]);
+		m->pages[m->cnt++] = batch[cnt];
+	}
+	spin_unlock (&m->lock);
+	intr_restore_local (old_level);
+
+	/* Return what did not fit. */
+	if (cnt > 0) {
+		lock_acquire (&pool->lock);
+		for (i = 0; i < cnt; i++)
+			free_range (pool, pg_no (batch[i]) - pg_no (pool->base), 1);
+		lock_release (&pool->lock);
+	}
+	return page;
+}
+
+/* Frees PAGE, from POOL, to the running CPU's magazine, first
+   draining the magazine to POOL if it is full. */
+static void
+mag_put (struct pool *pool, void *page) {
+	void *batch[MAG_BATCH];
+	enum intr_level old_level;
+	struct magazine *m;
+	size_t cnt = 0;
+
+	old_level = intr_disable_local ();
+	m = this_magazine (pool);
+	if (m->cnt == MAG_SIZE) {
+		while (cnt < MAG_BATCH)
+			batch[cnt++] = m->pages[--m->cnt];
+		m->drains++;
+	}
+	cache_page (pool, page);
+	m->pages[m->cnt++] = page;
+	spin_unlock (&m->lock);
+	intr_restore_local (old_level);
+
+	free_cached (pool, batch, cnt);
+}
+
+/* Returns the pages in the running CPU's magazines to their
+   pools, so that palloc_get_stats() shows them as merged free
+   blocks. */
+void
+palloc_drain_magazines (void) {
+	struct pool *pools[2] = { &kernel_pool, &user_pool };
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		struct pool *pool = pools[i];
+		void *batch[MAG_SIZE];
+		enum intr_level old_level;
+		struct magazine *m;
+		size_t cnt = 0;
+
+		old_level = intr_disable_local ();
+		m = this_magazine (pool);
+		while (m->cnt > 0)
+			batch[cnt++] = m->pages[--m->cnt];
+		if (cnt > 0)
+			m->drains++;
+		spin_unlock (&m->lock);
+		intr_restore_local (old_level);
+
+		free_cached (pool, batch, cnt);
+	}
+}
+
+/* Returns the pages in every CPU's magazine for POOL to POOL's
+   free blocks, because POOL has too few free pages left outside
+   them.  Returns the number of pages returned. */
+static size_t
+mag_reclaim (struct pool *pool) {
+	size_t total = 0;
+	int i;
+
+	for (i = 0; i < ncpu; i++) {
+		struct magazine *m = &magazines[i][pool == &user_pool];
+		void *batch[MAG_SIZE];
+		enum intr_level old_level;
+		size_t cnt = 0;
+
+		old_level = intr_disable ();
+		spin_lock (&m->lock);
+		while (m->cnt > 0)
+			batch[cnt++] = m->pages[--m->cnt];
+		if (cnt > 0)
+			m->drains++;
+		spin_unlock (&m->lock);
+		intr_set_level (old_level);
+
+		free_cached (pool, batch, cnt);
+		total += cnt;
+	}
+	return total;
+}
+
+/* Counts a PAL_ZERO request for PAGE_CNT pages from POOL and, for
+   a single page, pops and returns a pre-zeroed page if there is
+   one.  Returns a null pointer otherwise. */
+static void *
+zero_get (struct pool *pool, size_t page_cnt) {
+	enum intr_level old_level;
+	void *page = NULL;
+
+	old_level = intr_disable ();
+	spin_lock (&pool->zero_lock);
+	pool->zero_reqs++;
+	if (page_cnt == 1 && pool->zeroed_cnt > 0) {
+		page = pool->zeroed[--pool->zeroed_cnt];
+		uncache_page (pool, page);
+		pool->zero_hits++;
+	}
+	spin_unlock (&pool->zero_lock);
+	intr_set_level (old_level);
+	return page;
+}
+
+/* Returns POOL's pre-zeroed pages to its free blocks, because
+   POOL has run out of other free pages.  Returns the number of
+   pages returned. */
+static size_t
+zero_reclaim (struct pool *pool) {
+	void *batch[ZERO_MAX];
+	enum intr_level old_level;
+	size_t cnt = 0;
+
+	old_level = intr_disable ();
+	spin_lock (&pool->zero_lock);
+	while (pool->zeroed_cnt > 0)
+		batch[cnt++] = pool->zeroed[--pool->zeroed_cnt];
+	spin_unlock (&pool->zero_lock);
+	intr_set_level (old_level);
+
+	free_cached (pool, batch, cnt);
+	return cnt;
+}
+
+/* Fills PAGE with zeros using non-temporal stores, which bypass
+   the cache. */
+static void
+zero_page_nt (void *page) {
+	uint64_t *p = page;
+	size_t i;
+
+	for (i = 0; i < PGSIZE / sizeof *p; i += 4)
+		asm volatile ("movnti %1, (%0)\n\t"
+				"movnti %1, 8(%0)\n\t"
+				"movnti %1, 16(%0)\n\t"
+				"movnti %1, 24(%0)"
+				: : "r" (p + i), "r" ((uint64_t) 0) : "memory");
+
+	/* Non-temporal stores are weakly ordered.  Make them visible
+	   before the page is handed out. */
+	asm volatile ("sfence" : : : "memory");
+}
+
+/* Zeroes one free page of POOL and adds it to POOL's zeroed
+   pages, if they are fewer than ZERO_MAX.  Returns false if there
+   was nothing to do, or if POOL's lock is held, since the caller
+   must not sleep.  Interrupts must be off. */
+static bool
+zero_one (struct pool *pool) {
+	size_t page_idx;
+	uint8_t *page;
+	bool full;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	spin_lock (&pool->zero_lock);
+	full = pool->zeroed_cnt >= ZERO_MAX;
+	spin_unlock (&pool->zero_lock);
+	if (full || !lock_try_acquire (&pool->lock))
+		return false;
+
+	/* Only we add zeroed pages, and we hold POOL's lock, so there
+	   is still room for one when we are done. */
+	page_idx = alloc_range (pool, 1);
+	if (page_idx != SIZE_MAX) {
+		page = pool->base + PGSIZE * page_idx;
+		zero_page_nt (page);
+		spin_lock (&pool->zero_lock);
+		cache_page (pool, page);
+		pool->zeroed[pool->zeroed_cnt++] = page;
+		spin_unlock (&pool->zero_lock);
+	}
+	lock_release (&pool->lock);
+	return page_idx != SIZE_MAX;
+}
+
+/* Zeroes a free page ahead of PAL_ZERO requests, if a pool is
+   short of zeroed pages.  Called by the idle thread, with
+   interrupts off, when its CPU has nothing to run.  Returns false
+   if there was nothing to do. */
+bool
+palloc_zero_idle (void) {
+	return zero_one (&kernel_pool) || zero_one (&user_pool);
+}
+
+/* Allocates PAGE_CNT contiguous pages from POOL, through the
+   running CPU's magazine for a single page.  Returns a null
+   pointer if POOL has too few free pages. */
+static void *
+get_pages (struct pool *pool, size_t page_cnt) {
+	size_t page_idx;
+
+	if (page_cnt == 1)
+		return mag_get (pool);
+
+	lock_acquire (&pool->lock);
+	page_idx = alloc_range (pool, page_cnt);
+	lock_release (&pool->lock);
+	return page_idx != SIZE_MAX ? pool->base + PGSIZE * page_idx : NULL;
+}
+
 /* Obtains and returns a group of PAGE_CNT contiguous free pages.
    If PAL_USER is set, the pages are obtained from the user pool,
    otherwise from the kernel pool.  If PAL_ZERO is set in FLAGS,
-   then the pages are filled with zeros.  If too few pages are
-   available, returns a null pointer, unless PAL_ASSERT is set in
-   FLAGS, in which case the kernel panics. */
+   then the pages are filled with zeros, or come from the pool's
+   pre-zeroed pages.  If too few pages are available, returns a
+   null pointer, unless PAL_ASSERT is set in FLAGS, in which case
+   the kernel panics. */
 void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
 	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
-
-	lock_acquire (&pool->lock);
-	size_t page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-	lock_release (&pool->lock);
 	void *pages;
 
-	if (page_idx != BITMAP_ERROR)
-		pages = pool->base + PGSIZE * page_idx;
-	else
-		pages = NULL;
+	if (page_cnt == 0)
+		return NULL;
+
+	if (flags & PAL_ZERO) {
+		pages = zero_get (pool, page_cnt);
+		if (pages != NULL)
+			return pages;
+	}
+
+	/* Free pages cached in magazines or among the zeroed pages
+	   are invisible to alloc_range(). */
+	pages = get_pages (pool, page_cnt);
+	if (pages == NULL && zero_reclaim (pool) + mag_reclaim (pool) > 0)
+		pages = get_pages (pool, page_cnt);
 
 	if (pages) {
 		if (flags & PAL_ZERO)
@@ -318,8 +827,13 @@ palloc_free_multiple (void *pages, size_t page_cnt) {
 #ifndef NDEBUG
 	memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
-	ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
-	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+	if (page_cnt == 1) {
+		mag_put (pool, pages);
+		return;
+	}
+	lock_acquire (&pool->lock);
+	free_range (pool, page_idx, page_cnt);
+	lock_release (&pool->lock);
 }
 
 /* Frees the page at PAGE. */
@@ -331,18 +845,28 @@ palloc_free_page (void *page) {
 /* Initializes pool P as starting at START and ending at END */
 static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end) {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
-     and subtract it from the pool's size. */
+  /* We'll put the pool's page_state array at *BM_BASE, past the
+     end of the kernel, and advance *BM_BASE past it. */
 	uint64_t pgcnt = (end - start) / PGSIZE;
-	size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (pgcnt), PGSIZE) * PGSIZE;
+	size_t bm_pages = DIV_ROUND_UP (pgcnt, PGSIZE) * PGSIZE;
+	int order, i;
 
-	lock_init(&p->lock);
-	p->used_map = bitmap_create_in_buf (pgcnt, *bm_base, bm_pages);
+	lock_init_adaptive (&p->lock);
 	p->base = (void *) start;
+	p->page_cnt = pgcnt;
+	p->page_state = *bm_base;
+	for (order = 0; order < PAL_ORDERS; order++) {
+		list_init (&p->free[order]);
+		p->free_cnt[order] = 0;
+	}
+	spinlock_init (&p->zero_lock);
+	for (i = 0; i < NCPU_MAX; i++)
+		spinlock_init (&magazines[i][p == &user_pool].lock);
+	p->zeroed_cnt = 0;
+	p->zero_reqs = p->zero_hits = 0;
 
 	// Mark all to unusable.
-	bitmap_set_all(p->used_map, true);
+	memset (p->page_state, 0, pgcnt);
 
 	*bm_base += bm_pages;
 }
@@ -353,6 +877,75 @@ static bool
 page_from_pool (const struct pool *pool, void *page) {
 	size_t page_no = pg_no (page);
 	size_t start_page = pg_no (pool->base);
-	size_t end_page = start_page + bitmap_size (pool->used_map);
+	size_t end_page = start_page + pool->page_cnt;
 	return page_no >= start_page && page_no < end_page;
 }
+
+/* Fills in STATS for the user pool if USER is true, otherwise
+   for the kernel pool. */
+void
+palloc_get_stats (bool user, struct palloc_stats *stats) {
+	struct pool *pool = user ? &user_pool : &kernel_pool;
+	enum intr_level old_level;
+	int order, i;
+
+	lock_acquire (&pool->lock);
+	stats->page_cnt = pool->page_cnt;
+	stats->free_pages = 0;
+	for (order = 0; order < PAL_ORDERS; order++) {
+		stats->free_blocks[order] = pool->free_cnt[order];
+		stats->free_pages += pool->free_cnt[order] << order;
+	}
+	lock_release (&pool->lock);
+
+	/* Other CPUs' magazines may change as we read them, so these
+	   are only a snapshot. */
+	stats->cached_pages = 0;
+	stats->mag_hits = stats->mag_refills = stats->mag_drains = 0;
+	old_level = intr_disable ();
+	spin_lock (&pool->zero_lock);
+	stats->zeroed_pages = pool->zeroed_cnt;
+	stats->zero_reqs = pool->zero_reqs;
+	stats->zero_hits = pool->zero_hits;
+	spin_unlock (&pool->zero_lock);
+	for (i = 0; i < NCPU_MAX; i++) {
+		const struct magazine *m = &magazines[i][user];
+
+		stats->cached_pages += m->cnt;
+		stats->mag_hits += m->hits;
+		stats->mag_refills += m->refills;
+		stats->mag_drains += m->drains;
+	}
+	intr_set_level (old_level);
+	stats->free_pages += stats->cached_pages + stats->zeroed_pages;
+}
+
+/* Prints the free pages of POOL, called NAME, by block order. */
+static void
+print_pool_stats (const char *name, bool user) {
+	struct palloc_stats stats;
+	int order, top;
+
+	palloc_get_stats (user, &stats);
+	printf ("%s pool: %zu of %zu pages free; free blocks by order:",
+			name, stats.free_pages, stats.page_cnt);
+	for (top = PAL_ORDERS - 1; top > 0 && stats.free_blocks[top] == 0; top--)
+		continue;
+	for (order = 0; order <= top; order++)
+		printf (" %zu", stats.free_blocks[order]);
+	printf ("\n");
+	printf ("%s pool magazines: %zu pages cached, %lld hits, "
+			"%lld refills, %lld drains\n", name, stats.cached_pages,
+			stats.mag_hits, stats.mag_refills, stats.mag_drains);
+	printf ("%s pool zeroing: %zu pages zeroed ahead, %lld of %lld "
+			"PAL_ZERO requests served without zeroing (%lld%%)\n", name,
+			stats.zeroed_pages, stats.zero_hits, stats.zero_reqs,
+			stats.zero_reqs > 0 ? stats.zero_hits * 100 / stats.zero_reqs : 0);
+}
+
+/* Prints page allocator statistics. */
+void
+palloc_print_stats (void) {
+	print_pool_stats ("Kernel", false);
+	print_pool_stats ("User", true);
+}
@@ -0,0 +1,267 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Object caches.
+
+   An object cache hands out objects of a single size, carved out
+   of page-size slabs, so that small structures allocated once per
+   page of memory or per open file pay neither malloc()'s rounding
+   to a power of two nor the lock of a descriptor shared with
+   unrelated allocations.
+
+   A slab page starts with a struct slab, followed by one 16-bit
+   free-list link per object and then the objects themselves.  The
+   links live outside the objects so that a free object keeps the
+   state its constructor gave it.  Each cache keeps its slabs on
+   three lists, by whether they are partly used, full, or empty,
+   and allocates from partly used slabs first so that empty ones
+   can be given back.  One empty slab is kept to avoid allocating
+   and freeing a page when a single object comes and goes.
+
+   Each cache is shared by all CPUs behind one lock, with no
+   per-CPU front end like palloc's magazines.  The lock is held
+   for a few list operations, and most allocations already run
+   under a wider lock: frames under the global frame_lock, inodes
+   under open_inodes_lock, and pages and file_infos under the
+   process's SPT lock or while loading.  A per-CPU stash would
+   mostly move the contention to those locks. */
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* Objects are aligned to this many bytes. */
+#define SLAB_ALIGN 8
+
+/* Free-list link meaning "no more free objects". */
+#define SLAB_END UINT16_MAX
+
+/* An object cache. */
+struct kmem_cache {
+	char name[16];              /* Name, for statistics. */
+	size_t obj_size;            /* Size passed to kmem_cache_create(). */
+	size_t slot_size;           /* OBJ_SIZE rounded up to SLAB_ALIGN. */
+	size_t objs_per_slab;       /* Objects in a slab. */
+	size_t first_ofs;           /* Offset of the first object in a slab. */
+	kmem_ctor *ctor;            /* Constructor, or a null pointer. */
+	struct lock lock;           /* Protects everything below. */
+	struct list partial;        /* Slabs with used and free objects. */
+	struct list full;           /* Slabs with no free object. */
+	struct list empty;          /* Slabs with no used object. */
+	size_t slabs;               /* Number of slabs. */
+	size_t live;                /* Objects in use. */
+	long long allocs;           /* # of allocations. */
+	struct list_elem elem;      /* Element in all_caches. */
+};
+
+/* Header of a slab page. */
+struct slab {
+	unsigned magic;             /* Always SLAB_MAGIC. */
+	struct kmem_cache *cache;   /* Owning cache. */
+	struct list_elem elem;      /* Element in one of cache's lists. */
+	size_t free_cnt;            /* Number of free objects. */
+	uint16_t free_head;         /* First free object, or SLAB_END. */
+	uint16_t next[];            /* Next free object after each one. */
+};
+
+/* All caches, for statistics. */
+static struct list all_caches;
+
+/* Initializes the object cache allocator.  Called once, after
+   malloc_init(), before any cache is created. */
+void
+kmem_cache_init (void) {
+	list_init (&all_caches);
+}
+
+/* Returns the offset of the first object in a slab holding CNT
+   objects. */
+static size_t
+first_ofs (size_t cnt) {
+	return ROUND_UP (sizeof (struct slab) + cnt * sizeof (uint16_t), SLAB_ALIGN);
+}
+
+/* Creates a cache named NAME of SIZE-byte objects, calling CTOR,
+   if it is not null, on each object of each new slab.  Returns
+   the new cache, or a null pointer if memory is short.  SIZE must
+   leave room for at least one object in a page. */
+struct kmem_cache *
+kmem_cache_create (const char *name, size_t size, kmem_ctor *ctor) {
+	struct kmem_cache *c;
+	size_t slot_size = ROUND_UP (size > 0 ? size : 1, SLAB_ALIGN);
+	size_t cnt;
+
+	cnt = (PGSIZE - sizeof (struct slab)) / (slot_size + sizeof (uint16_t));
+	while (cnt > 0 && first_ofs (cnt) + cnt * slot_size > PGSIZE)
+		cnt--;
+	ASSERT (cnt > 0 && cnt < SLAB_END);
+
+	c = malloc (sizeof *c);
+	if (c == NULL)
+		return NULL;
+	strlcpy (c->name, name, sizeof c->name);
+	c->obj_size = size;
+	c->slot_size = slot_size;
+	c->objs_per_slab = cnt;
+	c->first_ofs = first_ofs (cnt);
+	c->ctor = ctor;
+	lock_init (&c->lock);
+	list_init (&c->partial);
+	list_init (&c->full);
+	list_init (&c->empty);
+	c->slabs = 0;
+	c->live = 0;
+	c->allocs = 0;
+	list_push_back (&all_caches, &c->elem);
+	return c;
+}
+
+/* Returns object IDX of slab S. */
+static void *
+slab_obj (struct slab *s, size_t idx) {
+	return (uint8_t *) s + s->cache->first_ofs + idx * s->cache->slot_size;
+}
+
+/* Allocates and initializes a slab for cache C, all of whose
+   objects are free.  Returns a null pointer if memory is
+   short. */
+static struct slab *
+slab_create (struct kmem_cache *c) {
+	struct slab *s = palloc_get_page (0);
+	size_t i;
+
+	if (s == NULL)
+		return NULL;
+	s->magic = SLAB_MAGIC;
+	s->cache = c;
+	s->free_cnt = c->objs_per_slab;
+	s->free_head = 0;
+	for (i = 0; i < c->objs_per_slab; i++) {
+		s->next[i] = i + 1 < c->objs_per_slab ? i + 1 : SLAB_END;
+		if (c->ctor != NULL)
+			c->ctor (slab_obj (s, i));
+	}
+	c->slabs++;
+	return s;
+}
+
+/* Obtains and returns an object from cache C, or a null pointer
+   if memory is short. */
+void *
+kmem_cache_alloc (struct kmem_cache *c) {
+	struct slab *s;
+	size_t idx;
+
+	lock_acquire (&c->lock);
+	if (!list_empty (&c->partial))
+		s = list_entry (list_front (&c->partial), struct slab, elem);
+	else if (!list_empty (&c->empty)) {
+		s = list_entry (list_pop_front (&c->empty), struct slab, elem);
+		list_push_front (&c->partial, &s->elem);
+	} else {
+		s = slab_create (c);
+		if (s == NULL) {
+			lock_release (&c->lock);
+			return NULL;
+		}
+		list_push_front (&c->partial, &s->elem);
+	}
+
+	idx = s->free_head;
+	ASSERT (idx != SLAB_END);
+	s->free_head = s->next[idx];
+	if (--s->free_cnt == 0) {
+		list_remove (&s->elem);
+		list_push_front (&c->full, &s->elem);
+	}
+	c->live++;
+	c->allocs++;
+	lock_release (&c->lock);
+
+	return slab_obj (s, idx);
+}
+
+/* Returns OBJ, which must have come from cache C, to C. */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj) {
+	struct slab *s = pg_round_down (obj);
+	size_t idx;
+	void *victim = NULL;
+
+	if (obj == NULL)
+		return;
+	ASSERT (s->magic == SLAB_MAGIC);
+	ASSERT (s->cache == c);
+	ASSERT ((pg_ofs (obj) - c->first_ofs) % c->slot_size == 0);
+	idx = (pg_ofs (obj) - c->first_ofs) / c->slot_size;
+
+#ifndef NDEBUG
+	/* Clear the object to help detect use-after-free bugs, unless
+	   it must keep its constructed state. */
+	if (c->ctor == NULL)
+		memset (obj, 0xcc, c->slot_size);
+#endif
+
+	lock_acquire (&c->lock);
+	s->next[idx] = s->free_head;
+	s->free_head = idx;
+	s->free_cnt++;
+	if (s->free_cnt == c->objs_per_slab) {
+		list_remove (&s->elem);
+		if (list_empty (&c->empty))
+			list_push_front (&c->empty, &s->elem);
+		else {
+			victim = s;
+			c->slabs--;
+		}
+	} else if (s->free_cnt == 1) {
+		list_remove (&s->elem);
+		list_push_front (&c->partial, &s->elem);
+	}
+	c->live--;
+	lock_release (&c->lock);
+
+	if (victim != NULL)
+		palloc_free_page (victim);
+}
+
+/* Fills in STATS for cache C. */
+void
+kmem_cache_get_stats (struct kmem_cache *c, struct kmem_cache_stats *stats) {
+	lock_acquire (&c->lock);
+	stats->obj_size = c->obj_size;
+	stats->objs_per_slab = c->objs_per_slab;
+	stats->slabs = c->slabs;
+	stats->live = c->live;
+	stats->allocs = c->allocs;
+	lock_release (&c->lock);
+}
+
+/* Prints statistics for each cache, including the memory its
+   live objects would take as malloc() blocks instead. */
+void
+kmem_cache_print_stats (void) {
+	struct list_elem *e;
+
+	for (e = list_begin (&all_caches); e != list_end (&all_caches);
+			e = list_next (e)) {
+		struct kmem_cache *c = list_entry (e, struct kmem_cache, elem);
+		struct kmem_cache_stats s;
+		long long as_malloc;
+
+		kmem_cache_get_stats (c, &s);
+		as_malloc = (long long) s.live * malloc_footprint (s.obj_size);
+		printf ("Slab %s: %zu-byte objects, %zu/slab, %zu slabs, "
+				"%zu live of %lld allocated, %lld bytes saved over malloc\n",
+				c->name, s.obj_size, s.objs_per_slab, s.slabs, s.live,
+				s.allocs, as_malloc - (long long) s.slabs * PGSIZE);
+	}
+}
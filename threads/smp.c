@@ -0,0 +1,297 @@
+#include "threads/smp.h"
+#include <debug.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/lapic.h"
+#include "devices/timer.h"
+#include "threads/cpu.h"
+#include "threads/fpu.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "intrinsic.h"
+#ifdef USERPROG
+#include "userprog/gdt.h"
+#include "userprog/syscall.h"
+#endif
+
+/* Multiprocessor support.
+
+   smp_init() finds the application processors (APs) in the BIOS's
+   MP configuration table and starts each in turn with the
+   INIT-SIPI-SIPI sequence of [IA32-v3a] 8.4.4 "MP
+   Initialization Example".  An AP runs the trampoline in
+   smp-start.S up to long mode, then ap_main(), and ends up in
+   the idle thread that thread_init_cpu() set up for it, from
+   which it schedules out of its own run queue.
+
+   Kernel data is still protected by turning interrupts off: the
+   interrupt lock in interrupt.c lets only one CPU at a time run
+   with interrupts off.  Besides the timer tick, which the
+   bootstrap processor forwards, CPUs interrupt each other to
+   reschedule and to flush their TLBs. */
+
+/* MP floating pointer structure.  See [MPS] 4.1. */
+struct mp_float {
+	char signature[4];      /* "_MP_". */
+	uint32_t config;        /* Physical address of struct mp_config. */
+	uint8_t length;         /* In 16-byte units. */
+	uint8_t version;
+	uint8_t checksum;       /* All bytes sum to 0. */
+	uint8_t features[5];
+} __attribute__((packed));
+
+/* MP configuration table header.  See [MPS] 4.2. */
+struct mp_config {
+	char signature[4];      /* "PCMP". */
+	uint16_t length;        /* Bytes in header and entries. */
+	uint8_t version;
+	uint8_t checksum;       /* All bytes sum to 0. */
+	char product[20];
+	uint32_t oem_table;
+	uint16_t oem_length;
+	uint16_t entry_cnt;     /* Number of entries that follow. */
+	uint32_t lapic_addr;
+	uint16_t ext_length;
+	uint8_t ext_checksum;
+	uint8_t reserved;
+} __attribute__((packed));
+
+/* MP configuration table processor entry.  See [MPS] 4.3.1.
+   Entries of all other types are 8 bytes long. */
+struct mp_proc {
+	uint8_t type;           /* MP_PROC. */
+	uint8_t apic_id;        /* Local APIC ID. */
+	uint8_t apic_version;
+	uint8_t flags;          /* MP_PROC_*. */
+	uint32_t signature;
+	uint32_t features;
+	uint64_t reserved;
+} __attribute__((packed));
+
+#define MP_PROC 0               /* Processor entry type. */
+#define MP_PROC_ENABLED 0x01    /* Usable processor. */
+#define MP_PROC_BSP 0x02        /* Bootstrap processor. */
+
+/* Milliseconds to wait for an AP to come up. */
+#define AP_TIMEOUT_MS 1000
+
+/* Set by the kernel command-line option "-maxcpus". */
+int smp_max_cpus = NCPU_MAX;
+
+/* Passed to the AP being started; see smp-start.S. */
+uint64_t smp_boot_cr3;
+uint64_t smp_boot_rsp;
+
+/* Trampoline in smp-start.S. */
+extern const char smp_trampoline[], smp_trampoline_end[];
+
+void ap_main (void) NO_RETURN;
+static bool start_ap (uint8_t apic_id);
+static struct mp_float *mp_search (uint64_t pa, size_t size);
+static bool mp_checksum (const void *, size_t size);
+
+/* Starts the application processors listed in the MP
+   configuration table, up to the limit set by "-maxcpus".  Must
+   be called with interrupts on, after timer_calibrate(). */
+void
+smp_init (void) {
+	struct mp_float *mpf = NULL;
+	struct mp_config *conf;
+	uint64_t ebda, base_kb;
+	uint8_t *p;
+	int i;
+
+	ASSERT (intr_get_level () == INTR_ON);
+
+	if (!lapic_present ())
+		return;
+	cpus[0].apic_id = lapic_id ();
+
+	/* Search the first KB of the extended BIOS data area, the last
+	   KB of base memory, and the BIOS ROM, finding the first two
+	   through the BIOS data area.  See [MPS] 4. */
+	ebda = *(uint16_t *) ptov (0x40e) << 4;
+	base_kb = *(uint16_t *) ptov (0x413);
+	if (ebda != 0)
+		mpf = mp_search (ebda, 1024);
+	if (mpf == NULL && base_kb != 0)
+		mpf = mp_search (base_kb * 1024 - 1024, 1024);
+	if (mpf == NULL)
+		mpf = mp_search (0xf0000, 0x10000);
+	if (mpf == NULL || mpf->config == 0)
+		return;
+
+	conf = ptov (mpf->config);
+	if (memcmp (conf->signature, "PCMP", 4) || !mp_checksum (conf, conf->length))
+		return;
+
+	p = (uint8_t *) (conf + 1);
+	for (i = 0; i < conf->entry_cnt && ncpu < smp_max_cpus && ncpu < NCPU_MAX; i++) {
+		struct mp_proc *proc = (struct mp_proc *) p;
+
+		if (proc->type != MP_PROC) {
+			p += 8;
+			continue;
+		}
+		p += sizeof *proc;
+		if ((proc->flags & MP_PROC_ENABLED) && proc->apic_id != cpus[0].apic_id
+				&& !start_ap (proc->apic_id))
+			break;
+	}
+
+	if (ncpu > 1)
+		printf ("SMP: %d CPUs online.\n", ncpu);
+}
+
+/* Starts the AP whose local APIC ID is APIC_ID as the next CPU
+   and waits for it to come up.  Returns false, with a message, if
+   it does not. */
+static bool
+start_ap (uint8_t apic_id) {
+	enum intr_level old_level;
+	struct thread *t;
+	struct cpu *c;
+	int i, ms;
+
+	t = thread_init_cpu (ncpu, apic_id);
+	if (t == NULL)
+		return false;
+	c = t->cpu;
+
+	memcpy (ptov (SMP_TRAMPOLINE), smp_trampoline,
+			smp_trampoline_end - smp_trampoline);
+	smp_boot_cr3 = vtop (base_pml4);
+	smp_boot_rsp = (uint64_t) t + PGSIZE;
+
+	old_level = intr_disable ();
+	lapic_send_init (apic_id);
+	intr_set_level (old_level);
+	timer_msleep (10);
+
+	/* Send the STARTUP IPI twice, as [IA32-v3a] 8.4.4.1 says.  The
+	   second is ignored if the first got through. */
+	for (i = 0; i < 2; i++) {
+		old_level = intr_disable ();
+		lapic_send_startup (apic_id, SMP_TRAMPOLINE >> 12);
+		intr_set_level (old_level);
+		timer_usleep (200);
+	}
+
+	for (ms = 0; !c->online && ms < AP_TIMEOUT_MS; ms++)
+		timer_msleep (1);
+	if (!c->online) {
+		printf ("SMP: CPU %d (APIC ID %u) did not start.\n", c->id, apic_id);
+		return false;
+	}
+	return true;
+}
+
+/* Entered from smp-start.S on the AP being started, with
+   interrupts off, on the stack of the thread that
+   thread_init_cpu() set up for it. */
+void
+ap_main (void) {
+#ifdef USERPROG
+	gdt_init_ap ();
+#endif
+	intr_init_ap ();
+	lapic_init_ap ();
+	fpu_init_ap ();
+#ifdef USERPROG
+	syscall_init ();
+#endif
+	thread_start_cpu ();
+	NOT_REACHED ();
+}
+
+/* Asks CPU C to reschedule, because a thread was queued on it. */
+void
+smp_send_resched (struct cpu *c) {
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	lapic_send_ipi (c->apic_id, LAPIC_VEC_RESCHED);
+}
+
+/* Sends interrupt VEC to every online CPU but this one. */
+void
+smp_broadcast (uint8_t vec) {
+	int i;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+
+	for (i = 0; i < ncpu; i++)
+		if (&cpus[i] != this_cpu () && cpus[i].online)
+			lapic_send_ipi (cpus[i].apic_id, vec);
+}
+
+/* Makes every other CPU that has PML4 loaded flush its TLB, and
+   waits until they all have.  Needed after a change to PML4 that
+   another CPU may still have cached. */
+void
+smp_tlb_shootdown (uint64_t *pml4) {
+	enum intr_level old_level;
+	int i;
+
+	if (ncpu == 1)
+		return;
+
+	/* The other CPUs cannot load PML4 meanwhile: they would need
+	   the interrupt lock to switch threads. */
+	old_level = intr_disable ();
+	for (i = 0; i < ncpu; i++) {
+		struct cpu *c = &cpus[i];
+
+		if (c != this_cpu () && c->online && c->pml4 == pml4) {
+			c->tlb_flush = true;
+			lapic_send_ipi (c->apic_id, LAPIC_VEC_TLB);
+		}
+	}
+	for (i = 0; i < ncpu; i++)
+		while (cpus[i].tlb_flush)
+			asm volatile ("pause");
+	intr_set_level (old_level);
+}
+
+/* Flushes this CPU's TLB if smp_tlb_shootdown() asked it to.
+   Called from the LAPIC_VEC_TLB handler, and by a CPU that
+   waits for the interrupt lock, since that CPU cannot take the
+   interrupt. */
+void
+smp_tlb_flush (void) {
+	struct cpu *c = this_cpu ();
+
+	if (c->tlb_flush) {
+		lcr3 (rcr3 ());
+		c->tlb_flush = false;
+	}
+}
+
+/* Returns the MP floating pointer structure in the SIZE bytes
+   at physical address PA, or a null pointer if there is none. */
+static struct mp_float *
+mp_search (uint64_t pa, size_t size) {
+	uint8_t *p = ptov (pa), *end = p + size;
+
+	for (; p + sizeof (struct mp_float) <= end; p += 16) {
+		struct mp_float *mpf = (struct mp_float *) p;
+
+		if (!memcmp (mpf->signature, "_MP_", 4)
+				&& mp_checksum (mpf, mpf->length * 16))
+			return mpf;
+	}
+	return NULL;
+}
+
+/* Returns true if the SIZE bytes at P sum to 0. */
+static bool
+mp_checksum (const void *p_, size_t size) {
+	const uint8_t *p = p_;
+	uint8_t sum = 0;
+
+	while (size-- > 0)
+		sum += *p++;
+	return sum == 0;
+}
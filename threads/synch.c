@@ -29,8 +29,205 @@
 #include "threads/synch.h"
 #include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
+#include "devices/timer.h"
+
+/* Returns true if wait element A should be woken before B. */
+static bool
+waitq_before(const struct wait_elem *a, const struct wait_elem *b)
+{
+	return a->priority > b->priority || (a->priority == b->priority && a->seq < b->seq);
+}
+
+/* Melds the heaps rooted at detached elements A and B, either of
+   which may be null, and returns the root of the result. */
+static struct wait_elem *
+waitq_meld(struct wait_elem *a, struct wait_elem *b)
+{
+	struct wait_elem *tmp;
+
+	if (a == NULL)
+		return b;
+	if (b == NULL)
+		return a;
+	if (waitq_before(b, a))
+	{
+		tmp = a;
+		a = b;
+		b = tmp;
+	}
+
+	/* Make B the leftmost child of A. */
+	b->prev = a;
+	b->next = a->child;
+	if (a->child != NULL)
+		a->child->prev = b;
+	a->child = b;
+	return a;
+}
+
+/* Melds the sibling list starting at FIRST into one heap, pairing
+   siblings left to right and then melding the pairs right to
+   left, and returns its root. */
+static struct wait_elem *
+waitq_merge_pairs(struct wait_elem *first)
+{
+	struct wait_elem *pairs = NULL;
+	struct wait_elem *root = NULL;
+
+	while (first != NULL)
+	{
+		struct wait_elem *a = first;
+		struct wait_elem *b = a->next;
+		struct wait_elem *m;
+
+		first = b != NULL ? b->next : NULL;
+		a->prev = a->next = NULL;
+		if (b != NULL)
+			b->prev = b->next = NULL;
+		m = waitq_meld(a, b);
+		m->next = pairs;
+		pairs = m;
+	}
+	while (pairs != NULL)
+	{
+		struct wait_elem *m = pairs;
+
+		pairs = m->next;
+		m->next = NULL;
+		root = waitq_meld(m, root);
+	}
+	return root;
+}
+
+/* Adds detached element E to Q with the given PRIORITY and
+   arrival number SEQ. */
+static void
+waitq_insert(struct wait_queue *q, struct wait_elem *e, int priority, uint64_t seq)
+{
+	e->child = e->next = e->prev = NULL;
+	e->queue = q;
+	e->priority = priority;
+	e->seq = seq;
+	q->root = waitq_meld(q->root, e);
+}
+
+/* Initializes Q as an empty wait queue. */
+void waitq_init(struct wait_queue *q)
+{
+	ASSERT(q != NULL);
+
+	q->root = NULL;
+	q->seq = 0;
+}
+
+/* Returns true if Q has no waiters. */
+bool waitq_empty(const struct wait_queue *q)
+{
+	return q->root == NULL;
+}
+
+/* Adds E to Q at PRIORITY, behind any waiters already queued at
+   the same priority. */
+void waitq_push(struct wait_queue *q, struct wait_elem *e, int priority)
+{
+	ASSERT(q != NULL);
+	ASSERT(e != NULL && e->queue == NULL);
+
+	waitq_insert(q, e, priority, q->seq++);
+}
+
+/* Returns the waiter in Q that would be woken next, or a null
+   pointer if Q is empty. */
+struct wait_elem *
+waitq_peek(const struct wait_queue *q)
+{
+	return q->root;
+}
+
+/* Removes and returns the waiter in Q that should be woken next.
+   Q must not be empty. */
+struct wait_elem *
+waitq_pop(struct wait_queue *q)
+{
+	struct wait_elem *e = q->root;
+
+	ASSERT(e != NULL);
+
+	q->root = waitq_merge_pairs(e->child);
+	e->queue = NULL;
+	return e;
+}
+
+/* Removes E from whatever wait queue it is on. */
+void waitq_remove(struct wait_elem *e)
+{
+	struct wait_queue *q = e->queue;
+
+	ASSERT(q != NULL);
+
+	if (e == q->root)
+	{
+		waitq_pop(q);
+		return;
+	}
+
+	/* Cut E out of its parent's child list. */
+	if (e->prev->child == e)
+		e->prev->child = e->next;
+	else
+		e->prev->next = e->next;
+	if (e->next != NULL)
+		e->next->prev = e->prev;
+	e->prev = e->next = NULL;
+
+	q->root = waitq_meld(q->root, waitq_merge_pairs(e->child));
+	e->queue = NULL;
+}
+
+/* Moves E, which is on a wait queue, to PRIORITY.  E keeps its
+   arrival order relative to waiters at the new priority. */
+void waitq_reprioritize(struct wait_elem *e, int priority)
+{
+	struct wait_queue *q = e->queue;
+	uint64_t seq = e->seq;
+
+	ASSERT(q != NULL);
+
+	waitq_remove(e);
+	waitq_insert(q, e, priority, seq);
+}
+
+/* Empties Q, calling FUNC on each waiter in no particular order.
+   Runs in time linear in the number of waiters. */
+void waitq_pop_all(struct wait_queue *q, void (*func)(struct wait_elem *))
+{
+	struct wait_elem *todo = q->root;
+
+	q->root = NULL;
+	while (todo != NULL)
+	{
+		struct wait_elem *e = todo;
+
+		/* Splice E's children in front of the rest. */
+		todo = e->next;
+		if (e->child != NULL)
+		{
+			struct wait_elem *last = e->child;
+
+			while (last->next != NULL)
+				last = last->next;
+			last->next = todo;
+			todo = e->child;
+		}
+		e->child = e->next = e->prev = NULL;
+		e->queue = NULL;
+		func(e);
+	}
+}
 
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
@@ -40,13 +237,92 @@
    decrement it.
 
    - up or "V": increment the value (and wake up one waiting
-   thread, if any). */
+   thread, if any).
+
+   Most semaphores, and the semaphores inside most locks, are
+   uncontended nearly all the time, so both operations first try
+   a single compare-and-swap on SEMA's count and only fall back
+   to disabling interrupts and touching the wait queue when they
+   must:
+
+   - Down takes a unit whenever the value is positive, with or
+   without waiters, just as the slow path always has.  Only a
+   value of 0 sends it to the slow path to sleep.
+
+   - Up adds a unit only while SEMA_WAITERS is clear.  Once it
+   is set, up must take the slow path to wake a waiter.
+
+   A sleeper sets SEMA_WAITERS before it queues itself and then
+   tries once more to take a unit, so an up that slipped in on
+   another CPU before the bit was set is not lost.  The bit is
+   cleared, again with interrupts off, whenever the wait queue
+   becomes empty.  Every change to the count is atomic, so the
+   fast paths may run on any CPU at any time.  The slow paths,
+   like the rest of this file, run with interrupts off, which
+   also holds the interrupt lock (see interrupt.c) and so keeps
+   every other CPU out of them too.  A spinlock per semaphore
+   would not do instead: sema_down() must still hold it as it
+   blocks, which only the interrupt lock, handed over by the
+   scheduler, allows. */
 void sema_init(struct semaphore *sema, unsigned value)
 {						  //세마포어 이닛해줌
 	ASSERT(sema != NULL); //세마포어는 널이 아니어야됨
 
-	sema->value = value;
-	list_init(&sema->waiters);
+	sema->count = value * SEMA_ONE;
+	waitq_init(&sema->waiters);
+}
+
+/* Takes one unit from SEMA if its value is positive, whether or
+   not threads are waiting.  Returns true if successful. */
+static inline bool
+sema_take(struct semaphore *sema)
+{
+	unsigned old = __atomic_load_n(&sema->count, __ATOMIC_RELAXED);
+
+	while (old >= SEMA_ONE)
+		if (__atomic_compare_exchange_n(&sema->count, &old, old - SEMA_ONE, true,
+										__ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+			return true;
+	return false;
+}
+
+/* Adds one unit to SEMA if no thread may be waiting on it.
+   Returns true if successful. */
+static inline bool
+sema_give(struct semaphore *sema)
+{
+	unsigned old = __atomic_load_n(&sema->count, __ATOMIC_RELAXED);
+
+	while (!(old & SEMA_WAITERS))
+		if (__atomic_compare_exchange_n(&sema->count, &old, old + SEMA_ONE, true,
+										__ATOMIC_RELEASE, __ATOMIC_RELAXED))
+			return true;
+	return false;
+}
+
+/* Clears SEMA_WAITERS if SEMA's wait queue is empty.  Interrupts
+   must be off. */
+static void
+sema_sync_waiters(struct semaphore *sema)
+{
+	ASSERT(intr_get_level() == INTR_OFF);
+
+	if (waitq_empty(&sema->waiters))
+		__atomic_fetch_and(&sema->count, ~SEMA_WAITERS, __ATOMIC_RELAXED);
+}
+
+/* Prepares the running thread to sleep on SEMA, whose value was
+   just found to be 0.  Sets SEMA_WAITERS so that no up bypasses
+   the wait queue from now on, then retries taking a unit in case
+   one arrived first.  Returns true if a unit was taken, in which
+   case the caller must not sleep.  Interrupts must be off. */
+static bool
+sema_prepare_wait(struct semaphore *sema)
+{
+	ASSERT(intr_get_level() == INTR_OFF);
+
+	__atomic_fetch_or(&sema->count, SEMA_WAITERS, __ATOMIC_SEQ_CST);
+	return sema_take(sema);
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -59,46 +335,120 @@ void sema_init(struct semaphore *sema, unsigned value)
    sema_down function. */
 void sema_down(struct semaphore *sema)
 {
+	struct thread *curr = thread_current();
+	enum trace_wait reason;
 	enum intr_level old_level;
 
 	ASSERT(sema != NULL);
 	ASSERT(!intr_context());
 
+	/* Callers such as lock_acquire() say what the semaphore
+	   stands for by setting the reason beforehand. */
+	reason = curr->wait_reason != TRACE_WAIT_OTHER ? curr->wait_reason : TRACE_WAIT_SEMA;
+
+	if (sema_take(sema))
+	{
+		curr->wait_reason = TRACE_WAIT_OTHER;
+		return;
+	}
+
 	old_level = intr_disable();
-	while (sema->value == 0)
+	while (!sema_prepare_wait(sema))
 	{
-		list_insert_ordered(&sema->waiters, &thread_current()->elem, cmp_priority, NULL);
+		waitq_push(&sema->waiters, &curr->wait_elem, curr->priority);
+		curr->wait_reason = reason;
 		thread_block();
+		if (sema_take(sema))
+			break;
 	}
-	sema->value--;
+	sema_sync_waiters(sema);
+	curr->wait_reason = TRACE_WAIT_OTHER;
 	intr_set_level(old_level);
 }
 
-/* Down or "P" operation on a semaphore, but only if the
-   semaphore is not already 0.  Returns true if the semaphore is
-   decremented, false otherwise.
+/* A thread waiting in sema_down_timeout(). */
+struct sema_timeout
+{
+	struct timeout timeout;	 /* Wakes THREAD when the wait times out. */
+	struct semaphore *sema;	 /* Semaphore waited on. */
+	struct thread *thread;	 /* Waiting thread. */
+	bool expired;			 /* Has the timeout fired? */
+};
 
-   This function may be called from an interrupt handler. */
-bool sema_try_down(struct semaphore *sema)
+/* Timeout callback for sema_down_timeout().  If the waiter is
+   still blocked on the semaphore, takes it off the wait list and
+   wakes it up.  If it was already woken by sema_up(), it will
+   find the semaphore's value positive and take it anyway. */
+static void
+sema_timeout_expire(void *st_)
+{
+	struct sema_timeout *st = st_;
+
+	st->expired = true;
+	if (st->thread->status == THREAD_BLOCKED)
+	{
+		waitq_remove(&st->thread->wait_elem);
+		sema_sync_waiters(st->sema);
+		thread_unblock(st->thread);
+	}
+}
+
+/* Down or "P" operation on a semaphore that gives up after
+   TICKS timer ticks.  Returns true if the semaphore was
+   decremented, false if the timeout expired first.  A
+   nonpositive TICKS behaves like sema_try_down().
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+bool sema_down_timeout(struct semaphore *sema, int64_t ticks)
 {
+	struct sema_timeout st;
 	enum intr_level old_level;
 	bool success;
 
 	ASSERT(sema != NULL);
+	ASSERT(!intr_context());
+
+	if (sema_take(sema))
+		return true;
+	if (ticks <= 0)
+		return false;
+
+	st.sema = sema;
+	st.thread = thread_current();
+	st.expired = false;
+	timeout_init(&st.timeout, sema_timeout_expire, &st);
 
 	old_level = intr_disable();
-	if (sema->value > 0)
+	success = sema_prepare_wait(sema);
+	if (!success)
+		timeout_add(&st.timeout, timer_ticks() + ticks);
+	while (!success && !st.expired)
 	{
-		sema->value--;
-		success = true;
+		waitq_push(&sema->waiters, &st.thread->wait_elem, st.thread->priority);
+		st.thread->wait_reason = TRACE_WAIT_SEMA;
+		thread_block();
+		success = sema_take(sema) || (!st.expired && sema_prepare_wait(sema));
 	}
-	else
-		success = false;
+	timeout_cancel(&st.timeout);
+	sema_sync_waiters(sema);
 	intr_set_level(old_level);
 
 	return success;
 }
 
+/* Down or "P" operation on a semaphore, but only if the
+   semaphore is not already 0.  Returns true if the semaphore is
+   decremented, false otherwise.
+
+   This function may be called from an interrupt handler. */
+bool sema_try_down(struct semaphore *sema)
+{
+	ASSERT(sema != NULL);
+
+	return sema_take(sema);
+}
+
 /* Up or "V" operation on a semaphore.  Increments SEMA's value
    and wakes up one thread of those waiting for SEMA, if any.
 
@@ -109,14 +459,15 @@ void sema_up(struct semaphore *sema)
 
 	ASSERT(sema != NULL);
 
+	if (sema_give(sema))
+		return;
+
 	old_level = intr_disable();
-	if (!list_empty(&sema->waiters))
-	{
-		list_sort(&sema->waiters, cmp_priority, NULL);
-		thread_unblock(list_entry(list_pop_front(&sema->waiters),
-								  struct thread, elem));
-	}
-	sema->value++;
+	if (!waitq_empty(&sema->waiters))
+		thread_unblock(waitq_entry(waitq_pop(&sema->waiters),
+								   struct thread, wait_elem));
+	sema_sync_waiters(sema);
+	__atomic_fetch_add(&sema->count, SEMA_ONE, __ATOMIC_RELEASE);
 	test_max_priority();
 	intr_set_level(old_level);
 }
@@ -177,9 +528,77 @@ void lock_init(struct lock *lock)
 	ASSERT(lock != NULL);
 
 	lock->holder = NULL;
+	lock->holder_tid = TID_ERROR;
+	lock->holder_cpu = 0;
+	lock->adaptive = false;
+	lock->max_priority = PRI_MIN - 1;
+	lock->heap_idx = -1;
 	sema_init(&lock->semaphore, 1);
 }
 
+/* Initializes LOCK as an adaptive lock.  It behaves like a lock
+   initialized with lock_init(), except that a contending thread
+   first spins while the holder is running on another CPU, which
+   is cheaper than blocking when critical sections are only a few
+   instructions long.  It falls back to blocking (with priority
+   donation) as soon as the holder is not running or the spin
+   limit is reached. */
+void lock_init_adaptive(struct lock *lock)
+{
+	lock_init(lock);
+	lock->adaptive = true;
+}
+
+/* Makes the running thread, which has just taken LOCK's
+   semaphore, LOCK's holder. */
+static void
+lock_set_holder(struct lock *lock)
+{
+	struct thread *curr = thread_current();
+
+	lock->holder = curr;
+	lock->holder_tid = curr->tid;
+	lock->holder_cpu = this_cpu()->id;
+}
+
+/* Spins on adaptive LOCK for as long as its holder is running on
+   another CPU, up to LOCK_SPIN_LIMIT iterations.  Returns true
+   if LOCK was acquired.
+
+   This runs with interrupts on, so the holder may release LOCK
+   and exit at any moment.  Rather than look at the holder's
+   struct thread, whose page may already be reused, it compares
+   the tid and CPU that the holder recorded in LOCK with the tid
+   that CPU says it is running.  A torn or stale read can only
+   end the spin early or prolong it to the limit.  The loop only
+   reads LOCK, and tries lock_try_acquire()'s compare-and-swap
+   once LOCK looks free, so spinners do not bounce its cache line
+   or take the interrupt lock. */
+static bool
+lock_spin(struct lock *lock)
+{
+	int i;
+
+	for (i = 0; i < LOCK_SPIN_LIMIT; i++)
+	{
+		tid_t tid = __atomic_load_n(&lock->holder_tid, __ATOMIC_RELAXED);
+		int cpu = __atomic_load_n(&lock->holder_cpu, __ATOMIC_RELAXED);
+
+		if (sema_value(&lock->semaphore) > 0)
+		{
+			if (lock_try_acquire(lock))
+			{
+				__atomic_fetch_add(&this_cpu()->lock_spins, 1, __ATOMIC_RELAXED);
+				return true;
+			}
+		}
+		else if (tid != TID_ERROR && (cpus[cpu].running != tid || &cpus[cpu] == this_cpu()))
+			return false;
+		asm volatile("pause");
+	}
+	return false;
+}
+
 /* Acquires LOCK, sleeping until it becomes available if
    necessary.  The lock must not already be held by the current
    thread.
@@ -196,43 +615,74 @@ void lock_acquire(struct lock *lock)
 	ASSERT(!intr_context());
 	ASSERT(!lock_held_by_current_thread(lock));
 
+	/* Uncontended: no donation bookkeeping needed. */
+	if (lock_try_acquire(lock))
+		return;
+	if (lock->adaptive && lock_spin(lock))
+		return;
+
+	old_level = intr_disable();
 	if (!thread_mlfqs)
 	{
-		if (lock->holder != NULL)
-		{
-			thread_current()->wait_on_lock = lock;
-			// thread_current()->init_priority = thread_current()->priority;
-
-			list_push_back(&lock->holder->donations, &thread_current()->donation_elem);
-			donate_priority();
-		}
+		/* Setting SEMA_WAITERS first sends the holder's release
+		   through the slow path, which waits for us, so we never
+		   donate to a thread that has already let LOCK go.  A
+		   holder that has not yet recorded itself will see the bit
+		   and collect our donation in lock_try_acquire(). */
+		__atomic_fetch_or(&lock->semaphore.count, SEMA_WAITERS, __ATOMIC_SEQ_CST);
+		thread_current()->wait_on_lock = lock;
+		donate_priority();
 	}
 
+	thread_current()->wait_reason = TRACE_WAIT_LOCK;
 	sema_down(&lock->semaphore);
+	sema_sync_waiters(&lock->semaphore);
+	lock_set_holder(lock);
 
 	if (!thread_mlfqs)
+	{
 		thread_current()->wait_on_lock = NULL;
-
-	lock->holder = thread_current();
+		if (!waitq_empty(&lock->semaphore.waiters))
+			add_held_lock(lock);
+	}
+	intr_set_level(old_level);
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
    on failure.  The lock must not already be held by the current
    thread.
 
+   The semaphore is taken with a single compare-and-swap and the
+   holder recorded with interrupts on, so an uncontended acquire
+   never touches the interrupt lock.  Only if SEMA_WAITERS is set
+   afterward, because a waiter queued before we took LOCK or
+   arrived before we recorded ourselves as holder, do we turn
+   interrupts off to let the waiters donate to us.
+
    This function will not sleep, so it may be called within an
    interrupt handler. */
 bool lock_try_acquire(struct lock *lock)
 {
-	bool success;
+	enum intr_level old_level;
 
 	ASSERT(lock != NULL);
 	ASSERT(!lock_held_by_current_thread(lock));
 
-	success = sema_try_down(&lock->semaphore);
-	if (success)
-		lock->holder = thread_current();
-	return success;
+	if (!sema_take(&lock->semaphore))
+		return false;
+	lock_set_holder(lock);
+
+	/* Pairs with the SEMA_WAITERS store in lock_acquire(): either
+	   that waiter saw us as holder, or we see its bit here. */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (!thread_mlfqs && (__atomic_load_n(&lock->semaphore.count, __ATOMIC_RELAXED) & SEMA_WAITERS))
+	{
+		old_level = intr_disable();
+		if (lock->heap_idx < 0 && !waitq_empty(&lock->semaphore.waiters))
+			add_held_lock(lock);
+		intr_set_level(old_level);
+	}
+	return true;
 }
 
 /* Releases LOCK, which must be owned by the current thread.
@@ -243,18 +693,29 @@ bool lock_try_acquire(struct lock *lock)
    handler. */
 void lock_release(struct lock *lock)
 {
+	enum intr_level old_level;
+
 	ASSERT(lock != NULL);
 	ASSERT(lock_held_by_current_thread(lock));
 
 	lock->holder = NULL;
+	lock->holder_tid = TID_ERROR;
 
-	if (!thread_mlfqs)
+	/* Only waiters on LOCK can have donated to us through it, and
+	   each sets SEMA_WAITERS first, so with the bit clear a single
+	   compare-and-swap releases LOCK without the interrupt lock. */
+	if (lock->heap_idx < 0 && sema_give(&lock->semaphore))
+		return;
+
+	old_level = intr_disable();
+	if (!thread_mlfqs && lock->heap_idx >= 0)
 	{
 		remove_with_lock(lock);
 		refresh_priority();
 	}
 
 	sema_up(&lock->semaphore);
+	intr_set_level(old_level);
 }
 
 /* Returns true if the current thread holds LOCK, false
@@ -267,28 +728,33 @@ bool lock_held_by_current_thread(const struct lock *lock)
 	return lock->holder == thread_current();
 }
 
-/* One semaphore in a list. */
-struct semaphore_elem
+/* Initializes spinlock LOCK as released. */
+void spinlock_init(struct spinlock *lock)
 {
-	struct list_elem elem;		/* List element. */
-	struct semaphore semaphore; /* This semaphore. */
-};
+	ASSERT(lock != NULL);
 
-bool cmp_sem_priority(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED)
-{
-	struct semaphore_elem *sa = list_entry(a, struct semaphore_elem, elem);
-	struct semaphore_elem *sb = list_entry(b, struct semaphore_elem, elem);
+	lock->locked = 0;
+}
 
-	struct list_elem *sa_elem = list_begin(&sa->semaphore.waiters);
-	struct list_elem *sb_elem = list_begin(&sb->semaphore.waiters);
+/* Acquires spinlock LOCK, busy-waiting until it is released by
+   whichever CPU holds it.  Interrupts must be off. */
+void spin_lock(struct spinlock *lock)
+{
+	ASSERT(lock != NULL);
+	ASSERT(intr_get_level() == INTR_OFF);
 
-	struct thread *ta = list_entry(sa_elem, struct thread, elem);
-	struct thread *tb = list_entry(sb_elem, struct thread, elem);
+	while (__atomic_exchange_n(&lock->locked, 1, __ATOMIC_ACQUIRE))
+		while (lock->locked)
+			asm volatile("pause");
+}
 
-	if (ta->priority > tb->priority)
-		return true;
+/* Releases spinlock LOCK, which must be held by this CPU. */
+void spin_unlock(struct spinlock *lock)
+{
+	ASSERT(lock != NULL);
+	ASSERT(lock->locked);
 
-	return false;
+	__atomic_store_n(&lock->locked, 0, __ATOMIC_RELEASE);
 }
 
 /* Initializes condition variable COND.  A condition variable
@@ -298,7 +764,7 @@ void cond_init(struct condition *cond)
 {
 	ASSERT(cond != NULL);
 
-	list_init(&cond->waiters);
+	waitq_init(&cond->waiters);
 }
 
 /* Atomically releases LOCK and waits for COND to be signaled by
@@ -323,20 +789,40 @@ void cond_init(struct condition *cond)
    we need to sleep. */
 void cond_wait(struct condition *cond, struct lock *lock)
 {
-	struct semaphore_elem waiter;
+	struct thread *curr = thread_current();
+	enum intr_level old_level;
 
 	ASSERT(cond != NULL);
 	ASSERT(lock != NULL);
 	ASSERT(!intr_context());
 	ASSERT(lock_held_by_current_thread(lock));
 
-	sema_init(&waiter.semaphore, 0);
-	list_insert_ordered(&cond->waiters, &waiter.elem, cmp_sem_priority, NULL);
+	/* A signal takes us off COND's queue.  Releasing LOCK may
+	   yield to a waiter, so we may be signaled before we block. */
+	old_level = intr_disable();
+	waitq_push(&cond->waiters, &curr->wait_elem, curr->priority);
 	lock_release(lock);
-	sema_down(&waiter.semaphore);
+	while (curr->wait_elem.queue != NULL)
+	{
+		curr->wait_reason = TRACE_WAIT_COND;
+		thread_block();
+	}
+	intr_set_level(old_level);
+
 	lock_acquire(lock);
 }
 
+/* Wakes the thread waiting on a condition variable through E, if
+   it has already gone to sleep. */
+static void
+cond_wake(struct wait_elem *e)
+{
+	struct thread *t = waitq_entry(e, struct thread, wait_elem);
+
+	if (t->status == THREAD_BLOCKED)
+		thread_unblock(t);
+}
+
 /* If any threads are waiting on COND (protected by LOCK), then
    this function signals one of them to wake up from its wait.
    LOCK must be held before calling this function.
@@ -351,10 +837,13 @@ void cond_signal(struct condition *cond, struct lock *lock UNUSED)
 	ASSERT(!intr_context());
 	ASSERT(lock_held_by_current_thread(lock));
 
-	if (!list_empty(&cond->waiters))
+	if (!waitq_empty(&cond->waiters))
 	{
-		list_sort(&cond->waiters, cmp_sem_priority, NULL);
-		sema_up(&list_entry(list_pop_front(&cond->waiters), struct semaphore_elem, elem)->semaphore);
+		enum intr_level old_level = intr_disable();
+
+		cond_wake(waitq_pop(&cond->waiters));
+		test_max_priority();
+		intr_set_level(old_level);
 	}
 }
 
@@ -366,9 +855,148 @@ void cond_signal(struct condition *cond, struct lock *lock UNUSED)
    interrupt handler. */
 void cond_broadcast(struct condition *cond, struct lock *lock)
 {
+	enum intr_level old_level;
+
 	ASSERT(cond != NULL);
 	ASSERT(lock != NULL);
+	ASSERT(!intr_context());
+	ASSERT(lock_held_by_current_thread(lock));
+
+	old_level = intr_disable();
+	waitq_pop_all(&cond->waiters, cond_wake);
+	test_max_priority();
+	intr_set_level(old_level);
+}
+
+/* Initializes RW as an unheld reader-writer lock.
+
+   The rwlock is writer-preferring: once a writer has asked for
+   RW, new readers wait until that writer is done.  A writer
+   holds the embedded `lock' for the whole of its critical
+   section, so readers and writers that queue behind it donate
+   their priority to it through the usual lock machinery.  A
+   writer waiting for the readers to drain donates its priority
+   to each of them in turn, through the reader's read_donation,
+   which acts as a lock in the reader's held-lock heap until it
+   releases RW.  To keep that bookkeeping in struct thread, only
+   the first rwlock a thread holds for reading is tracked; a
+   reader of two rwlocks at once gets no donation through the
+   second. */
+void rwlock_init(struct rwlock *rw)
+{
+	ASSERT(rw != NULL);
+
+	lock_init(&rw->lock);
+	sema_init(&rw->drained, 0);
+	rw->readers = 0;
+	rw->draining = false;
+	list_init(&rw->reader_list);
+}
+
+/* Acquires RW for reading, sleeping while a writer holds it or
+   is waiting for it.  Any number of readers may hold RW at once. */
+void rwlock_acquire_read(struct rwlock *rw)
+{
+	struct thread *curr = thread_current();
+	enum intr_level old_level;
+
+	ASSERT(rw != NULL);
+	ASSERT(!intr_context());
+
+	lock_acquire(&rw->lock);
+	old_level = intr_disable();
+	rw->readers++;
+	if (curr->reading == NULL)
+	{
+		curr->reading = rw;
+		list_push_back(&rw->reader_list, &curr->read_elem);
+	}
+	intr_set_level(old_level);
+	lock_release(&rw->lock);
+}
+
+/* Releases RW, which the current thread holds for reading.  The
+   last reader out wakes a writer waiting for readers to drain. */
+void rwlock_release_read(struct rwlock *rw)
+{
+	struct thread *curr = thread_current();
+	enum intr_level old_level;
+
+	ASSERT(rw != NULL);
+
+	old_level = intr_disable();
+	ASSERT(rw->readers > 0);
+	if (curr->reading == rw)
+	{
+		curr->reading = NULL;
+		list_remove(&curr->read_elem);
+		if (curr->read_donation.heap_idx >= 0)
+		{
+			remove_with_lock(&curr->read_donation);
+			refresh_priority();
+		}
+	}
+	if (--rw->readers == 0 && rw->draining)
+	{
+		rw->draining = false;
+		sema_up(&rw->drained);
+	}
+	intr_set_level(old_level);
+}
+
+/* Donates the running thread's priority to each tracked reader
+   of RW, which it is waiting to drain.  Interrupts must be off. */
+static void
+rwlock_donate(struct rwlock *rw)
+{
+	int priority = thread_current()->priority;
+	struct list_elem *e;
+
+	ASSERT(intr_get_level() == INTR_OFF);
+
+	for (e = list_begin(&rw->reader_list); e != list_end(&rw->reader_list);
+		 e = list_next(e))
+	{
+		struct thread *reader = list_entry(e, struct thread, read_elem);
+
+		donate_priority_to(reader, &reader->read_donation, priority);
+	}
+}
+
+/* Acquires RW for writing, sleeping until no other writer holds
+   it and every reader that got in ahead of us has left. */
+void rwlock_acquire_write(struct rwlock *rw)
+{
+	enum intr_level old_level;
+
+	ASSERT(rw != NULL);
+	ASSERT(!intr_context());
+
+	lock_acquire(&rw->lock);
+	old_level = intr_disable();
+	while (rw->readers > 0)
+	{
+		rw->draining = true;
+		if (!thread_mlfqs)
+			rwlock_donate(rw);
+		sema_down(&rw->drained);
+	}
+	intr_set_level(old_level);
+}
+
+/* Releases RW, which the current thread holds for writing. */
+void rwlock_release_write(struct rwlock *rw)
+{
+	ASSERT(rw != NULL);
+	ASSERT(rw->readers == 0);
+
+	lock_release(&rw->lock);
+}
+
+/* Returns true if the current thread holds RW for writing. */
+bool rwlock_held_by_current_thread(const struct rwlock *rw)
+{
+	ASSERT(rw != NULL);
 
-	while (!list_empty(&cond->waiters))
-		cond_signal(cond, lock);
+	return lock_held_by_current_thread(&rw->lock);
 }
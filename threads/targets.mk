@@ -7,3 +7,9 @@ threads_SRC += threads/palloc.c		# Page allocator.
 threads_SRC += threads/malloc.c		# Subpage allocator.
 threads_SRC += threads/start.S		# Startup code.
 threads_SRC += threads/mmu.c		    # Memory management unit related things.
+threads_SRC += threads/fpu.c		# Lazy FPU/SSE context switching.
+threads_SRC += threads/trace.c		# Scheduler event tracing.
+threads_SRC += threads/workqueue.c	# Deferred work thread pools.
+threads_SRC += threads/slab.c		# Object caches.
+threads_SRC += threads/smp.c		# Multiprocessor startup and IPIs.
+threads_SRC += threads/smp-start.S	# Application processor startup code.
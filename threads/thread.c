@@ -4,12 +4,18 @@
 #include <random.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
+#include "threads/fpu.h"
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
 #include "threads/palloc.h"
+#include "threads/smp.h"
 #include "threads/synch.h"
+#include "threads/trace.h"
 #include "threads/vaddr.h"
+#include "devices/lapic.h"
+#include "devices/timer.h"
 #include "intrinsic.h"
 #include "fixed_point.h"
 
@@ -32,12 +38,15 @@
 #define RECENT_CPU_DEFAULT 0
 #define LOAD_AVG_DEFAULT 0
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list, sleep_list, all_list;
+/* Per-CPU scheduler state.  CPU 0 is the bootstrap processor;
+   smp_init() adds the application processors after it, counting
+   them in NCPU.  The scheduler reaches its state through
+   this_cpu() and T->cpu. */
+struct cpu cpus[NCPU_MAX];
+int ncpu;
 
-/* Idle thread. */
-static struct thread *idle_thread;
+/* List of all processes. */
+static struct list all_list;
 
 /* Initial thread, the thread running init.c:main(). */
 static struct thread *initial_thread;
@@ -48,36 +57,116 @@ static struct lock tid_lock; //
 /* Thread destruction requests */
 static struct list destruction_req;
 
+/* Reaper thread, which frees the pages of dying threads. */
+static struct thread *reaper_thread;
+static bool reaper_waiting; /* Blocked waiting for destruction_req? */
+
+/* Pages of reaped threads kept for reuse by thread_create(),
+   which then only needs to clear the `struct thread' at the
+   bottom of the page rather than the whole page. */
+#define THREAD_CACHE_SIZE 16
+static void *thread_cache[THREAD_CACHE_SIZE];
+static size_t thread_cache_cnt;
+
 /* Statistics. */
-static long long idle_ticks;   /* # of timer ticks spent idle. */
-static long long kernel_ticks; /* # of timer ticks in kernel threads. */
-static long long user_ticks;   /* # of timer ticks in user programs. */
+static long long thread_cache_hits;   /* # of pages taken from thread_cache. */
+static long long thread_cache_misses; /* # of pages taken from palloc. */
+static long long threads_reaped;	  /* # of dying threads reaped. */
 
-static long long next_tick_to_awake; /* # of timer ticks in user programs. */
+/* Scheduler statistics of threads that have exited, except idle
+   threads.  See sched_account(). */
+static struct sched_stats exited_sched;
 
 /* Scheduling. */
-#define TIME_SLICE 4		  /* # of timer ticks to give each thread. */
-static unsigned thread_ticks; /* # of timer ticks since last yield. */
+#define TIME_SLICE 4 /* # of timer ticks to give each thread. */
+
+/* Deadline class bandwidth, runtime / period, is kept in fixed
+   point with DL_BW_SHIFT fraction bits.  Admission control keeps
+   the total at or below DL_BW_LIMIT per CPU, leaving some time
+   for the priority classes. */
+#define DL_BW_SHIFT 20
+#define DL_BW_LIMIT ((95 << DL_BW_SHIFT) / 100)
+#define DL_PERIOD_MAX 4000000000LL /* Longest period, in ns. */
+static uint64_t dl_total_bw; /* Bandwidth of admitted threads. */
 
 int load_avg;
 
+/* Decay coefficients (2 * load_avg) / (2 * load_avg + 1) of the
+   last DECAY_HISTORY seconds, indexed by second modulo
+   DECAY_HISTORY.  See mlfqs_recent_cpu(). */
+#define DECAY_HISTORY 64
+static int decay_coef[DECAY_HISTORY];
+static int64_t mlfqs_seconds; /* # of seconds of recent_cpu decay. */
+
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+/* If true, use the fair-share scheduler.
+   Controlled by kernel command-line option "-fair". */
+bool thread_fair;
+
+/* Fair-share scheduler.  Each ready thread should run once in
+   every FAIR_LATENCY, for a share proportional to its weight, but
+   for no less than FAIR_MIN_GRANULARITY at a time.  A woken thread
+   preempts the running thread only if it is FAIR_WAKEUP_GRANULARITY
+   behind in virtual runtime.  Times are in ns. */
+#define FAIR_LATENCY 40000000LL
+#define FAIR_MIN_GRANULARITY 4000000LL
+#define FAIR_WAKEUP_GRANULARITY 5000000LL
+#define FAIR_TICK_NS (1000000000LL / TIMER_FREQ)
+
+/* Weights of nice values NICE_MIN through NICE_MAX.  Each nice
+   level is worth about 10% of CPU time relative to its
+   neighbors, so weights differ by a factor of 1.25. */
+#define NICE_MIN -20
+#define NICE_MAX 20
+#define NICE_0_WEIGHT 1024
+static const int fair_weights[NICE_MAX - NICE_MIN + 1] = {
+	88761, 71755, 56483, 46273, 36291, 29154, 23254, 18705, 14949, 11916,
+	9548, 7620, 6100, 4904, 3906, 3121, 2501, 1991, 1586, 1277,
+	1024, 820, 655, 526, 423, 335, 272, 215, 172, 137,
+	110, 87, 70, 56, 45, 36, 29, 23, 18, 15,
+	12};
+
 static void kernel_thread(thread_func *, void *aux);
 
 static void idle(void *aux UNUSED);
+static void reaper(void *aux UNUSED);
+static void thread_reap(void);
+static void *thread_page_alloc(void);
 static struct thread *next_thread_to_run(void);
 static void init_thread(struct thread *, const char *name, int priority);
 static void do_schedule(int status);
 static void schedule(void);
 static tid_t allocate_tid(void);
-void thread_sleep(int64_t ticks);
-void thread_awake(int64_t ticks);
-void update_next_tick_to_awake(int64_t ticks);
-int64_t get_next_tick_to_awake(void);
+static void cpu_init(struct cpu *, int id);
+static void runq_push(struct cpu *, struct thread *);
+static struct thread *runq_pop(struct cpu *);
+static void runq_remove(struct cpu *, struct thread *);
+static int runq_max_priority(const struct cpu *);
+static struct thread *runq_steal(struct cpu *);
+static struct cpu *runq_place(struct thread *);
+static bool runq_preempts(struct cpu *, struct thread *);
+static bool runq_by_priority(const struct thread *);
+static void set_priority(struct thread *, int priority);
+static void thread_wakeup(void *t_);
+static bool thread_precedes(const struct thread *, const struct thread *);
+static bool dl_less(const struct list_elem *, const struct list_elem *, void *aux);
+static uint64_t dl_bw(const struct thread *);
+static bool dl_out_of_budget(struct thread *, int64_t now);
+static void dl_throttle(struct thread *);
+static void dl_wakeup(struct thread *, int64_t now);
+static void dl_account(struct thread *curr, struct thread *next);
+static bool fair_less(const struct rb_elem *, const struct rb_elem *, void *aux);
+static void fair_charge(struct cpu *, struct thread *);
+static bool fair_tick(struct cpu *, struct thread *);
+static void fair_place(struct cpu *, struct thread *);
+static void sched_account(struct thread *curr, struct thread *next);
+static void sched_stats_add(struct sched_stats *, const struct sched_stats *);
+static void sched_print_hist(const char *name, const uint32_t hist[]);
+static intr_handler_func resched_interrupt;
 void test_max_priority(void);
 bool cmp_priority(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED);
 
@@ -91,49 +180,94 @@ bool cmp_priority(const struct list_elem *a, const struct list_elem *b, void *au
  * somewhere in the middle, this locates the curent thread. */
 #define running_thread() ((struct thread *)(pg_round_down(rrsp())))
 
+/* Returns true if T is some CPU's idle thread. */
+#define is_idle_thread(t) ((t)->cpu != NULL && (t) == (t)->cpu->idle_thread)
+
 // Global descriptor table for the thread_start.
 // Because the gdt will be setup after the thread_init, we should
 // setup temporal gdt first.
 static uint64_t gdt[3] = {0, 0x00af9a000000ffff, 0x00cf92000000ffff};
 
-/* Initializes the threading system by transforming the code
-   that's currently running into a thread.  This can't work in
-   general and it is possible in this case only because loader.S
-   was careful to put the bottom of the stack at a page boundary.
+/* Puts the running thread to sleep until the timer reaches tick
+   WAKEUP.  The wakeup is a timeout on the timer wheel whose
+   callback unblocks the thread, so the timer interrupt only
+   touches threads that are actually due. */
+void thread_sleep(int64_t wakeup)
+{
+	struct thread *curr = thread_current();
+	struct timeout timeout;
+	enum intr_level old_level;
 
-   Also initializes the run queue and the tid lock.
+	ASSERT(!intr_context());
 
-   After calling this function, be sure to initialize the page
-   allocator before trying to create any threads with
-   thread_create().
+	old_level = intr_disable();
+	if (!is_idle_thread(curr))
+	{
+		timeout_init(&timeout, thread_wakeup, curr);
+		timeout_add(&timeout, wakeup);
+		curr->wait_reason = TRACE_WAIT_SLEEP;
+		thread_block();
+	}
 
-   It is not safe to call thread_current() until this function
-   finishes. */
-void thread_sleep(int64_t ticks)
+	intr_set_level(old_level);
+}
+
+/* Puts the current thread to sleep until timer_ns() reaches
+   WAKEUP, using a high-resolution timeout.  Like thread_sleep(),
+   but for sleeps shorter than a tick. */
+void thread_sleep_ns(int64_t wakeup)
 {
 	struct thread *curr = thread_current();
+	struct timeout timeout;
 	enum intr_level old_level;
 
+	ASSERT(!intr_context());
+
 	old_level = intr_disable();
-	if (curr != idle_thread)
+	if (!is_idle_thread(curr))
 	{
-		curr->wakeup_tick = ticks;
-		update_next_tick_to_awake(ticks);
-		list_push_back(&sleep_list, &curr->elem);
-		do_schedule(THREAD_BLOCKED);
+		timeout_init(&timeout, thread_wakeup, curr);
+		timeout_add_ns(&timeout, wakeup);
+		curr->wait_reason = TRACE_WAIT_SLEEP;
+		thread_block();
 	}
 
 	intr_set_level(old_level);
 }
 
+/* Timeout callback that wakes up sleeping thread T_, preempting
+   the interrupted thread if T_ should run first. */
+static void
+thread_wakeup(void *t_)
+{
+	struct thread *t = t_;
+
+	thread_unblock(t);
+	fair_charge(this_cpu(), thread_current());
+	if (t->cpu == this_cpu() && thread_precedes(t, thread_current()))
+		intr_yield_on_return();
+}
+
+/* Yields the CPU if a ready thread should run before the running
+   thread. */
 void test_max_priority(void)
 {
-	if (!intr_context() && !list_empty(&ready_list))
-	{
-		struct thread *ready_max_t = list_entry(list_begin(&ready_list), struct thread, elem);
-		if (ready_max_t->priority > thread_current()->priority)
-			thread_yield();
-	}
+	if (!intr_context() && runq_preempts(this_cpu(), thread_current()))
+		thread_yield();
+}
+
+/* Returns true if thread A should run before thread B: threads
+   in the deadline class run before all others, earliest deadline
+   first, and the rest by priority, or under the fair-share
+   scheduler, by virtual runtime. */
+static bool
+thread_precedes(const struct thread *a, const struct thread *b)
+{
+	if (a->dl_runtime != 0 || b->dl_runtime != 0)
+		return b->dl_runtime == 0 || (a->dl_runtime != 0 && a->dl_abs < b->dl_abs);
+	if (thread_fair)
+		return is_idle_thread(b) || (!is_idle_thread(a) && a->vruntime + FAIR_WAKEUP_GRANULARITY < b->vruntime);
+	return a->priority > b->priority;
 }
 
 bool cmp_priority(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED)
@@ -148,40 +282,19 @@ bool cmp_priority(const struct list_elem *a, const struct list_elem *b, void *au
 	return false;
 }
 
-void thread_awake(int64_t ticks)
-{
-	next_tick_to_awake = INT64_MAX;
-	struct thread *t = NULL;
-	struct list_elem *temp_elem = list_begin(&sleep_list);
-
-	while (temp_elem != list_tail(&sleep_list))
-	{
-		t = list_entry(temp_elem, struct thread, elem);
-		if (t->wakeup_tick <= ticks)
-		{
-			// temp_elem = list_remove(&t->elem);
-			temp_elem = list_remove(temp_elem);
-			thread_unblock(t);
-		}
-		else
-		{
-			update_next_tick_to_awake(t->wakeup_tick);
-			temp_elem = temp_elem->next;
-		}
-	}
-}
+/* Initializes the threading system by transforming the code
+   that's currently running into a thread.  This can't work in
+   general and it is possible in this case only because loader.S
+   was careful to put the bottom of the stack at a page boundary.
 
-void update_next_tick_to_awake(int64_t ticks)
-{
-	if (next_tick_to_awake > ticks)
-		next_tick_to_awake = ticks;
-}
+   Also initializes the run queue and the tid lock.
 
-int64_t get_next_tick_to_awake(void)
-{
-	return next_tick_to_awake;
-}
+   After calling this function, be sure to initialize the page
+   allocator before trying to create any threads with
+   thread_create().
 
+   It is not safe to call thread_current() until this function
+   finishes. */
 void thread_init(void)
 {
 	ASSERT(intr_get_level() == INTR_OFF);
@@ -195,17 +308,20 @@ void thread_init(void)
 	lgdt(&gdt_ds);
 
 	/* Init the globla thread context */
-	lock_init(&tid_lock);
-	list_init(&ready_list);
+	lock_init_adaptive(&tid_lock);
+	cpu_init(&cpus[0], 0);
+	ncpu = 1;
 	list_init(&destruction_req);
-	list_init(&sleep_list);
 	list_init(&all_list);
 
 	/* Set up a thread structure for the running thread. */
 	initial_thread = running_thread();
 	init_thread(initial_thread, "main", PRI_DEFAULT);
+	initial_thread->cpu = &cpus[0];
+	cpus[0].curr = initial_thread;
 	initial_thread->status = THREAD_RUNNING;
 	initial_thread->tid = allocate_tid();
+	cpus[0].running = initial_thread->tid;
 }
 
 /* Starts preemptive thread scheduling by enabling interrupts.
@@ -216,6 +332,8 @@ void thread_start(void)
 	struct semaphore idle_started;
 	sema_init(&idle_started, 0);
 	thread_create("idle", PRI_MIN, idle, &idle_started);
+	thread_create("reaper", PRI_MIN, reaper, NULL);
+	intr_register_ext(LAPIC_VEC_RESCHED, resched_interrupt, "Reschedule IPI");
 
 	load_avg = LOAD_AVG_DEFAULT;
 
@@ -226,32 +344,140 @@ void thread_start(void)
 	sema_down(&idle_started);
 }
 
+/* Sets up CPU number ID, whose local APIC ID is APIC_ID, for
+   smp_init() to start, along with the thread that the CPU starts
+   out running and that becomes its idle thread.  Returns that
+   thread, or a null pointer if no memory is available. */
+struct thread *
+thread_init_cpu(int id, uint8_t apic_id)
+{
+	struct cpu *c = &cpus[id];
+	enum intr_level old_level;
+	struct thread *t;
+
+	ASSERT(id == ncpu && id < NCPU_MAX);
+
+	t = thread_page_alloc();
+	if (t == NULL)
+		return NULL;
+
+	old_level = intr_disable();
+	cpu_init(c, id);
+	c->apic_id = apic_id;
+	c->online = false;
+	init_thread(t, "idle", PRI_MIN);
+	t->status = THREAD_RUNNING;
+	t->cpu = c;
+	c->curr = c->idle_thread = t;
+	ncpu++;
+	intr_set_level(old_level);
+
+	t->tid = allocate_tid();
+	c->running = t->tid;
+	return t;
+}
+
+/* Starts scheduling on the application processor that calls it,
+   with interrupts still off, in the thread that thread_init_cpu()
+   set up for it.  Never returns. */
+void thread_start_cpu(void)
+{
+	ASSERT(intr_get_level() == INTR_OFF);
+
+	this_cpu()->online = true;
+	idle(NULL);
+	NOT_REACHED();
+}
+
+/* Returns true if every CPU but this one is running its idle
+   thread and has nothing queued. */
+bool thread_cpus_idle(void)
+{
+	int i;
+
+	ASSERT(intr_get_level() == INTR_OFF);
+
+	for (i = 0; i < ncpu; i++)
+		if (&cpus[i] != this_cpu() && (!is_idle_thread(cpus[i].curr) || cpus[i].rq.cnt > 0))
+			return false;
+	return true;
+}
+
 /* Called by the timer interrupt handler at each timer tick.
    Thus, this function runs in an external interrupt context. */
 void thread_tick(void)
 {
 	struct thread *t = thread_current();
+	struct cpu *c = this_cpu();
 
 	/* Update statistics. */
-	if (t == idle_thread)
-		idle_ticks++;
+	if (t == c->idle_thread)
+		c->idle_ticks++;
 #ifdef USERPROG
 	else if (t->pml4 != NULL)
-		user_ticks++;
+		c->user_ticks++;
 #endif
 	else
-		kernel_ticks++;
+		c->kernel_ticks++;
 
-	/* Enforce preemption. */
-	if (++thread_ticks >= TIME_SLICE)
+	/* Enforce preemption.  A thread in the deadline class has no
+	   time slice, but is throttled once it uses up its budget. */
+	if (t->dl_runtime != 0)
+	{
+		if (dl_out_of_budget(t, timer_ns()))
+			intr_yield_on_return();
+	}
+	else if (thread_fair)
+	{
+		if (fair_tick(c, t))
+			intr_yield_on_return();
+	}
+	else if (++c->thread_ticks >= TIME_SLICE)
 		intr_yield_on_return();
 }
 
+/* Credits N timer ticks, which the timer skipped delivering
+   while the CPU was halted in tickless idle, to the idle
+   thread. */
+void thread_account_idle(int64_t n)
+{
+	ASSERT(intr_get_level() == INTR_OFF);
+	this_cpu()->idle_ticks += n;
+}
+
 /* Prints thread statistics. */
 void thread_print_stats(void)
 {
+	long long idle_ticks = 0, kernel_ticks = 0, user_ticks = 0;
+	struct sched_stats stats;
+	int i;
+
+	for (i = 0; i < ncpu; i++)
+	{
+		idle_ticks += cpus[i].idle_ticks;
+		kernel_ticks += cpus[i].kernel_ticks;
+		user_ticks += cpus[i].user_ticks;
+	}
 	printf("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
 		   idle_ticks, kernel_ticks, user_ticks);
+
+	if (ncpu > 1)
+		for (i = 0; i < ncpu; i++)
+			printf("CPU %d: %lld idle ticks, %lld kernel ticks, %lld user ticks, %lld steals, %lld lock spins\n",
+				   i, cpus[i].idle_ticks, cpus[i].kernel_ticks, cpus[i].user_ticks,
+				   cpus[i].steals, cpus[i].lock_spins);
+
+	printf("Thread pages: %lld cache hits, %lld cache misses, %lld reaped\n",
+		   thread_cache_hits, thread_cache_misses, threads_reaped);
+
+	thread_get_sched_stats(SCHED_STATS_ALL, &stats);
+	printf("Scheduler: %llu switches, %llu voluntary, %llu preempted\n",
+		   stats.switches, stats.voluntary, stats.preempted);
+	if (stats.dl_misses != 0 || stats.dl_throttled != 0)
+		printf("Deadline class: %llu deadline misses, %llu throttled\n",
+			   stats.dl_misses, stats.dl_throttled);
+	sched_print_hist("run-queue wait", stats.runq_wait);
+	sched_print_hist("time slice", stats.slice);
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -278,13 +504,16 @@ tid_t thread_create(const char *name, int priority,
 	ASSERT(function != NULL);
 
 	/* Allocate thread. */
-	t = palloc_get_page(PAL_ZERO);
+	t = thread_page_alloc();
 	if (t == NULL)
 		return TID_ERROR;
 
 	/* Initialize thread. */
 	init_thread(t, name, priority);
 	tid = t->tid = allocate_tid();
+	t->vruntime = this_cpu()->rq.min_vruntime;
+	trace_name(tid, t->name);
+	trace_event(TRACE_CREATE, tid, 0, thread_current()->tid);
 
 	/* Call the kernel_thread if it scheduled.
 	 * Note) rdi is 1st argument, and rsi is 2nd argument. */
@@ -295,7 +524,10 @@ tid_t thread_create(const char *name, int priority,
 	t->tf.es = SEL_KDSEG;
 	t->tf.ss = SEL_KDSEG;
 	t->tf.cs = SEL_KCSEG;
-	t->tf.eflags = FLAG_IF;
+	/* Start with interrupts off, as schedule() leaves them, so that
+	   the new thread inherits the interrupt lock along with the
+	   CPU.  kernel_thread() turns them on. */
+	t->tf.eflags = FLAG_MBS;
 
 	list_push_back(&thread_current()->child_list, &t->child_elem);
 
@@ -336,6 +568,8 @@ void thread_block(void)
 {
 	ASSERT(!intr_context());
 	ASSERT(intr_get_level() == INTR_OFF);
+	trace_event(TRACE_BLOCK, thread_current()->tid, thread_current()->wait_reason, 0);
+	thread_current()->wait_reason = TRACE_WAIT_OTHER;
 	thread_current()->status = THREAD_BLOCKED;
 	schedule();
 }
@@ -352,13 +586,29 @@ void thread_block(void)
 void thread_unblock(struct thread *t)
 {
 	enum intr_level old_level;
+	struct cpu *c;
 
 	ASSERT(is_thread(t));
 
 	old_level = intr_disable();
 	ASSERT(t->status == THREAD_BLOCKED);
-	list_insert_ordered(&ready_list, &t->elem, cmp_priority, NULL);
+	if (thread_mlfqs)
+	{
+		mlfqs_recent_cpu(t);
+		mlfqs_priority(t);
+	}
+	c = runq_place(t);
+	if (t->dl_runtime != 0)
+		dl_wakeup(t, timer_ns());
+	else if (thread_fair)
+		fair_place(c, t);
+	runq_push(c, t);
 	t->status = THREAD_READY;
+	t->ready_tsc = rdtsc();
+	/* A waker of 0 means an interrupt handler. */
+	trace_event(TRACE_UNBLOCK, t->tid, 0, intr_context() ? 0 : thread_current()->tid);
+	if (c != this_cpu())
+		smp_send_resched(c);
 	intr_set_level(old_level);
 }
 
@@ -403,10 +653,18 @@ void thread_exit(void)
 #ifdef USERPROG
 	process_exit();
 #endif
+	fpu_discard(thread_current());
 
 	/* Just set our status to dying and schedule another process.
-	   We will be destroyed during the call to schedule_tail(). */
+	   The reaper frees our page once we have switched away. */
 	intr_disable();
+	list_remove(&thread_current()->all_elem);
+	dl_total_bw -= dl_bw(thread_current());
+	if (reaper_waiting)
+	{
+		reaper_waiting = false;
+		thread_unblock(reaper_thread);
+	}
 	do_schedule(THREAD_DYING);
 	NOT_REACHED();
 }
@@ -421,12 +679,105 @@ void thread_yield(void)
 	ASSERT(!intr_context()); // 외부 인터럽트에 프로세싱 안 하는 것 맞는지 확인
 
 	old_level = intr_disable(); // intr level을 off로 바꿔줌
-	if (curr != idle_thread)	// 현재 쓰레드가 아이들쓰레드가 아니라면,
-		list_insert_ordered(&ready_list, &curr->elem, cmp_priority, NULL);
-	do_schedule(THREAD_READY); // cpu를 점유하고 있는 현재 스레드를 다른 스레드로 교체해주고 현재 스레드를 ready로 바꿔준다
+	fair_charge(curr->cpu, curr); /* Before requeueing by vruntime. */
+	if (curr->dl_runtime != 0 && dl_out_of_budget(curr, timer_ns()))
+		dl_throttle(curr);
+	else
+	{
+		if (!is_idle_thread(curr)) // 현재 쓰레드가 아이들쓰레드가 아니라면,
+			runq_push(curr->cpu, curr);
+		do_schedule(THREAD_READY); // cpu를 점유하고 있는 현재 스레드를 다른 스레드로 교체해주고 현재 스레드를 ready로 바꿔준다
+	}
 	intr_set_level(old_level); // itrl level을 off로 해줌
 }
 
+/* Yields the CPU on behalf of an interrupt handler that called
+   intr_yield_on_return(), so that the time slice is counted as
+   preempted rather than voluntarily given up. */
+void thread_preempt(void)
+{
+	struct thread *curr = thread_current();
+
+	curr->preempted = true;
+	thread_yield();
+	curr->preempted = false;
+}
+
+/* Copies scheduler statistics for SCOPE, one of SCHED_STATS_SELF
+   or SCHED_STATS_ALL, into STATS.  The totals for SCHED_STATS_ALL
+   cover every thread that has run except the idle threads. */
+void thread_get_sched_stats(int scope, struct sched_stats *stats)
+{
+	enum intr_level old_level = intr_disable();
+
+	if (scope == SCHED_STATS_SELF)
+		*stats = thread_current()->sched;
+	else
+	{
+		struct list_elem *e;
+
+		*stats = exited_sched;
+		for (e = list_begin(&all_list); e != list_end(&all_list); e = list_next(e))
+		{
+			struct thread *t = list_entry(e, struct thread, all_elem);
+
+			if (!is_idle_thread(t))
+				sched_stats_add(stats, &t->sched);
+		}
+	}
+	intr_set_level(old_level);
+}
+
+/* Admits the running thread to the deadline class with the
+   parameters in DL, or returns it to the priority classes if
+   DL->runtime is 0.  Returns false, changing nothing, if the
+   parameters are invalid or if admitting the thread would raise
+   the total bandwidth of the class, the sum of runtime / period
+   over its threads, above DL_BW_LIMIT per CPU.
+
+   This admission control is what makes deadlines meaningful: on
+   one CPU, EDF meets every deadline of any set of threads whose
+   deadlines equal their periods and whose bandwidths add up to
+   at most 1, and the CBS throttling in dl_throttle() keeps a
+   thread that overruns its runtime from taking time from the
+   others. */
+bool thread_set_deadline(const struct sched_deadline *dl)
+{
+	struct thread *curr = thread_current();
+	enum intr_level old_level;
+	uint64_t bw = 0;
+	bool ok = false;
+
+	if (dl->runtime != 0)
+	{
+		if (dl->runtime > dl->deadline || dl->deadline > dl->period || dl->period > DL_PERIOD_MAX)
+			return false;
+		bw = (dl->runtime << DL_BW_SHIFT) / dl->period;
+	}
+
+	old_level = intr_disable();
+	if (dl_total_bw - dl_bw(curr) + bw <= (uint64_t)ncpu * DL_BW_LIMIT)
+	{
+		int64_t now = timer_ns();
+
+		dl_total_bw = dl_total_bw - dl_bw(curr) + bw;
+		curr->dl_runtime = dl->runtime;
+		curr->dl_deadline = dl->deadline;
+		curr->dl_period = dl->period;
+		curr->dl_budget = dl->runtime;
+		curr->dl_abs = curr->dl_job_deadline = now + dl->deadline;
+		curr->dl_charged = now;
+		curr->dl_throttled = false;
+		ok = true;
+	}
+	intr_set_level(old_level);
+
+	/* Leaving the class may let a ready thread run first. */
+	if (ok)
+		test_max_priority();
+	return ok;
+}
+
 /* Sets the current thread's priority to NEW_PRIORITY. */
 void thread_set_priority(int new_priority)
 {
@@ -449,84 +800,262 @@ int thread_get_priority(void)
 	return thread_current()->priority;
 }
 
-void donate_priority(void)
+/* Each thread keeps the contended locks it holds in a binary
+   max-heap keyed on the locks' max_priority, so its effective
+   priority is max (init_priority, top of heap) and can be found
+   without looking at individual donors.  A thread rarely holds
+   more than a few contended locks at once; any beyond
+   HELD_LOCKS_MAX go on an unordered overflow list, which
+   effective_priority() scans, and move into the heap as it
+   empties. */
+
+/* heap_idx of a lock on its holder's held_overflow list. */
+#define HELD_OVERFLOW HELD_LOCKS_MAX
+
+/* Stores LOCK at index I of T's held-lock heap. */
+static void
+held_set(struct thread *t, int i, struct lock *lock)
+{
+	t->held_locks[i] = lock;
+	lock->heap_idx = i;
+}
+
+/* Moves the lock at index I of T's heap up to its place. */
+static void
+held_sift_up(struct thread *t, int i)
 {
-	struct thread *temp_t = thread_current();
+	struct lock *lock = t->held_locks[i];
 
-	int depth = 1;
-	while (depth < NESTED_DEPTH && temp_t->wait_on_lock != NULL)
+	while (i > 0 && t->held_locks[(i - 1) / 2]->max_priority < lock->max_priority)
 	{
-		temp_t = temp_t->wait_on_lock->holder;
+		held_set(t, i, t->held_locks[(i - 1) / 2]);
+		i = (i - 1) / 2;
+	}
+	held_set(t, i, lock);
+}
 
-		if (temp_t->priority < thread_current()->priority)
-			temp_t->priority = thread_current()->priority;
+/* Moves the lock at index I of T's heap down to its place. */
+static void
+held_sift_down(struct thread *t, int i)
+{
+	struct lock *lock = t->held_locks[i];
 
-		depth++;
+	for (;;)
+	{
+		int child = 2 * i + 1;
+
+		if (child >= t->held_cnt)
+			break;
+		if (child + 1 < t->held_cnt && t->held_locks[child + 1]->max_priority > t->held_locks[child]->max_priority)
+			child++;
+		if (t->held_locks[child]->max_priority <= lock->max_priority)
+			break;
+		held_set(t, i, t->held_locks[child]);
+		i = child;
 	}
+	held_set(t, i, lock);
 }
 
-void remove_with_lock(struct lock *lock)
+/* Adds LOCK, whose max_priority is set, to T's held locks: to
+   the heap, or to the overflow list if the heap is full. */
+static void
+held_add(struct thread *t, struct lock *lock)
+{
+	if (t->held_cnt < HELD_LOCKS_MAX)
+	{
+		held_set(t, t->held_cnt++, lock);
+		held_sift_up(t, lock->heap_idx);
+	}
+	else
+	{
+		lock->heap_idx = HELD_OVERFLOW;
+		list_push_back(&t->held_overflow, &lock->held_elem);
+	}
+}
+
+/* Returns T's effective priority: its own priority or the
+   highest priority donated through any lock it holds. */
+static int
+effective_priority(struct thread *t)
 {
-	struct list_elem *temp_elem = list_begin(&thread_current()->donations);
+	int priority = t->init_priority;
+	struct list_elem *e;
 
-	while (temp_elem != list_tail(&thread_current()->donations))
+	if (t->held_cnt > 0 && t->held_locks[0]->max_priority > priority)
+		priority = t->held_locks[0]->max_priority;
+	for (e = list_begin(&t->held_overflow); e != list_end(&t->held_overflow);
+		 e = list_next(e))
 	{
-		if (list_entry(temp_elem, struct thread, donation_elem)->wait_on_lock == lock)
-			temp_elem = list_remove(temp_elem);
+		struct lock *lock = list_entry(e, struct lock, held_elem);
 
-		else
-			temp_elem = temp_elem->next;
+		if (lock->max_priority > priority)
+			priority = lock->max_priority;
 	}
+	return priority;
 }
 
-void refresh_priority(void)
+/* Donates the current thread's priority along the chain of
+   holders of the locks it is waiting on. */
+void donate_priority(void)
 {
-	struct list_elem *temp_elem = list_begin(&thread_current()->donations);
-	struct thread *temp_t = NULL;
+	struct thread *t = thread_current();
 
-	thread_current()->priority = thread_current()->init_priority;
+	if (t->wait_on_lock != NULL && t->wait_on_lock->holder != NULL)
+		donate_priority_to(t->wait_on_lock->holder, t->wait_on_lock, t->priority);
+}
 
-	while (temp_elem != list_tail(&thread_current()->donations))
+/* Donates PRIORITY to HOLDER through LOCK, which HOLDER holds (or,
+   for a reader of an rwlock, HOLDER's read_donation), and on
+   along the chain of holders of the locks HOLDER is waiting on,
+   up to NESTED_DEPTH deep.  Each step raises one lock's
+   max_priority and sifts it up in its holder's heap, and the
+   walk stops as soon as a holder's priority does not change. */
+void donate_priority_to(struct thread *holder, struct lock *lock, int priority)
+{
+	int depth = 0;
+
+	while (depth++ < NESTED_DEPTH)
 	{
-		temp_t = list_entry(temp_elem, struct thread, donation_elem);
+		if (lock->heap_idx < 0)
+		{
+			lock->max_priority = priority;
+			held_add(holder, lock);
+		}
+		else if (lock->max_priority < priority)
+		{
+			lock->max_priority = priority;
+			if (lock->heap_idx != HELD_OVERFLOW)
+				held_sift_up(holder, lock->heap_idx);
+		}
+		else
+			break;
 
-		if (thread_current()->priority < temp_t->priority)
-			thread_current()->priority = temp_t->priority;
+		if (effective_priority(holder) == holder->priority)
+			break;
+		trace_event(TRACE_DONATE, holder->tid, priority, thread_current()->tid);
+		set_priority(holder, effective_priority(holder));
 
-		temp_elem = temp_elem->next;
+		lock = holder->wait_on_lock;
+		if (lock == NULL || lock->holder == NULL)
+			break;
+		holder = lock->holder;
 	}
 }
 
+/* Adds LOCK, which the current thread has just acquired while
+   other threads are still waiting for it, to the current
+   thread's held-lock heap so the remaining waiters donate to
+   it. */
+void add_held_lock(struct lock *lock)
+{
+	struct thread *curr = thread_current();
+
+	ASSERT(lock->heap_idx < 0);
+	ASSERT(!waitq_empty(&lock->semaphore.waiters));
+
+	lock->max_priority = waitq_peek(&lock->semaphore.waiters)->priority;
+	held_add(curr, lock);
+	refresh_priority();
+}
+
+/* Removes LOCK, which the current thread is releasing, from its
+   held-lock heap.  The waiters on LOCK no longer donate to it. */
+void remove_with_lock(struct lock *lock)
+{
+	struct thread *curr = thread_current();
+	struct lock *moved;
+	int i = lock->heap_idx;
+
+	if (i < 0)
+		return;
+	lock->heap_idx = -1;
+	if (i == HELD_OVERFLOW)
+	{
+		list_remove(&lock->held_elem);
+		return;
+	}
+
+	if (i != --curr->held_cnt)
+	{
+		moved = curr->held_locks[curr->held_cnt];
+		held_set(curr, i, moved);
+		held_sift_down(curr, i);
+		held_sift_up(curr, moved->heap_idx);
+	}
+
+	/* The heap has room again. */
+	if (!list_empty(&curr->held_overflow))
+		held_add(curr, list_entry(list_pop_front(&curr->held_overflow),
+								  struct lock, held_elem));
+}
+
+/* Recomputes the current thread's priority from its own
+   priority and the locks it holds. */
+void refresh_priority(void)
+{
+	set_priority(thread_current(), effective_priority(thread_current()));
+}
+
 /* priority = PRI_MAX - (recent_cpu / 4) - (nice * 2) */
 void mlfqs_priority(struct thread *t)
 {
-	if (t == idle_thread)
+	if (is_idle_thread(t))
 		return;
 
-	t->priority = fp_to_int(add_mixed(div_mixed(t->recent_cpu, -4), PRI_MAX - t->nice * 2));
+	int priority = fp_to_int(add_mixed(div_mixed(t->recent_cpu, -4), PRI_MAX - t->nice * 2));
+
+	if (priority < PRI_MIN)
+		priority = PRI_MIN;
+	else if (priority > PRI_MAX)
+		priority = PRI_MAX;
+
+	set_priority(t, priority);
 }
 
-/* recent_cpu = (2 * load_avg) / (2 * load_avg + 1) * recent_cpu + nice */
+/* recent_cpu = (2 * load_avg) / (2 * load_avg + 1) * recent_cpu + nice
+
+   Applied once for every second that passed since T's
+   recent_cpu was last brought up to date.  Blocked threads are
+   skipped when a second passes and catch up here when they are
+   unblocked, replaying the coefficients recorded in
+   decay_coef[]. */
 void mlfqs_recent_cpu(struct thread *t)
 {
-	int recent_cpu = t->recent_cpu;
-	int nice = t->nice;
+	int64_t sec = t->recent_cpu_sec;
 
-	if (t == idle_thread)
+	if (is_idle_thread(t))
 		return;
 
-	t->recent_cpu = add_mixed(mul_fp(div_fp(mul_mixed(load_avg, 2), add_mixed(mul_mixed(load_avg, 2), 1)), t->recent_cpu), t->nice);
+	/* Seconds older than the history all decay with the oldest
+	   recorded coefficient, until recent_cpu stops changing. */
+	for (; sec < mlfqs_seconds - DECAY_HISTORY; sec++)
+	{
+		int old = t->recent_cpu;
+
+		t->recent_cpu = add_mixed(mul_fp(decay_coef[mlfqs_seconds % DECAY_HISTORY], t->recent_cpu), t->nice);
+		if (t->recent_cpu == old)
+			sec = mlfqs_seconds - DECAY_HISTORY - 1;
+	}
+
+	for (; sec < mlfqs_seconds; sec++)
+		t->recent_cpu = add_mixed(mul_fp(decay_coef[sec % DECAY_HISTORY], t->recent_cpu), t->nice);
+
+	t->recent_cpu_sec = mlfqs_seconds;
 }
 
 /* load_avg = (59/60) * load_avg + (1/60) * ready_threads
-   ready_threads : ready_list에 있는 thread와 실행 중인 thread의 총 개수 */
+   ready_threads : run queue에 있는 thread와 실행 중인 thread의 총 개수 */
 void mlfqs_load_avg(void)
 {
-	int ready_threads;
-	if (thread_current() == idle_thread)
-		ready_threads = 0;
-	else
-		ready_threads = list_size(&ready_list) + 1;
+	int ready_threads = 0;
+	int i;
+
+	for (i = 0; i < ncpu; i++)
+	{
+		ready_threads += cpus[i].rq.cnt;
+		if (cpus[i].curr != NULL && cpus[i].curr != cpus[i].idle_thread)
+			ready_threads++;
+	}
 
 	int load_avg_coef = div_mixed(int_to_fp(59), 60);
 	load_avg = add_fp(mul_fp(load_avg_coef, load_avg), div_mixed(int_to_fp(ready_threads), 60));
@@ -534,36 +1063,55 @@ void mlfqs_load_avg(void)
 
 void mlfqs_increment(void)
 {
-	if (thread_current() == idle_thread)
+	if (is_idle_thread(thread_current()))
 		return;
 
 	thread_current()->recent_cpu = add_fp(thread_current()->recent_cpu, F);
 }
 
+/* Called once per second.  Records this second's recent_cpu
+   decay coefficient and applies it to the running threads and to
+   every ready thread, whose priorities decide what runs next.
+   Blocked threads catch up in thread_unblock(). */
 void mlfqs_recalc_recent_cpu(void)
 {
-	struct list_elem *temp_elem = list_begin(&all_list);
+	int i, j;
 
-	while (temp_elem != list_tail(&all_list))
-	{
-		struct thread *temp_t = list_entry(temp_elem, struct thread, all_elem);
-		mlfqs_recent_cpu(temp_t);
+	decay_coef[mlfqs_seconds % DECAY_HISTORY] = div_fp(mul_mixed(load_avg, 2), add_mixed(mul_mixed(load_avg, 2), 1));
+	mlfqs_seconds++;
 
-		temp_elem = temp_elem->next;
-	}
+	for (j = 0; j < ncpu; j++)
+		if (cpus[j].curr != NULL)
+		{
+			mlfqs_recent_cpu(cpus[j].curr);
+			mlfqs_priority(cpus[j].curr);
+		}
+
+	/* mlfqs_priority() may move a thread to another queue, so
+	   fetch the successor first.  A thread that lands in a queue
+	   not visited yet is already up to date when seen again. */
+	for (j = 0; j < ncpu; j++)
+		for (i = PRI_MAX; i >= PRI_MIN; i--)
+		{
+			struct list *queue = &cpus[j].rq.queues[i];
+			struct list_elem *e = list_begin(queue);
+
+			while (e != list_end(queue))
+			{
+				struct thread *t = list_entry(e, struct thread, elem);
+
+				e = list_next(e);
+				mlfqs_recent_cpu(t);
+				mlfqs_priority(t);
+			}
+		}
 }
 
+/* Called every fourth tick.  Only the running thread's recent_cpu
+   changes between seconds, so only its priority is recomputed. */
 void mlfqs_recalc_priority(void)
 {
-	struct list_elem *temp_elem = list_begin(&all_list);
-
-	while (temp_elem != list_tail(&all_list))
-	{
-		struct thread *temp_t = list_entry(temp_elem, struct thread, all_elem);
-		mlfqs_priority(temp_t);
-
-		temp_elem = temp_elem->next;
-	}
+	mlfqs_priority(thread_current());
 }
 
 /* Sets the current thread's nice value to NICE. */
@@ -571,8 +1119,16 @@ void thread_set_nice(int nice)
 {
 	enum intr_level old_level = intr_disable();
 
+	if (nice < NICE_MIN)
+		nice = NICE_MIN;
+	else if (nice > NICE_MAX)
+		nice = NICE_MAX;
+
+	/* Run time so far counts at the old weight. */
+	fair_charge(this_cpu(), thread_current());
 	thread_current()->nice = nice;
-	mlfqs_priority(thread_current());
+	if (!thread_fair)
+		mlfqs_priority(thread_current());
 
 	test_max_priority();
 
@@ -623,14 +1179,18 @@ int thread_get_recent_cpu(void)
    to it to enable thread_start() to continue, and immediately
    blocks.  After that, the idle thread never appears in the
    ready list.  It is returned by next_thread_to_run() as a
-   special case when the ready list is empty. */
+   special case when the ready list is empty.
+
+   An application processor calls this directly from
+   thread_start_cpu(), with a null IDLE_STARTED. */
 static void
-idle(void *idle_started_ UNUSED)
+idle(void *idle_started_)
 {
 	struct semaphore *idle_started = idle_started_;
 
-	idle_thread = thread_current();
-	sema_up(idle_started);
+	this_cpu()->idle_thread = thread_current();
+	if (idle_started != NULL)
+		sema_up(idle_started);
 
 	for (;;)
 	{
@@ -638,6 +1198,19 @@ idle(void *idle_started_ UNUSED)
 		intr_disable();
 		thread_block();
 
+		/* Nothing to run.  Zero a free page ahead of PAL_ZERO
+		   requests, taking any interrupt that arrived meanwhile,
+		   then look again. */
+		if (palloc_zero_idle())
+		{
+			intr_enable();
+			continue;
+		}
+
+		/* Still nothing to run, so stop the periodic tick until the
+		   next timeout is due (if "-tickless" was given). */
+		timer_idle_enter();
+
 		/* Re-enable interrupts and wait for the next one.
 
 		   The `sti' instruction disables interrupts until the
@@ -649,7 +1222,9 @@ idle(void *idle_started_ UNUSED)
 		   time.
 
 		   See [IA32-v2a] "HLT", [IA32-v2b] "STI", and [IA32-v3a]
-		   7.11.1 "HLT Instruction". */
+		   7.11.1 "HLT Instruction".  The interrupt lock is given up
+		   first, as intr_enable() would. */
+		intr_unlock();
 		asm volatile("sti; hlt"
 					 :
 					 :
@@ -673,6 +1248,8 @@ kernel_thread(thread_func *function, void *aux)
 static void
 init_thread(struct thread *t, const char *name, int priority)
 {
+	enum intr_level old_level;
+
 	ASSERT(t != NULL);
 	ASSERT(PRI_MIN <= priority && priority <= PRI_MAX);
 	ASSERT(name != NULL);
@@ -687,13 +1264,19 @@ init_thread(struct thread *t, const char *name, int priority)
 
 	t->init_priority = priority;
 
-	list_init(&t->donations);
+	t->held_cnt = 0;
+	list_init(&t->held_overflow);
 	t->wait_on_lock = NULL;
+	t->reading = NULL;
+	lock_init(&t->read_donation);
 
 	t->nice = NICE_DEFAULT;
 	t->recent_cpu = RECENT_CPU_DEFAULT;
+	t->recent_cpu_sec = mlfqs_seconds;
 
+	old_level = intr_disable();
 	list_push_front(&all_list, &t->all_elem);
+	intr_set_level(old_level);
 
 	/*
 	제일 처음에 생기는 main thread는 thread_create에 의해 생성되지 않지만 init_thread는 실행한다
@@ -705,6 +1288,9 @@ init_thread(struct thread *t, const char *name, int priority)
 	sema_init(&t->fork, 0);
 	sema_init(&t->exit, 0);
 
+	t->group = NULL;
+	t->stack_slot = -1;
+	t->joined = false;
 
 	/* project 3 : Virtual Memory */
 
@@ -719,15 +1305,279 @@ init_thread(struct thread *t, const char *name, int priority)
 static struct thread *
 next_thread_to_run(void)
 {
-	if (list_empty(&ready_list))
-		return idle_thread;
+	struct cpu *c = this_cpu();
+	struct thread *t = runq_pop(c);
+
+	if (t == NULL)
+		t = runq_steal(c);
+	return t != NULL ? t : c->idle_thread;
+}
+
+/* Returns the CPU that the running thread is on. */
+struct cpu *
+this_cpu(void)
+{
+	struct cpu *c = running_thread()->cpu;
+
+	ASSERT(c != NULL);
+	return c;
+}
+
+/* Initializes C as CPU number ID, with an empty run queue. */
+static void
+cpu_init(struct cpu *c, int id)
+{
+	int i;
+
+	memset(c, 0, sizeof *c);
+	c->id = id;
+	c->online = true;
+	spinlock_init(&c->rq_lock);
+	list_init(&c->rq.dl_queue);
+	rb_init(&c->rq.fair_tree, fair_less, NULL);
+	for (i = PRI_MIN; i <= PRI_MAX; i++)
+		list_init(&c->rq.queues[i]);
+}
+
+/* Appends T to the tail of C's queue for T's priority, or
+   inserts it in deadline order if it is in the deadline class or
+   in vruntime order under the fair-share scheduler, and makes C
+   the CPU that T will run on. */
+static void
+runq_push(struct cpu *c, struct thread *t)
+{
+	struct run_queue *rq = &c->rq;
+
+	ASSERT(intr_get_level() == INTR_OFF);
+	ASSERT(PRI_MIN <= t->priority && t->priority <= PRI_MAX);
+
+	spin_lock(&c->rq_lock);
+	if (t->dl_runtime != 0)
+		list_insert_ordered(&rq->dl_queue, &t->elem, dl_less, NULL);
+	else if (thread_fair)
+	{
+		rb_insert(&rq->fair_tree, &t->fair_elem);
+		rq->fair_weight += fair_weights[t->nice - NICE_MIN];
+	}
+	else
+	{
+		list_push_back(&rq->queues[t->priority], &t->elem);
+		rq->bitmap |= 1ULL << t->priority;
+	}
+	rq->cnt++;
+	t->cpu = c;
+	spin_unlock(&c->rq_lock);
+}
+
+/* Removes and returns the ready thread of C with the earliest
+   deadline, or if there is none in the deadline class, the
+   thread with the least vruntime under the fair-share scheduler
+   or else the first thread of the highest nonempty priority
+   queue.  Returns a null pointer if C's run queue is empty. */
+static struct thread *
+runq_pop(struct cpu *c)
+{
+	struct run_queue *rq = &c->rq;
+	struct thread *t = NULL;
+	int priority;
+
+	ASSERT(intr_get_level() == INTR_OFF);
+
+	spin_lock(&c->rq_lock);
+	priority = runq_max_priority(c);
+	if (!list_empty(&rq->dl_queue))
+	{
+		t = list_entry(list_pop_front(&rq->dl_queue), struct thread, elem);
+		rq->cnt--;
+	}
+	else if (!rb_empty(&rq->fair_tree))
+	{
+		t = rb_entry(rb_first(&rq->fair_tree), struct thread, fair_elem);
+		rb_remove(&rq->fair_tree, &t->fair_elem);
+		rq->fair_weight -= fair_weights[t->nice - NICE_MIN];
+		rq->cnt--;
+	}
+	else if (priority >= PRI_MIN)
+	{
+		t = list_entry(list_pop_front(&rq->queues[priority]), struct thread, elem);
+		if (list_empty(&rq->queues[priority]))
+			rq->bitmap &= ~(1ULL << priority);
+		rq->cnt--;
+	}
+	spin_unlock(&c->rq_lock);
+	return t;
+}
+
+/* Removes ready thread T from the run queue of T->cpu.  T must
+   still be queued where runq_push() put it. */
+static void
+runq_remove(struct cpu *c, struct thread *t)
+{
+	struct run_queue *rq = &c->rq;
+
+	ASSERT(intr_get_level() == INTR_OFF);
+	ASSERT(t->status == THREAD_READY);
+
+	spin_lock(&c->rq_lock);
+	if (t->dl_runtime == 0 && thread_fair)
+	{
+		rb_remove(&rq->fair_tree, &t->fair_elem);
+		rq->fair_weight -= fair_weights[t->nice - NICE_MIN];
+	}
 	else
-		return list_entry(list_pop_front(&ready_list), struct thread, elem);
+		list_remove(&t->elem);
+	if (runq_by_priority(t) && list_empty(&rq->queues[t->priority]))
+		rq->bitmap &= ~(1ULL << t->priority);
+	rq->cnt--;
+	spin_unlock(&c->rq_lock);
+}
+
+/* Returns the highest priority of any thread in C's run queue,
+   or PRI_MIN - 1 if it is empty. */
+static int
+runq_max_priority(const struct cpu *c)
+{
+	uint64_t bitmap = c->rq.bitmap;
+
+	if (bitmap == 0)
+		return PRI_MIN - 1;
+	return 63 - __builtin_clzll(bitmap);
 }
 
-/* Use iretq to launch the thread */
+/* Returns true if a thread in C's run queue should run before
+   T, which is running on C. */
+static bool
+runq_preempts(struct cpu *c, struct thread *t)
+{
+	enum intr_level old_level = intr_disable();
+	bool preempts;
+
+	if (!list_empty(&c->rq.dl_queue))
+		preempts = thread_precedes(list_entry(list_front(&c->rq.dl_queue), struct thread, elem), t);
+	else if (!rb_empty(&c->rq.fair_tree))
+	{
+		fair_charge(c, t);
+		preempts = thread_precedes(rb_entry(rb_first(&c->rq.fair_tree), struct thread, fair_elem), t);
+	}
+	else
+		preempts = runq_by_priority(t) && runq_max_priority(c) > t->priority;
+	intr_set_level(old_level);
+	return preempts;
+}
+
+/* Returns true if T is queued by priority, that is, it is not in
+   the deadline class and the fair-share scheduler is not in
+   use. */
+static bool
+runq_by_priority(const struct thread *t)
+{
+	return t->dl_runtime == 0 && !thread_fair;
+}
+
+/* Chooses the CPU to queue T on as it becomes ready: this CPU if
+   it is idle, else another idle CPU, else, under the priority
+   scheduler, the CPU running the lowest-priority thread if T
+   should preempt it, else this CPU. */
+static struct cpu *
+runq_place(struct thread *t)
+{
+	struct cpu *self = this_cpu(), *best = self;
+	int i;
+
+	if (ncpu == 1 || is_idle_thread(self->curr))
+		return self;
+	for (i = 0; i < ncpu; i++)
+		if (cpus[i].online && is_idle_thread(cpus[i].curr) && cpus[i].rq.cnt == 0)
+			return &cpus[i];
+
+	if (!runq_by_priority(t) || self->curr->priority < t->priority)
+		return self;
+	for (i = 0; i < ncpu; i++)
+		if (cpus[i].online && runq_by_priority(cpus[i].curr) && cpus[i].curr->priority < best->curr->priority)
+			best = &cpus[i];
+	return best->curr->priority < t->priority ? best : self;
+}
+
+/* Handler for the reschedule IPI, which another CPU sends after
+   queuing a thread here: yields if that thread should run before
+   the running one. */
+static void
+resched_interrupt(struct intr_frame *f UNUSED)
+{
+	struct thread *curr = thread_current();
+
+	if (is_idle_thread(curr) || runq_preempts(this_cpu(), curr))
+		intr_yield_on_return();
+}
+
+/* Load balancing for a CPU whose run queue is empty: takes the
+   highest-priority ready thread of the CPU with the most ready
+   threads, if any.  Only one run queue lock is held at a time,
+   so CPUs stealing from each other cannot deadlock. */
+static struct thread *
+runq_steal(struct cpu *self)
+{
+	struct cpu *victim = NULL;
+	struct thread *t;
+	int i;
+
+	for (i = 0; i < ncpu; i++)
+		if (&cpus[i] != self && cpus[i].online && cpus[i].rq.cnt > 0 && (victim == NULL || cpus[i].rq.cnt > victim->rq.cnt))
+			victim = &cpus[i];
+	if (victim == NULL)
+		return NULL;
+
+	t = runq_pop(victim);
+	if (t != NULL)
+	{
+		/* Keep T's vruntime lead or lag relative to its new CPU. */
+		if (thread_fair && t->dl_runtime == 0)
+			t->vruntime += self->rq.min_vruntime - victim->rq.min_vruntime;
+		t->cpu = self;
+		self->steals++;
+	}
+	return t;
+}
+
+/* Changes T's effective priority to PRIORITY.  A ready thread is
+   moved to the tail of the queue for its new priority, so every
+   write to a thread's priority must go through here.  Threads
+   not queued by priority stay put. */
+static void
+set_priority(struct thread *t, int priority)
+{
+	enum intr_level old_level = intr_disable();
+
+	if (t->priority != priority)
+		trace_event(TRACE_PRIORITY, t->tid, priority, t->priority);
+	if (t->status == THREAD_READY && t->priority != priority && runq_by_priority(t))
+	{
+		struct cpu *c = t->cpu;
+
+		runq_remove(c, t);
+		t->priority = priority;
+		runq_push(c, t);
+	}
+	else
+		t->priority = priority;
+
+	/* Move a waiter on a semaphore or condition variable too, so
+	   donation reaches whoever wakes it up. */
+	if (t->wait_elem.queue != NULL && t->wait_elem.priority != priority)
+		waitq_reprioritize(&t->wait_elem, priority);
+
+	intr_set_level(old_level);
+}
+
+/* Use iretq to launch the thread.  Returning to a context that
+   has interrupts on gives up the interrupt lock.  That is safe
+   here only because this is the running thread's own stack:
+   thread_launch() calls in on the stack of the thread it switches
+   away from, so the frames it passes keep interrupts off. */
 void do_iret(struct intr_frame *tf)
 {
+	if ((tf->eflags & FLAG_IF) && intr_get_level() == INTR_OFF)
+		intr_unlock();
 	__asm __volatile(
 		"movq %0, %%rsp\n"
 		"movq 0(%%rsp),%%r15\n"
@@ -768,62 +1618,47 @@ void do_iret(struct intr_frame *tf)
 static void
 thread_launch(struct thread *th)
 {
-	uint64_t tf_cur = (uint64_t)&running_thread()->tf;
-	uint64_t tf = (uint64_t)&th->tf;
+	uint64_t *save_rsp = &running_thread()->switch_rsp;
+	uint64_t next_rsp = th->switch_rsp;
+	struct intr_frame *tf = &th->tf;
 	ASSERT(intr_get_level() == INTR_OFF);
 
 	/* The main switching logic.
-	 * We first restore the whole execution context into the intr_frame
-	 * and then switching to the next thread by calling do_iret.
-	 * Note that, we SHOULD NOT use any stack from here
-	 * until switching is done. */
+	 * Every thread leaves the CPU from here, inside the kernel, so
+	 * only the callee-saved registers and the resume address need
+	 * to be saved; they are pushed on our own stack and the stack
+	 * pointer is stored in switch_rsp.  A thread that was switched
+	 * out the same way is resumed with a plain ret.  Only a thread
+	 * that has never run is started from its intr_frame through
+	 * do_iret.  Caller-saved registers are clobbered, as for any
+	 * function call. */
 	__asm __volatile(
-		/* Store registers that will be used. */
-		"push %%rax\n"
 		"push %%rbx\n"
-		"push %%rcx\n"
-		/* Fetch input once */
-		"movq %0, %%rax\n"
-		"movq %1, %%rcx\n"
-		"movq %%r15, 0(%%rax)\n"
-		"movq %%r14, 8(%%rax)\n"
-		"movq %%r13, 16(%%rax)\n"
-		"movq %%r12, 24(%%rax)\n"
-		"movq %%r11, 32(%%rax)\n"
-		"movq %%r10, 40(%%rax)\n"
-		"movq %%r9, 48(%%rax)\n"
-		"movq %%r8, 56(%%rax)\n"
-		"movq %%rsi, 64(%%rax)\n"
-		"movq %%rdi, 72(%%rax)\n"
-		"movq %%rbp, 80(%%rax)\n"
-		"movq %%rdx, 88(%%rax)\n"
-		"pop %%rbx\n" // Saved rcx
-		"movq %%rbx, 96(%%rax)\n"
-		"pop %%rbx\n" // Saved rbx
-		"movq %%rbx, 104(%%rax)\n"
-		"pop %%rbx\n" // Saved rax
-		"movq %%rbx, 112(%%rax)\n"
-		"addq $120, %%rax\n"
-		"movw %%es, (%%rax)\n"
-		"movw %%ds, 8(%%rax)\n"
-		"addq $32, %%rax\n"
-		"call __next\n" // read the current rip.
-		"__next:\n"
-		"pop %%rbx\n"
-		"addq $(out_iret -  __next), %%rbx\n"
-		"movq %%rbx, 0(%%rax)\n" // rip
-		"movw %%cs, 8(%%rax)\n"	 // cs
-		"pushfq\n"
-		"popq %%rbx\n"
-		"mov %%rbx, 16(%%rax)\n" // eflags
-		"mov %%rsp, 24(%%rax)\n" // rsp
-		"movw %%ss, 32(%%rax)\n"
-		"mov %%rcx, %%rdi\n"
+		"push %%rbp\n"
+		"push %%r12\n"
+		"push %%r13\n"
+		"push %%r14\n"
+		"push %%r15\n"
+		"leaq 1f(%%rip), %%rax\n"
+		"push %%rax\n" // resume address
+		"movq %%rsp, (%%rdi)\n"
+		"testq %%rsi, %%rsi\n"
+		"jz 2f\n"
+		"movq %%rsi, %%rsp\n"
+		"ret\n"
+		"2:\n"
+		"movq %%rdx, %%rdi\n"
 		"call do_iret\n"
-		"out_iret:\n"
+		"1:\n"
+		"pop %%r15\n"
+		"pop %%r14\n"
+		"pop %%r13\n"
+		"pop %%r12\n"
+		"pop %%rbp\n"
+		"pop %%rbx\n"
+		: "+D"(save_rsp), "+S"(next_rsp), "+d"(tf)
 		:
-		: "g"(tf_cur), "g"(tf)
-		: "memory");
+		: "rax", "rcx", "r8", "r9", "r10", "r11", "memory", "cc");
 }
 
 /* Schedules a new process. At entry, interrupts must be off.
@@ -835,13 +1670,6 @@ do_schedule(int status)
 {
 	ASSERT(intr_get_level() == INTR_OFF);
 	ASSERT(thread_current()->status == THREAD_RUNNING);
-	while (!list_empty(&destruction_req))
-	{
-		struct thread *victim =
-			list_entry(list_pop_front(&destruction_req), struct thread, elem);
-		list_remove(&victim->all_elem);
-		palloc_free_page(victim);
-	}
 	thread_current()->status = status;
 	schedule();
 }
@@ -850,16 +1678,35 @@ static void
 schedule(void)
 {
 	struct thread *curr = running_thread();
-	struct thread *next = next_thread_to_run();
+	struct thread *next;
 
 	ASSERT(intr_get_level() == INTR_OFF);
 	ASSERT(curr->status != THREAD_RUNNING);
+
+	/* A thread that yielded was charged before it was queued. */
+	if (curr->status != THREAD_READY)
+		fair_charge(curr->cpu, curr);
+	next = next_thread_to_run();
 	ASSERT(is_thread(next));
 	/* Mark us as running. */
 	next->status = THREAD_RUNNING;
 
 	/* Start new time slice. */
-	thread_ticks = 0;
+	next->cpu = curr->cpu;
+	next->cpu->curr = next;
+	next->cpu->running = next->tid;
+	next->cpu->thread_ticks = 0;
+	if (thread_fair)
+	{
+		/* Start NEXT's clock where CURR's stopped, so that the
+		   switch itself is charged to NEXT rather than to no one. */
+		if (curr->dl_runtime == 0 && !is_idle_thread(curr))
+			next->exec_start = curr->exec_start;
+		else
+			next->exec_start = timer_ns();
+		next->slice_start = next->exec_start;
+	}
+	fpu_switch(curr, next);
 
 #ifdef USERPROG
 	/* Activate the new address space. */
@@ -868,13 +1715,17 @@ schedule(void)
 
 	if (curr != next)
 	{
+		dl_account(curr, next);
+		sched_account(curr, next);
+		trace_event(TRACE_SWITCH_OUT, curr->tid, curr->status, next->tid);
+		trace_event(TRACE_SWITCH_IN, next->tid, 0, curr->tid);
+
 		/* If the thread we switched from is dying, destroy its struct
 		   thread. This must happen late so that thread_exit() doesn't
 		   pull out the rug under itself.
 		   We just queuing the page free reqeust here because the page is
 		   currently used bye the stack.
-		   The real destruction logic will be called at the beginning of the
-		   schedule(). */
+		   The reaper thread, or the next thread_create(), frees it. */
 		if (curr && curr->status == THREAD_DYING && curr != initial_thread)
 		{
 			ASSERT(curr != next);
@@ -887,6 +1738,381 @@ schedule(void)
 	}
 }
 
+/* Returns the histogram bucket for an interval of CYCLES TSC
+   cycles.  See <sched.h>. */
+static int
+sched_bucket(uint64_t cycles)
+{
+	int bucket;
+
+	cycles >>= 10;
+	if (cycles == 0)
+		return 0;
+	bucket = 63 - __builtin_clzll(cycles);
+	return bucket < SCHED_HIST_BUCKETS ? bucket : SCHED_HIST_BUCKETS - 1;
+}
+
+/* Adds the statistics in SRC to DST. */
+static void
+sched_stats_add(struct sched_stats *dst, const struct sched_stats *src)
+{
+	int i;
+
+	dst->switches += src->switches;
+	dst->voluntary += src->voluntary;
+	dst->preempted += src->preempted;
+	dst->dl_misses += src->dl_misses;
+	dst->dl_throttled += src->dl_throttled;
+	for (i = 0; i < SCHED_HIST_BUCKETS; i++)
+	{
+		dst->runq_wait[i] += src->runq_wait[i];
+		dst->slice[i] += src->slice[i];
+	}
+}
+
+/* Called by schedule() when switching from CURR to NEXT.  Ends
+   CURR's time slice and records how long NEXT was ready before
+   getting the CPU.  A dying CURR's statistics are folded into
+   exited_sched here, because this is the last time they
+   change. */
+static void
+sched_account(struct thread *curr, struct thread *next)
+{
+	uint64_t now = rdtsc();
+
+	curr->sched.slice[sched_bucket(now - curr->run_tsc)]++;
+	if (curr->status == THREAD_READY && curr->preempted)
+		curr->sched.preempted++;
+	else
+		curr->sched.voluntary++;
+	if (curr->status == THREAD_READY)
+		curr->ready_tsc = now;
+	else if (curr->status == THREAD_DYING && !is_idle_thread(curr))
+		sched_stats_add(&exited_sched, &curr->sched);
+
+	next->sched.switches++;
+	if (next->ready_tsc != 0)
+		next->sched.runq_wait[sched_bucket(now - next->ready_tsc)]++;
+	next->ready_tsc = 0;
+	next->run_tsc = now;
+}
+
+/* Deadline class.
+
+   Each thread in the class is a constant bandwidth server (CBS):
+   it has a budget of DL_RUNTIME nanoseconds of CPU time and a
+   scheduling deadline DL_ABS, and ready threads in the class run
+   earliest deadline first.  Running charges the budget, at each
+   timer tick and on each switch away.  A thread that runs out of
+   budget is throttled, that is, blocked until its next period
+   starts, when its budget and deadline are renewed.  Enforcement
+   happens at timer ticks, so a thread can overrun its budget by
+   up to a tick.
+
+   A job of a thread in the class runs from when the thread is
+   made ready, other than after throttling, until it next blocks
+   or exits.  A job that ends after the deadline it was released
+   with counts as a deadline miss. */
+
+/* Returns true if deadline thread A_ has an earlier deadline than
+   deadline thread B_. */
+static bool
+dl_less(const struct list_elem *a_, const struct list_elem *b_, void *aux UNUSED)
+{
+	const struct thread *a = list_entry(a_, struct thread, elem);
+	const struct thread *b = list_entry(b_, struct thread, elem);
+
+	return a->dl_abs < b->dl_abs;
+}
+
+/* Returns T's bandwidth in the deadline class, in units of
+   2**-DL_BW_SHIFT of a CPU, or 0 if T is not in the class. */
+static uint64_t
+dl_bw(const struct thread *t)
+{
+	if (t->dl_runtime == 0)
+		return 0;
+	return ((uint64_t)t->dl_runtime << DL_BW_SHIFT) / t->dl_period;
+}
+
+/* Charges running deadline thread T for its CPU time up to NOW
+   and returns true if it has used up its budget and must be
+   throttled.  A thread whose next period has already started
+   gets a new budget and deadline instead. */
+static bool
+dl_out_of_budget(struct thread *t, int64_t now)
+{
+	ASSERT(intr_get_level() == INTR_OFF);
+
+	t->dl_budget -= now - t->dl_charged;
+	t->dl_charged = now;
+	if (t->dl_budget > 0)
+		return false;
+	if (now < t->dl_abs - t->dl_deadline + t->dl_period)
+		return true;
+
+	t->dl_abs = now + t->dl_deadline;
+	t->dl_budget = t->dl_runtime;
+	return false;
+}
+
+/* Blocks running deadline thread T, which has used up its budget,
+   until its next period starts.  thread_unblock() then renews its
+   budget and deadline through dl_wakeup(). */
+static void
+dl_throttle(struct thread *t)
+{
+	struct timeout timeout;
+
+	ASSERT(intr_get_level() == INTR_OFF);
+
+	t->sched.dl_throttled++;
+	t->dl_throttled = true;
+	timeout_init(&timeout, thread_wakeup, t);
+	timeout_add_ns(&timeout, t->dl_abs - t->dl_deadline + t->dl_period);
+	t->wait_reason = TRACE_WAIT_THROTTLE;
+	thread_block();
+}
+
+/* Applies the CBS wakeup rule to deadline thread T, being made
+   ready at time NOW.  T keeps its budget and deadline if it can
+   use up the budget by the deadline without exceeding its
+   bandwidth; otherwise it gets a full budget and a deadline
+   DL_DEADLINE from now.  Unless T was throttled, this starts a
+   new job. */
+static void
+dl_wakeup(struct thread *t, int64_t now)
+{
+	if (t->dl_abs <= now || (__int128)t->dl_budget * t->dl_period > (__int128)(t->dl_abs - now) * t->dl_runtime)
+	{
+		t->dl_abs = now + t->dl_deadline;
+		t->dl_budget = t->dl_runtime;
+	}
+	if (!t->dl_throttled)
+		t->dl_job_deadline = t->dl_abs;
+	t->dl_throttled = false;
+}
+
+/* Called by schedule() when switching from CURR to NEXT.  Charges
+   CURR's budget, counts a deadline miss if CURR is ending a job
+   late, and starts charging NEXT. */
+static void
+dl_account(struct thread *curr, struct thread *next)
+{
+	int64_t now;
+
+	if (curr->dl_runtime == 0 && next->dl_runtime == 0)
+		return;
+
+	now = timer_ns();
+	if (curr->dl_runtime != 0)
+	{
+		bool job_done = curr->status == THREAD_DYING || (curr->status == THREAD_BLOCKED && !curr->dl_throttled);
+
+		curr->dl_budget -= now - curr->dl_charged;
+		if (job_done && now > curr->dl_job_deadline)
+			curr->sched.dl_misses++;
+	}
+	next->dl_charged = now;
+}
+
+/* Fair-share scheduler.
+
+   A thread's virtual runtime is the CPU time it has used, scaled
+   by NICE_0_WEIGHT over its weight, and the ready thread with the
+   least virtual runtime runs next, so that over time each thread
+   gets CPU time in proportion to its weight.  The running thread
+   is charged from timer_ns() at each timer tick and whenever it
+   leaves the CPU or is compared with another thread.
+
+   Each CPU's min_vruntime follows the least virtual runtime of
+   its running and ready threads, never going backward.  A thread
+   that wakes up is placed no further back than FAIR_LATENCY / 2
+   behind it, so sleeping earns only a little credit. */
+
+/* Returns true if thread A_ has less virtual runtime than thread
+   B_. */
+static bool
+fair_less(const struct rb_elem *a_, const struct rb_elem *b_, void *aux UNUSED)
+{
+	const struct thread *a = rb_entry(a_, struct thread, fair_elem);
+	const struct thread *b = rb_entry(b_, struct thread, fair_elem);
+
+	return a->vruntime < b->vruntime;
+}
+
+/* Charges thread T, which is running on C, for its CPU time since
+   it was last charged, and advances C's min_vruntime.  Does
+   nothing unless T is scheduled by the fair-share scheduler. */
+static void
+fair_charge(struct cpu *c, struct thread *t)
+{
+	int64_t now, vmin;
+
+	if (!thread_fair || t->dl_runtime != 0 || is_idle_thread(t))
+		return;
+
+	now = timer_ns();
+	t->vruntime += (now - t->exec_start) * NICE_0_WEIGHT / fair_weights[t->nice - NICE_MIN];
+	t->exec_start = now;
+
+	vmin = t->vruntime;
+	if (!rb_empty(&c->rq.fair_tree))
+	{
+		struct thread *first = rb_entry(rb_first(&c->rq.fair_tree), struct thread, fair_elem);
+
+		if (first->vruntime < vmin)
+			vmin = first->vruntime;
+	}
+	if (vmin > c->rq.min_vruntime)
+		c->rq.min_vruntime = vmin;
+}
+
+/* Called at each timer tick for thread T, running on C.  Returns
+   true if T should yield because it has had its share of
+   FAIR_LATENCY, or has run for FAIR_MIN_GRANULARITY and is that
+   share ahead of the first ready thread in virtual runtime.
+   Preemption is only checked at ticks, so a slice ends at the
+   tick nearest to its length. */
+static bool
+fair_tick(struct cpu *c, struct thread *t)
+{
+	struct thread *first;
+	int weight = fair_weights[t->nice - NICE_MIN];
+	int64_t ran, slice;
+
+	if (rb_empty(&c->rq.fair_tree))
+		return false;
+	if (is_idle_thread(t))
+		return true;
+
+	fair_charge(c, t);
+	first = rb_entry(rb_first(&c->rq.fair_tree), struct thread, fair_elem);
+	ran = t->exec_start - t->slice_start + FAIR_TICK_NS / 2;
+	slice = FAIR_LATENCY * weight / (c->rq.fair_weight + weight);
+	if (slice < FAIR_MIN_GRANULARITY)
+		slice = FAIR_MIN_GRANULARITY;
+
+	return ran >= slice || (ran >= FAIR_MIN_GRANULARITY && t->vruntime - first->vruntime > slice);
+}
+
+/* Places thread T, which is being made ready on C after blocking,
+   no further back in virtual time than FAIR_LATENCY / 2 behind
+   C's min_vruntime. */
+static void
+fair_place(struct cpu *c, struct thread *t)
+{
+	int64_t floor = c->rq.min_vruntime - FAIR_LATENCY / 2;
+
+	if (t->vruntime < floor)
+		t->vruntime = floor;
+}
+
+/* Prints the nonzero buckets of histogram HIST, labeled NAME. */
+static void
+sched_print_hist(const char *name, const uint32_t hist[])
+{
+	int i;
+
+	printf("  %s (kcycles):", name);
+	for (i = 0; i < SCHED_HIST_BUCKETS; i++)
+		if (hist[i] != 0)
+			printf(" %s%llu:%u", i == 0 ? "<" : "", 1ULL << (i == 0 ? 1 : i), hist[i]);
+	printf("\n");
+}
+
+/* Frees the pages of all threads on destruction_req, keeping up
+   to THREAD_CACHE_SIZE of them in thread_cache.  Interrupts are
+   only disabled to take the list and to touch the cache, not
+   while pages go back to the page allocator. */
+static void
+thread_reap(void)
+{
+	struct list victims;
+	enum intr_level old_level;
+
+	ASSERT(!intr_context());
+
+	list_init(&victims);
+	old_level = intr_disable();
+	if (!list_empty(&destruction_req))
+		list_splice(list_end(&victims), list_begin(&destruction_req),
+					list_end(&destruction_req));
+	intr_set_level(old_level);
+
+	while (!list_empty(&victims))
+	{
+		struct thread *victim =
+			list_entry(list_pop_front(&victims), struct thread, elem);
+
+		old_level = intr_disable();
+		threads_reaped++;
+		if (thread_cache_cnt < THREAD_CACHE_SIZE)
+		{
+			thread_cache[thread_cache_cnt++] = victim;
+			victim = NULL;
+		}
+		intr_set_level(old_level);
+
+		if (victim != NULL)
+			palloc_free_page(victim);
+	}
+}
+
+/* Returns a page for a new thread, preferably a recycled one
+   from thread_cache, or a null pointer if none is available.
+   Only the `struct thread' part of a recycled page is cleared,
+   by init_thread(). */
+static void *
+thread_page_alloc(void)
+{
+	void *page = NULL;
+	enum intr_level old_level;
+
+	thread_reap();
+
+	old_level = intr_disable();
+	if (thread_cache_cnt > 0)
+	{
+		page = thread_cache[--thread_cache_cnt];
+		thread_cache_hits++;
+	}
+	intr_set_level(old_level);
+
+	if (page == NULL)
+	{
+		page = palloc_get_page(PAL_ZERO);
+		thread_cache_misses++;
+	}
+	return page;
+}
+
+/* Reaper thread.  Runs at the lowest priority, so dying threads
+   are usually freed in batches when the CPU would otherwise be
+   idle; thread_create() also reaps on demand. */
+static void
+reaper(void *aux UNUSED)
+{
+	reaper_thread = thread_current();
+	for (;;)
+	{
+		enum intr_level old_level = intr_disable();
+		while (list_empty(&destruction_req))
+		{
+			/* thread_exit() wakes us through this flag rather than
+			   a semaphore, because sema_up() may yield and the
+			   dying thread must not.  Checking our status instead
+			   would also catch us blocked on some lock in
+			   thread_reap(). */
+			reaper_waiting = true;
+			thread_block();
+		}
+		intr_set_level(old_level);
+
+		thread_reap();
+	}
+}
+
 /* Returns a tid to use for a new thread. */
 static tid_t
 allocate_tid(void)
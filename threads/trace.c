@@ -0,0 +1,201 @@
+#include "threads/trace.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/serial.h"
+#include "devices/timer.h"
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "threads/workqueue.h"
+#include "intrinsic.h"
+
+/* Scheduler event tracing.
+
+   Each CPU records events into its own ring buffer, only ever
+   from that CPU and with its interrupts disabled, so recording
+   takes no lock.  Events such as thread creation and priority
+   donation are recorded with interrupts on, so recording turns
+   them off with intr_disable_local(), which unlike intr_disable()
+   does not take the interrupt lock and so does not make CPUs
+   wait for each other.  When a buffer fills up the oldest events
+   are overwritten.
+
+   trace_dump() writes the buffers to the serial port only, between
+   a "TRACE-BEGIN" and a "TRACE-END" line.  Each event is written as
+   its 18-byte struct trace_event in hex, so the dump survives
+   line-oriented capture of the serial output.  utils/pintos-trace
+   decodes it.
+
+   The buffers are dumped at power off, and also on demand: by the
+   trace_dump system call, or by typing TRACE_DUMP_KEY, which hands
+   the dump to a kernel thread.  Each dump covers every event still
+   in the buffers, so a later dump repeats what an earlier one
+   showed. */
+
+#define TRACE_PAGES 16          /* Pages of events per CPU. */
+#define TRACE_CNT (TRACE_PAGES * PGSIZE / sizeof (struct trace_event))
+#define TRACE_NAMES 256         /* Size of the thread name table. */
+
+bool trace_enabled;
+
+/* A CPU's ring buffer. */
+struct trace_buf {
+	struct trace_event *events; /* TRACE_CNT events. */
+	uint64_t head;              /* # of events ever recorded. */
+};
+static struct trace_buf bufs[NCPU_MAX];
+
+/* Names of recently created threads, indexed by tid modulo
+   TRACE_NAMES. */
+static struct {
+	int tid;
+	char name[16];
+} names[TRACE_NAMES];
+
+/* TSC and timer tick at trace_init(), for calibrating the TSC. */
+static uint64_t start_tsc;
+static int64_t start_ticks;
+
+/* Set while a dump is being written. */
+static bool dumping;
+
+/* Runs trace_dump() for trace_request_dump(). */
+static struct work dump_work;
+static void dump_work_func (void *aux UNUSED);
+
+/* Allocates the per-CPU buffers.  Called once, after the page
+   allocator is up, if tracing was requested. */
+void
+trace_init (void) {
+	int i;
+
+	if (!trace_enabled)
+		return;
+
+	for (i = 0; i < ncpu; i++) {
+		bufs[i].events = palloc_get_multiple (0, TRACE_PAGES);
+		if (bufs[i].events == NULL) {
+			printf ("trace: out of memory, tracing disabled\n");
+			trace_enabled = false;
+			return;
+		}
+	}
+	trace_name (thread_tid (), thread_name ());
+	work_init (&dump_work, dump_work_func, NULL);
+	start_tsc = rdtsc ();
+	start_ticks = timer_ticks ();
+}
+
+/* Records an event of TYPE about thread TID in the running CPU's
+   buffer.  Use trace_event() instead, which skips the call when
+   tracing is off. */
+void
+trace_record (enum trace_type type, int tid, int arg, int aux) {
+	enum intr_level old_level = intr_disable_local ();
+	struct trace_buf *b = &bufs[this_cpu ()->id];
+
+	if (b->events != NULL) {
+		struct trace_event *e = &b->events[b->head++ % TRACE_CNT];
+
+		e->tsc = rdtsc ();
+		e->tid = tid;
+		e->type = type;
+		e->arg = arg;
+		e->aux = aux;
+	}
+	intr_restore_local (old_level);
+}
+
+/* Remembers that thread TID is called NAME. */
+void
+trace_name (int tid, const char *name) {
+	if (!trace_enabled)
+		return;
+
+	names[tid % TRACE_NAMES].tid = tid;
+	strlcpy (names[tid % TRACE_NAMES].name, name,
+			sizeof names[tid % TRACE_NAMES].name);
+}
+
+/* Writes S to the serial port. */
+static void
+serial_puts (const char *s) {
+	while (*s != '\0')
+		serial_putc (*s++);
+}
+
+/* Writes every buffered event to the serial port.  Recording is
+   paused while the dump is in progress.  Does nothing if another
+   dump is in progress. */
+void
+trace_dump (void) {
+	static const char hex[] = "0123456789abcdef";
+	uint64_t tsc_hz = 0;
+	int64_t elapsed;
+	char line[64];
+	int i;
+
+	if (!trace_enabled || __atomic_exchange_n (&dumping, true, __ATOMIC_ACQUIRE))
+		return;
+	trace_enabled = false;
+
+	elapsed = timer_elapsed (start_ticks);
+	if (elapsed > 0)
+		tsc_hz = (rdtsc () - start_tsc) * TIMER_FREQ / elapsed;
+	snprintf (line, sizeof line, "TRACE-BEGIN 2 %d %llu\n", ncpu, tsc_hz);
+	serial_puts (line);
+
+	for (i = 0; i < TRACE_NAMES; i++)
+		if (names[i].tid != 0) {
+			snprintf (line, sizeof line, "N %d %s\n", names[i].tid, names[i].name);
+			serial_puts (line);
+		}
+
+	for (i = 0; i < ncpu; i++) {
+		struct trace_buf *b = &bufs[i];
+		uint64_t cnt = b->head < TRACE_CNT ? b->head : TRACE_CNT;
+		uint64_t k;
+
+		snprintf (line, sizeof line, "C %d %llu %llu\n", i, cnt, b->head - cnt);
+		serial_puts (line);
+		for (k = b->head - cnt; k < b->head; k++) {
+			const uint8_t *p = (const uint8_t *) &b->events[k % TRACE_CNT];
+			size_t j;
+
+			for (j = 0; j < sizeof (struct trace_event); j++) {
+				line[2 * j] = hex[p[j] >> 4];
+				line[2 * j + 1] = hex[p[j] & 0xf];
+			}
+			line[2 * j] = '\n';
+			line[2 * j + 1] = '\0';
+			serial_puts (line);
+		}
+	}
+	serial_puts ("TRACE-END\n");
+	serial_flush ();
+
+	trace_enabled = true;
+	__atomic_store_n (&dumping, false, __ATOMIC_RELEASE);
+}
+
+/* Arranges for a kernel thread to call trace_dump() soon, since
+   the dump takes too long to write from an interrupt handler.
+   Returns false, doing nothing, if tracing is off or a requested
+   dump has not started yet.
+
+   This function may be called from an interrupt handler. */
+bool
+trace_request_dump (void) {
+	if (!trace_enabled || system_wq == NULL)
+		return false;
+	return schedule_work (&dump_work);
+}
+
+/* Work function of dump_work. */
+static void
+dump_work_func (void *aux UNUSED) {
+	trace_dump ();
+}
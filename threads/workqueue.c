@@ -0,0 +1,364 @@
+#include "threads/workqueue.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Workqueues.
+
+   A workqueue is a list of pending work items served by a fixed
+   pool of kernel threads, so that code running in an interrupt
+   handler, or on a latency-critical path such as a page fault,
+   can hand off work that may sleep or take a while.
+
+   The list of pending work is protected by disabling interrupts,
+   because work may be queued from interrupt handlers, including
+   the timer callbacks of delayed work.  Each queued item ups the
+   `avail' semaphore once; a worker that finds the list empty
+   because the item was cancelled simply goes back to waiting.
+
+   Which item each worker is running is protected by the queue's
+   lock instead, which lets flushers wait on a condition variable
+   that workers signal as they finish.  A worker never touches a
+   work item after its function returns, so the function may free
+   the item. */
+
+/* A worker thread. */
+struct worker {
+	struct workqueue *wq;       /* Queue served. */
+	struct work *current;       /* Work being run, or NULL. */
+};
+
+/* A workqueue. */
+struct workqueue {
+	char name[16];              /* Name, for debugging purposes. */
+	struct list pending;        /* Queued work, oldest first. */
+	struct semaphore avail;     /* Upped once for each queued work. */
+	struct lock lock;           /* Protects workers' `current'. */
+	struct condition done;      /* Signaled when a worker finishes. */
+	struct worker *workers;     /* Worker pool. */
+	int worker_cnt;             /* Number of workers. */
+	long long runs;             /* # of works run. */
+	struct list_elem elem;      /* Element in all_wqs. */
+};
+
+struct workqueue *system_wq;
+
+/* Number of workers serving system_wq.
+   Controlled by kernel command-line option "-kworkers=N". */
+int system_wq_workers = 2;
+
+/* All workqueues, for statistics. */
+static struct list all_wqs;
+
+static thread_func worker_loop;
+static timeout_func delayed_work_timer;
+
+/* Creates system_wq.  Called once, after thread_start(), before
+   any other workqueue is created. */
+void
+workqueue_init (void) {
+	list_init (&all_wqs);
+	if (system_wq_workers < 1)
+		system_wq_workers = 1;
+	system_wq = workqueue_create ("kworker", system_wq_workers, PRI_DEFAULT);
+	if (system_wq == NULL)
+		PANIC ("workqueue_init: cannot create system workqueue");
+}
+
+/* Creates a workqueue named NAME served by WORKERS kernel threads
+   running at PRIORITY, so that at most WORKERS of its items run
+   at once.  Returns the new queue, or a null pointer if memory
+   is short.  Workqueues are never destroyed. */
+struct workqueue *
+workqueue_create (const char *name, int workers, int priority) {
+	struct workqueue *wq;
+	int i;
+
+	ASSERT (workers > 0);
+
+	wq = malloc (sizeof *wq);
+	if (wq == NULL)
+		return NULL;
+	wq->workers = calloc (workers, sizeof *wq->workers);
+	if (wq->workers == NULL) {
+		free (wq);
+		return NULL;
+	}
+
+	strlcpy (wq->name, name, sizeof wq->name);
+	list_init (&wq->pending);
+	sema_init (&wq->avail, 0);
+	lock_init (&wq->lock);
+	cond_init (&wq->done);
+	wq->worker_cnt = workers;
+	wq->runs = 0;
+	list_push_back (&all_wqs, &wq->elem);
+
+	for (i = 0; i < workers; i++) {
+		char thread_name[16];
+
+		wq->workers[i].wq = wq;
+		snprintf (thread_name, sizeof thread_name, "%s/%d", name, i);
+		if (thread_create (thread_name, priority, worker_loop,
+					&wq->workers[i]) == TID_ERROR)
+			PANIC ("workqueue_create: cannot create worker %s", thread_name);
+	}
+	return wq;
+}
+
+/* Initializes W to call FUNC with AUX when it runs. */
+void
+work_init (struct work *w, work_func *func, void *aux) {
+	ASSERT (w != NULL);
+	ASSERT (func != NULL);
+
+	w->func = func;
+	w->aux = aux;
+	w->wq = NULL;
+	w->pending = false;
+}
+
+/* Initializes DW to call FUNC with AUX when it runs. */
+void
+delayed_work_init (struct delayed_work *dw, work_func *func, void *aux) {
+	work_init (&dw->work, func, aux);
+	timeout_init (&dw->timer, delayed_work_timer, dw);
+}
+
+/* Appends W, which must be marked pending, to its queue.
+   Interrupts must be off. */
+static void
+enqueue (struct work *w) {
+	ASSERT (intr_get_level () == INTR_OFF);
+	ASSERT (w->pending);
+
+	list_push_back (&w->wq->pending, &w->elem);
+	sema_up (&w->wq->avail);
+}
+
+/* Queues W on WQ to run as soon as a worker is free.  Returns
+   false, doing nothing, if W is already pending.  W may be
+   queued again while it is running.
+
+   This function may be called from an interrupt handler. */
+bool
+queue_work (struct workqueue *wq, struct work *w) {
+	enum intr_level old_level;
+	bool queued = false;
+
+	ASSERT (wq != NULL);
+	ASSERT (w != NULL);
+
+	old_level = intr_disable ();
+	if (!w->pending) {
+		w->pending = true;
+		w->wq = wq;
+		enqueue (w);
+		queued = true;
+	}
+	intr_set_level (old_level);
+	return queued;
+}
+
+/* Queues DW on WQ after TICKS timer ticks, or at once if TICKS
+   is not positive.  Returns false, doing nothing, if DW is
+   already pending, whether or not its delay has passed.
+
+   This function may be called from an interrupt handler. */
+bool
+queue_delayed_work (struct workqueue *wq, struct delayed_work *dw,
+		int64_t ticks) {
+	enum intr_level old_level;
+	bool queued = false;
+
+	ASSERT (wq != NULL);
+	ASSERT (dw != NULL);
+
+	if (ticks <= 0)
+		return queue_work (wq, &dw->work);
+
+	old_level = intr_disable ();
+	if (!dw->work.pending) {
+		dw->work.pending = true;
+		dw->work.wq = wq;
+		timeout_add (&dw->timer, timer_ticks () + ticks);
+		queued = true;
+	}
+	intr_set_level (old_level);
+	return queued;
+}
+
+/* Timeout callback that queues delayed work DW_. */
+static void
+delayed_work_timer (void *dw_) {
+	struct delayed_work *dw = dw_;
+
+	enqueue (&dw->work);
+}
+
+/* Queues W on system_wq.  See queue_work(). */
+bool
+schedule_work (struct work *w) {
+	return queue_work (system_wq, w);
+}
+
+/* Queues DW on system_wq after TICKS timer ticks.  See
+   queue_delayed_work(). */
+bool
+schedule_delayed_work (struct delayed_work *dw, int64_t ticks) {
+	return queue_delayed_work (system_wq, dw, ticks);
+}
+
+/* Returns true if W is pending on WQ or being run by one of its
+   workers.  WQ's lock must be held. */
+static bool
+work_busy (struct workqueue *wq, struct work *w) {
+	int i;
+
+	ASSERT (lock_held_by_current_thread (&wq->lock));
+
+	if (w->pending)
+		return true;
+	for (i = 0; i < wq->worker_cnt; i++)
+		if (wq->workers[i].current == w)
+			return true;
+	return false;
+}
+
+/* Waits until W has finished running, if it is pending or
+   running, including the wait for delayed work's timer.  Must
+   not be called from an interrupt handler, nor from a work
+   function on W's own queue. */
+void
+flush_work (struct work *w) {
+	struct workqueue *wq = w->wq;
+
+	ASSERT (!intr_context ());
+
+	if (wq == NULL)
+		return;
+	lock_acquire (&wq->lock);
+	while (work_busy (wq, w))
+		cond_wait (&wq->done, &wq->lock);
+	lock_release (&wq->lock);
+}
+
+/* Waits until WQ has no queued work and no work running.  Work
+   that keeps requeueing itself can make this wait forever.
+   Delayed work whose timer has not expired is not waited for.
+   Must not be called from an interrupt handler, nor from a work
+   function on WQ. */
+void
+flush_workqueue (struct workqueue *wq) {
+	int i;
+
+	ASSERT (!intr_context ());
+
+	lock_acquire (&wq->lock);
+	for (;;) {
+		bool busy = !list_empty (&wq->pending);
+
+		for (i = 0; i < wq->worker_cnt && !busy; i++)
+			busy = wq->workers[i].current != NULL;
+		if (!busy)
+			break;
+		cond_wait (&wq->done, &wq->lock);
+	}
+	lock_release (&wq->lock);
+}
+
+/* Dequeues W if it is pending, then waits for it to finish if it
+   is running.  Returns true if W was pending.  Must not be
+   called from an interrupt handler, nor from a work function on
+   W's own queue. */
+bool
+cancel_work (struct work *w) {
+	enum intr_level old_level;
+	bool pending;
+
+	old_level = intr_disable ();
+	pending = w->pending;
+	if (pending) {
+		list_remove (&w->elem);
+		w->pending = false;
+	}
+	intr_set_level (old_level);
+
+	flush_work (w);
+	return pending;
+}
+
+/* Like cancel_work(), but also stops DW's timer if its delay has
+   not passed yet. */
+bool
+cancel_delayed_work (struct delayed_work *dw) {
+	enum intr_level old_level = intr_disable ();
+
+	if (timeout_cancel (&dw->timer)) {
+		dw->work.pending = false;
+		intr_set_level (old_level);
+		flush_work (&dw->work);
+		return true;
+	}
+	intr_set_level (old_level);
+	return cancel_work (&dw->work);
+}
+
+/* Worker thread: runs work from its queue, one item at a time,
+   forever. */
+static void
+worker_loop (void *worker_) {
+	struct worker *worker = worker_;
+	struct workqueue *wq = worker->wq;
+
+	for (;;) {
+		work_func *func = NULL;
+		void *aux = NULL;
+		enum intr_level old_level;
+
+		sema_down (&wq->avail);
+
+		lock_acquire (&wq->lock);
+		old_level = intr_disable ();
+		if (!list_empty (&wq->pending)) {
+			struct work *w = list_entry (list_pop_front (&wq->pending),
+					struct work, elem);
+
+			w->pending = false;
+			worker->current = w;
+			func = w->func;
+			aux = w->aux;
+		}
+		intr_set_level (old_level);
+		lock_release (&wq->lock);
+
+		/* The work was cancelled after upping `avail'. */
+		if (func == NULL)
+			continue;
+
+		func (aux);
+
+		lock_acquire (&wq->lock);
+		worker->current = NULL;
+		wq->runs++;
+		cond_broadcast (&wq->done, &wq->lock);
+		lock_release (&wq->lock);
+	}
+}
+
+/* Prints workqueue statistics. */
+void
+workqueue_print_stats (void) {
+	struct list_elem *e;
+
+	for (e = list_begin (&all_wqs); e != list_end (&all_wqs); e = list_next (e)) {
+		struct workqueue *wq = list_entry (e, struct workqueue, elem);
+
+		printf ("Workqueue %s: %lld works run by %d workers\n",
+				wq->name, wq->runs, wq->worker_cnt);
+	}
+}
@@ -2,8 +2,10 @@
 #include <inttypes.h>
 #include <stdio.h>
 #include "userprog/gdt.h"
+#include "userprog/process.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
 #include "intrinsic.h"
 
 /* Number of page faults processed. */
@@ -12,6 +14,9 @@ static long long page_fault_cnt;
 static void kill(struct intr_frame *);
 static void page_fault(struct intr_frame *);
 
+/* Labels in get_user_int(). */
+extern const char get_user_int_load[], get_user_int_fixup[];
+
 /* Registers handlers for interrupts that can be caused by user
    programs.
 
@@ -45,8 +50,6 @@ void exception_init(void)
 	intr_register_int(0, 0, INTR_ON, kill, "#DE Divide Error");
 	intr_register_int(1, 0, INTR_ON, kill, "#DB Debug Exception");
 	intr_register_int(6, 0, INTR_ON, kill, "#UD Invalid Opcode Exception");
-	intr_register_int(7, 0, INTR_ON, kill,
-					  "#NM Device Not Available Exception");
 	intr_register_int(11, 0, INTR_ON, kill, "#NP Segment Not Present");
 	intr_register_int(12, 0, INTR_ON, kill, "#SS Stack Fault Exception");
 	intr_register_int(13, 0, INTR_ON, kill, "#GP General Protection Exception");
@@ -88,6 +91,7 @@ kill(struct intr_frame *f)
 		printf("%s: dying due to interrupt %#04llx (%s).\n",
 			   thread_name(), f->vec_no, intr_name(f->vec_no));
 		intr_dump_frame(f);
+		process_terminate(-1);
 		thread_exit();
 
 	case SEL_KCSEG:
@@ -148,6 +152,13 @@ page_fault(struct intr_frame *f)
 		return;
 #endif
 
+	/* A fault in get_user_int() makes it return false. */
+	if (!user && f->rip == (uintptr_t)get_user_int_load)
+	{
+		f->rip = (uintptr_t)get_user_int_fixup;
+		return;
+	}
+
 	/* Count page faults. */
 	page_fault_cnt++;
 
@@ -161,3 +172,32 @@ page_fault(struct intr_frame *f)
 	exit(-1);
 	kill(f);
 }
+
+/* Copies the int at user address UADDR, which must be below
+   KERN_BASE, to *DST.  Returns true if successful, false if
+   UADDR is not mapped and cannot be faulted in.  Unlike a plain
+   access, a bad address does not kill the process, so this may
+   be used while holding locks that exit() needs. */
+bool get_user_int(const int *uaddr, int *dst)
+{
+	bool ok;
+	int val;
+
+	ASSERT(is_user_vaddr(uaddr));
+
+	/* page_fault() resumes a fault at get_user_int_load at
+	   get_user_int_fixup, with OK still false. */
+	asm volatile("movb $0, %0\n"
+				 ".globl get_user_int_load\n"
+				 "get_user_int_load:\n\t"
+				 "movl (%2), %1\n\t"
+				 "movb $1, %0\n"
+				 ".globl get_user_int_fixup\n"
+				 "get_user_int_fixup:"
+				 : "=&r"(ok), "=&r"(val)
+				 : "r"(uaddr)
+				 : "memory");
+	if (ok)
+		*dst = val;
+	return ok;
+}
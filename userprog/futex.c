@@ -0,0 +1,100 @@
+#include "userprog/futex.h"
+#include <list.h>
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "userprog/exception.h"
+#include "userprog/process.h"
+
+/* Futexes.
+
+   A futex is an int in user memory that the threads of a process
+   use to sleep until another thread changes it.  Futexes are
+   keyed on user virtual address: the threads of a process share
+   one address space, and processes share no memory.  So each
+   thread group keeps a single list of its sleeping threads,
+   protected by the group's lock.
+
+   futex_wait() compares the futex with the expected value and
+   queues the thread under that lock, which futex_wake() also
+   takes, so a wake that follows a change to the futex cannot
+   fall between the compare and the sleep.  It reads the futex
+   with get_user_int(), because a fault that killed the process
+   here would reach process_terminate() with the lock held. */
+
+/* A thread sleeping in futex_wait(). */
+struct futex_waiter {
+	struct list_elem elem;      /* Element in group's futexes. */
+	const int *uaddr;           /* Futex waited on. */
+	struct semaphore wakeup;    /* Upped to wake the thread. */
+};
+
+/* If the int at user address UADDR, which must be a user address
+   and aligned, is VAL, sleeps until futex_wake() is called on
+   UADDR and returns 0.  Otherwise returns -1 at once, as it does
+   if UADDR is not mapped, the process is exiting, or memory is
+   short. */
+int
+futex_wait (const int *uaddr, int val) {
+	struct thread_group *g = process_group ();
+	struct futex_waiter w;
+	int cur;
+
+	if (g == NULL)
+		return -1;
+
+	lock_acquire (&g->lock);
+	if (g->exiting || !get_user_int (uaddr, &cur) || cur != val) {
+		lock_release (&g->lock);
+		return -1;
+	}
+	w.uaddr = uaddr;
+	sema_init (&w.wakeup, 0);
+	list_push_back (&g->futexes, &w.elem);
+	lock_release (&g->lock);
+
+	sema_down (&w.wakeup);
+	return 0;
+}
+
+/* Wakes up to CNT threads sleeping on the futex at user address
+   UADDR, oldest first.  Returns the number woken. */
+int
+futex_wake (const int *uaddr, int cnt) {
+	struct thread_group *g = thread_current ()->group;
+	struct list_elem *e;
+	int woken = 0;
+
+	/* Only futex_wait() creates the group for a process that has
+	   no other threads, so without one nobody can be waiting. */
+	if (g == NULL)
+		return 0;
+
+	lock_acquire (&g->lock);
+	for (e = list_begin (&g->futexes); e != list_end (&g->futexes)
+			&& woken < cnt;) {
+		struct futex_waiter *w = list_entry (e, struct futex_waiter, elem);
+
+		e = list_next (e);
+		if (w->uaddr == uaddr) {
+			list_remove (&w->elem);
+			sema_up (&w->wakeup);
+			woken++;
+		}
+	}
+	lock_release (&g->lock);
+	return woken;
+}
+
+/* Wakes every thread of G sleeping on any futex.  Used when the
+   process exits. */
+void
+futex_wake_all (struct thread_group *g) {
+	lock_acquire (&g->lock);
+	while (!list_empty (&g->futexes)) {
+		struct futex_waiter *w = list_entry (list_pop_front (&g->futexes),
+				struct futex_waiter, elem);
+
+		sema_up (&w->wakeup);
+	}
+	lock_release (&g->lock);
+}
@@ -1,6 +1,7 @@
 #include "userprog/gdt.h"
 #include <debug.h>
 #include "userprog/tss.h"
+#include "threads/cpu.h"
 #include "threads/mmu.h"
 #include "threads/palloc.h"
 #include "threads/vaddr.h"
@@ -61,15 +62,17 @@ struct segment_descriptor64 {
 	type, 1, dpl, 1, (unsigned) (lim) >> 28, 0, 1, 0, 1, \
 	(unsigned) (base) >> 24 }
 
-static struct segment_desc gdt[SEL_CNT] = {
+/* Segments through SEL_UCSEG, then one TSS descriptor per CPU,
+   each taking two entries. */
+#define GDT_CNT ((SEL_TSS >> 3) + 2 * NCPU_MAX)
+
+static struct segment_desc gdt[GDT_CNT] = {
 	[SEL_NULL >> 3] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
 	[SEL_KCSEG >> 3] = SEG64 (0xa, 0x0, 0xffffffff, 0),
 	[SEL_KDSEG >> 3] = SEG64 (0x2, 0x0, 0xffffffff, 0),
 	[SEL_UDSEG >> 3] = SEG64 (0x2, 0x0, 0xffffffff, 3),
 	[SEL_UCSEG >> 3] = SEG64 (0xa, 0x0, 0xffffffff, 3),
-	[SEL_TSS >> 3] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-	[6] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
-	[7] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+	/* TSS descriptors are filled in by gdt_init(). */
 };
 
 struct desc_ptr gdt_ds = {
@@ -77,34 +80,53 @@ struct desc_ptr gdt_ds = {
 	.address = (uint64_t) gdt
 };
 
+static void gdt_load (void);
+
 /* Sets up a proper GDT.  The bootstrap loader's GDT didn't
    include user-mode selectors or a TSS, but we need both now. */
 void
 gdt_init (void) {
-	/* Initialize GDT. */
-	struct segment_descriptor64 *tss_desc =
-		(struct segment_descriptor64 *) &gdt[SEL_TSS >> 3];
-	struct task_state *tss = tss_get ();
+	int i;
+
+	/* Initialize GDT with a TSS descriptor for each CPU. */
+	for (i = 0; i < NCPU_MAX; i++) {
+		struct segment_descriptor64 *tss_desc =
+			(struct segment_descriptor64 *) &gdt[SEL_TSS_CPU (i) >> 3];
+		struct task_state *tss = tss_get_cpu (i);
+
+		*tss_desc = (struct segment_descriptor64) {
+			.lim_15_0 = (uint64_t) (sizeof (struct task_state)) & 0xffff,
+			.base_15_0 = (uint64_t) (tss) & 0xffff,
+			.base_23_16 = ((uint64_t) (tss) >> 16) & 0xff,
+			.type = 0x9,
+			.s = 0,
+			.dpl = 0,
+			.p = 1,
+			.lim_19_16 = ((uint64_t)(sizeof (struct task_state)) >> 16) & 0xf,
+			.avl = 0,
+			.rsv1 = 0,
+			.g = 0,
+			.base_31_24 = ((uint64_t)(tss) >> 24) & 0xff,
+			.base_63_32 = ((uint64_t)(tss) >> 32) & 0xffffffff,
+			.res1 = 0,
+			.clear = 0,
+			.res2 = 0
+		};
+	}
 
-	*tss_desc = (struct segment_descriptor64) {
-		.lim_15_0 = (uint64_t) (sizeof (struct task_state)) & 0xffff,
-		.base_15_0 = (uint64_t) (tss) & 0xffff,
-		.base_23_16 = ((uint64_t) (tss) >> 16) & 0xff,
-		.type = 0x9,
-		.s = 0,
-		.dpl = 0,
-		.p = 1,
-		.lim_19_16 = ((uint64_t)(sizeof (struct task_state)) >> 16) & 0xf,
-		.avl = 0,
-		.rsv1 = 0,
-		.g = 0,
-		.base_31_24 = ((uint64_t)(tss) >> 24) & 0xff,
-		.base_63_32 = ((uint64_t)(tss) >> 32) & 0xffffffff,
-		.res1 = 0,
-		.clear = 0,
-		.res2 = 0
-	};
+	gdt_load ();
+}
+
+/* Loads the GDT that gdt_init() set up on an application
+   processor. */
+void
+gdt_init_ap (void) {
+	gdt_load ();
+}
 
+/* Loads the GDT and reloads the segment registers from it. */
+static void
+gdt_load (void) {
 	lgdt (&gdt_ds);
 	/* reload segment registers */
 	asm volatile("movw %%ax, %%gs" :: "a" (SEL_UDSEG));
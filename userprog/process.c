@@ -8,12 +8,16 @@
 #include "userprog/gdt.h"
 #include "userprog/tss.h"
 #include "userprog/syscall.h"
+#include "userprog/futex.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "threads/flags.h"
+#include "threads/fpu.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/slab.h"
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
@@ -31,6 +35,156 @@ static void process_cleanup(void);
 static bool load(const char *file_name, struct intr_frame *if_);
 static void initd(void *f_name);
 static void __do_fork(void *);
+static void start_thread(void *);
+static void process_kill_threads(void);
+static void exit_thread(void);
+static void unmap_stack(int slot);
+
+/* User stacks of the threads created by process_thread_create().
+   Slot N's stack ends THREAD_STACK_TOP - N * THREAD_STACK_SIZE,
+   below the main thread's stack and the 1 MB it may grow into.
+   The lowest page of each slot is left unmapped as a guard. */
+#define THREAD_MAX 32 /* Stack slots, bits in stack_slots. */
+#define THREAD_STACK_PAGES 16
+#define THREAD_STACK_SIZE (THREAD_STACK_PAGES * PGSIZE)
+#define THREAD_STACK_TOP (USER_STACK - (1 << 20))
+
+/* Returns the main thread of T's process, which owns the state
+   shared by the process's threads. */
+static struct thread *
+process_of(struct thread *t)
+{
+	return t->group != NULL ? t->group->leader : t;
+}
+
+/* Returns the main thread of the running thread's process.  Use
+   its pml4, spt, mmap_list and fd table rather than those of
+   thread_current(), which are unused in the other threads. */
+struct thread *
+process_current(void)
+{
+	return process_of(thread_current());
+}
+
+/* Sets *BOTTOM and *TOP to the bounds of the running thread's
+   own user stack: the 1 MB below USER_STACK that the main thread
+   may grow into, or the stack slot of a thread created by
+   process_thread_create(), without its guard page. */
+void process_stack_bounds(uintptr_t *bottom, uintptr_t *top)
+{
+	int slot = thread_current()->stack_slot;
+
+	if (slot < 0)
+	{
+		*top = USER_STACK;
+		*bottom = USER_STACK - (1 << 20);
+	}
+	else
+	{
+		*top = THREAD_STACK_TOP - slot * THREAD_STACK_SIZE;
+		*bottom = *top - THREAD_STACK_SIZE + PGSIZE;
+	}
+}
+
+/* Returns the running process's thread group, creating it if
+   the process has none yet, or a null pointer if memory is
+   short. */
+struct thread_group *
+process_group(void)
+{
+	struct thread *curr = thread_current();
+	struct thread_group *g = curr->group;
+
+	if (g != NULL)
+		return g;
+
+	g = malloc(sizeof *g);
+	if (g == NULL)
+		return NULL;
+	g->leader = curr;
+	lock_init(&g->lock);
+	list_init(&g->members);
+	cond_init(&g->reaped);
+	list_init(&g->futexes);
+	g->stack_slots = 0;
+	g->exiting = false;
+	lock_init(&g->fd_lock);
+	lock_init(&g->mmap_lock);
+	curr->group = g;
+	return g;
+}
+
+/* Returns true if the running thread's process is exiting, in
+   which case the thread must exit instead of returning to user
+   mode. */
+bool process_exiting(void)
+{
+	struct thread_group *g = thread_current()->group;
+
+	return g != NULL && g->exiting;
+}
+
+/* Makes the running process exit with STATUS: records STATUS as
+   the process's exit status and tells the other threads to
+   exit.  The caller must still exit itself.  Returns false,
+   doing nothing, if the process is already exiting. */
+bool process_terminate(int status)
+{
+	struct thread_group *g = thread_current()->group;
+
+	if (g != NULL)
+	{
+		lock_acquire(&g->lock);
+		if (g->exiting)
+		{
+			lock_release(&g->lock);
+			return false;
+		}
+		g->exiting = true;
+		lock_release(&g->lock);
+		futex_wake_all(g);
+	}
+	process_current()->exit_status = status;
+	return true;
+}
+
+/* Locks the running process's fd table against its other
+   threads.  Required around changes to the table. */
+void process_lock_files(void)
+{
+	struct thread_group *g = thread_current()->group;
+
+	if (g != NULL)
+		lock_acquire(&g->fd_lock);
+}
+
+/* Unlocks the fd table locked by process_lock_files(). */
+void process_unlock_files(void)
+{
+	struct thread_group *g = thread_current()->group;
+
+	if (g != NULL)
+		lock_release(&g->fd_lock);
+}
+
+/* Locks the running process's mmap_list against its other
+   threads. */
+void process_lock_mmaps(void)
+{
+	struct thread_group *g = thread_current()->group;
+
+	if (g != NULL)
+		lock_acquire(&g->mmap_lock);
+}
+
+/* Unlocks the mmap_list locked by process_lock_mmaps(). */
+void process_unlock_mmaps(void)
+{
+	struct thread_group *g = thread_current()->group;
+
+	if (g != NULL)
+		lock_release(&g->mmap_lock);
+}
 
 /*
 부모 thread가 자신의 child_list에서 입력 받은 pid를 가지고 있는 child thread를 검색
@@ -59,16 +213,20 @@ EXTRA multi-oom을 위해 바꿨지만 문제를 해결한 것 같지 않음
 */
 int process_add_file(struct file *f)
 {
-	struct thread *curr = thread_current();
+	struct thread *curr = process_current();
+	int fd = -1;
 
+	process_lock_files();
 	while (curr->fd_idx < FDT_LIMIT && curr->fdt[curr->fd_idx])
 		curr->fd_idx++;
 
-	if (curr->fd_idx >= FDT_LIMIT)
-		return -1;
-
-	curr->fdt[curr->fd_idx] = f;
-	return curr->fd_idx;
+	if (curr->fd_idx < FDT_LIMIT)
+	{
+		curr->fdt[curr->fd_idx] = f;
+		fd = curr->fd_idx;
+	}
+	process_unlock_files();
+	return fd;
 
 	// int fd = 2;
 	// while (curr->fdt[fd] != NULL && fd < FDT_LIMIT)
@@ -92,7 +250,37 @@ struct file *process_get_file(int fd)
 	if (fd < 0 || fd >= FDT_LIMIT)
 		return NULL;
 
-	return thread_current()->fdt[fd];
+	return process_current()->fdt[fd];
+}
+
+/* Returns the struct file pointer for FD, as process_get_file()
+   does, but pinned: if another thread of the process closes FD
+   while the caller uses the file, the file is not freed until
+   the caller unpins it with process_unpin_file(). */
+struct file *process_pin_file(int fd)
+{
+	struct file *f;
+
+	process_lock_files();
+	f = process_get_file(fd);
+	if ((uintptr_t)f > 2)
+		f->pin_cnt++;
+	process_unlock_files();
+	return f;
+}
+
+/* Unpins F, pinned by process_pin_file(), closing it if its fd
+   was closed meanwhile.  F may be null, STDIN or STDOUT. */
+void process_unpin_file(struct file *f)
+{
+	if ((uintptr_t)f <= 2)
+		return;
+
+	process_lock_files();
+	ASSERT(f->pin_cnt > 0);
+	if (--f->pin_cnt == 0 && f->closed)
+		file_close(f);
+	process_unlock_files();
 }
 
 /* General process initializer for initd and other process. */
@@ -238,6 +426,7 @@ __do_fork(void *aux)
 	struct intr_frame if_;
 	struct thread *parent = (struct thread *)aux;
 	struct thread *current = thread_current();
+	struct thread *owner = process_of(parent);
 	bool succ = true;
 
 	/*
@@ -254,12 +443,15 @@ __do_fork(void *aux)
 
 	process_activate(current);
 
+	if (!fpu_fork(parent))
+		goto error;
+
 #ifdef VM
 	supplemental_page_table_init(&current->spt);
-	if (!supplemental_page_table_copy(&current->spt, &parent->spt))
+	if (!supplemental_page_table_copy(&current->spt, &owner->spt))
 		goto error;
 #else
-	if (!pml4_for_each(parent->pml4, duplicate_pte, parent))
+	if (!pml4_for_each(owner->pml4, duplicate_pte, owner))
 		goto error;
 #endif
 
@@ -269,8 +461,15 @@ __do_fork(void *aux)
 	 * TODO:       from the fork() until this function successfully duplicates
 	 * TODO:       the resources of parent.*/
 
-	if (parent->fd_idx >= FDT_LIMIT)
+	/* The parent's other threads may be changing the fd table. */
+	if (parent->group != NULL)
+		lock_acquire(&parent->group->fd_lock);
+	if (owner->fd_idx >= FDT_LIMIT)
+	{
+		if (parent->group != NULL)
+			lock_release(&parent->group->fd_lock);
 		goto error;
+	}
 
 	/*
 	process.h에서 struct MapElem 선언
@@ -283,7 +482,7 @@ __do_fork(void *aux)
 
 	for (int i = 0; i < FDT_LIMIT; i++)
 	{
-		struct file *f = parent->fdt[i];
+		struct file *f = owner->fdt[i];
 		if (f == NULL)
 			continue;
 
@@ -321,7 +520,9 @@ __do_fork(void *aux)
 		}
 	}
 
-	current->fd_idx = parent->fd_idx;
+	current->fd_idx = owner->fd_idx;
+	if (parent->group != NULL)
+		lock_release(&parent->group->fd_lock);
 
 	// fork에서 load가 다끝났으므로 부모 process를 다시 wakeup
 	sema_up(&current->fork);
@@ -394,10 +595,19 @@ int process_exec(void *f_name)
 	_if.cs = SEL_UCSEG;
 	_if.eflags = FLAG_IF | FLAG_MBS;
 
+	/* Only the main thread may exec, after the others exit. */
+	if (thread_current()->stack_slot >= 0)
+	{
+		palloc_free_page(file_name);
+		return -1;
+	}
+	process_kill_threads();
+
 	/* We first kill the current context */
 	process_cleanup();
+	fpu_discard(thread_current());
 
-	supplemental_page_table_init(&thread_current()->spt.table);
+	supplemental_page_table_init(&thread_current()->spt);
 
 	/* And then load the binary */
 	success = load(file_name, &_if);
@@ -453,6 +663,288 @@ int process_wait(tid_t child_tid UNUSED)
 	return status;
 }
 
+/* Registers the pages of stack slot SLOT in the running
+   process's SPT.  Returns the top of the stack, or 0 if memory
+   is short. */
+static uintptr_t
+map_stack(int slot)
+{
+	uintptr_t top = THREAD_STACK_TOP - slot * THREAD_STACK_SIZE;
+	uintptr_t va;
+
+	for (va = top - PGSIZE; va > top - THREAD_STACK_SIZE; va -= PGSIZE)
+		if (!vm_alloc_page(VM_ANON, (void *)va, true))
+		{
+			struct supplemental_page_table *spt = &process_current()->spt;
+
+			/* VA may be taken by a mapping of the process's own. */
+			for (va += PGSIZE; va < top; va += PGSIZE)
+				spt_remove_page(spt, spt_find_page(spt, (void *)va));
+			return 0;
+		}
+	return top;
+}
+
+/* Removes the pages of stack slot SLOT from the running
+   process's SPT, along with their frames. */
+static void
+unmap_stack(int slot)
+{
+	struct supplemental_page_table *spt = &process_current()->spt;
+	uintptr_t top = THREAD_STACK_TOP - slot * THREAD_STACK_SIZE;
+	uintptr_t va;
+
+	for (va = top - PGSIZE; va > top - THREAD_STACK_SIZE; va -= PGSIZE)
+	{
+		struct page *page = spt_find_page(spt, (void *)va);
+
+		if (page != NULL)
+			spt_remove_page(spt, page);
+	}
+}
+
+/* Arguments of start_thread(). */
+struct thread_start
+{
+	struct thread_group *group; /* Group to join. */
+	int slot;					/* Stack slot. */
+	uintptr_t entry;			/* User function to run. */
+	uint64_t arg0, arg1;		/* Its arguments. */
+};
+
+/* Creates a thread in the running process that calls user
+   function ENTRY with ARG0 and ARG1 on a stack of its own and
+   shares the process's address space and fd table.  Returns the
+   new thread's tid, or TID_ERROR if the thread cannot be created
+   or the process already has THREAD_MAX threads besides its main
+   thread. */
+tid_t process_thread_create(uintptr_t entry, uint64_t arg0, uint64_t arg1)
+{
+	struct thread_group *g;
+	struct thread_start start;
+	struct thread *child;
+	tid_t tid;
+	int slot;
+
+	if (entry == 0 || !is_user_vaddr(entry))
+		return TID_ERROR;
+	g = process_group();
+	if (g == NULL)
+		return TID_ERROR;
+
+	lock_acquire(&g->lock);
+	for (slot = 0; slot < THREAD_MAX; slot++)
+		if ((g->stack_slots & (1u << slot)) == 0)
+			break;
+	if (g->exiting || slot == THREAD_MAX)
+	{
+		lock_release(&g->lock);
+		return TID_ERROR;
+	}
+	g->stack_slots |= 1u << slot;
+	lock_release(&g->lock);
+
+	if (map_stack(slot) == 0)
+		goto error;
+
+	start.group = g;
+	start.slot = slot;
+	start.entry = entry;
+	start.arg0 = arg0;
+	start.arg1 = arg1;
+	tid = thread_create(thread_name(), thread_get_priority(), start_thread, &start);
+	if (tid == TID_ERROR)
+	{
+		unmap_stack(slot);
+		goto error;
+	}
+
+	/* Wait until the child has copied START and joined G.  It is
+	   not our child process, so forget it as one. */
+	child = get_child_process(tid);
+	sema_down(&child->fork);
+	list_remove(&child->child_elem);
+	return tid;
+
+error:
+	lock_acquire(&g->lock);
+	g->stack_slots &= ~(1u << slot);
+	lock_release(&g->lock);
+	return TID_ERROR;
+}
+
+/* A thread function that enters user mode in a thread created by
+   process_thread_create(). */
+static void
+start_thread(void *start_)
+{
+	struct thread_start *start = start_;
+	struct thread_group *g = start->group;
+	struct thread *curr = thread_current();
+	struct intr_frame if_;
+
+	/* The fd table is the main thread's. */
+	palloc_free_multiple(curr->fdt, 3);
+	curr->fdt = NULL;
+
+	curr->group = g;
+	curr->stack_slot = start->slot;
+	curr->pml4 = g->leader->pml4;
+	process_activate(curr);
+
+	memset(&if_, 0, sizeof if_);
+	if_.ds = if_.es = if_.ss = SEL_UDSEG;
+	if_.cs = SEL_UCSEG;
+	if_.eflags = FLAG_IF | FLAG_MBS;
+	if_.rip = start->entry;
+	if_.R.rdi = start->arg0;
+	if_.R.rsi = start->arg1;
+
+	/* Fake return address, as pushed by a call. */
+	if_.rsp = THREAD_STACK_TOP - start->slot * THREAD_STACK_SIZE - 8;
+	curr->user_rsp = if_.rsp;
+
+	lock_acquire(&g->lock);
+	list_push_back(&g->members, &curr->member_elem);
+	lock_release(&g->lock);
+	sema_up(&curr->fork);
+
+	if (process_exiting())
+		thread_exit();
+	do_iret(&if_);
+	NOT_REACHED();
+}
+
+/* Waits for T, a thread of group G that the caller has claimed
+   by setting its `joined', to exit, and returns its exit
+   status. */
+static int
+reap_thread(struct thread_group *g, struct thread *t)
+{
+	int status;
+
+	sema_down(&t->wait);
+	status = t->exit_status;
+
+	lock_acquire(&g->lock);
+	list_remove(&t->member_elem);
+	cond_broadcast(&g->reaped, &g->lock);
+	lock_release(&g->lock);
+
+	/* Let T finish dying. */
+	sema_up(&t->exit);
+	return status;
+}
+
+/* Waits for thread TID of the running process to exit, stores
+   its exit status in *STATUS, and returns true.  Returns false
+   at once if TID is the main thread, the caller itself, not a
+   thread of the process, or already being waited for. */
+bool process_thread_join(tid_t tid, int *status)
+{
+	struct thread_group *g = thread_current()->group;
+	struct thread *t = NULL;
+	struct list_elem *e;
+
+	if (g == NULL)
+		return false;
+
+	lock_acquire(&g->lock);
+	for (e = list_begin(&g->members); e != list_end(&g->members); e = list_next(e))
+	{
+		struct thread *member = list_entry(e, struct thread, member_elem);
+
+		if (member->tid == tid && !member->joined && member != thread_current())
+		{
+			t = member;
+			t->joined = true;
+			break;
+		}
+	}
+	lock_release(&g->lock);
+
+	if (t == NULL)
+		return false;
+	*status = reap_thread(g, t);
+	return true;
+}
+
+/* Makes the other threads of the running process exit, waits
+   for them, and frees the process's thread group.  Called by the
+   main thread only. */
+static void
+process_kill_threads(void)
+{
+	struct thread *curr = thread_current();
+	struct thread_group *g = curr->group;
+
+	if (g == NULL)
+		return;
+	ASSERT(g->leader == curr);
+
+	lock_acquire(&g->lock);
+	g->exiting = true;
+	lock_release(&g->lock);
+	futex_wake_all(g);
+
+	/* Reap the members nobody is joining, and wait for the
+	   joiners to reap the rest. */
+	lock_acquire(&g->lock);
+	while (!list_empty(&g->members))
+	{
+		struct thread *t = NULL;
+		struct list_elem *e;
+
+		for (e = list_begin(&g->members); e != list_end(&g->members); e = list_next(e))
+		{
+			struct thread *member = list_entry(e, struct thread, member_elem);
+
+			if (!member->joined)
+			{
+				t = member;
+				t->joined = true;
+				break;
+			}
+		}
+
+		if (t != NULL)
+		{
+			lock_release(&g->lock);
+			reap_thread(g, t);
+			lock_acquire(&g->lock);
+		}
+		else
+			cond_wait(&g->reaped, &g->lock);
+	}
+	lock_release(&g->lock);
+
+	curr->group = NULL;
+	free(g);
+}
+
+/* Exits a thread created by process_thread_create(), leaving the
+   state it shares with the rest of the process alone.  Called by
+   process_exit(). */
+static void
+exit_thread(void)
+{
+	struct thread *curr = thread_current();
+	struct thread_group *g = curr->group;
+
+	unmap_stack(curr->stack_slot);
+	curr->pml4 = NULL;
+	pml4_activate(NULL);
+
+	lock_acquire(&g->lock);
+	g->stack_slots &= ~(1u << curr->stack_slot);
+	lock_release(&g->lock);
+
+	/* Wait for process_thread_join() or the main thread to reap
+	   us. */
+	sema_up(&curr->wait);
+	sema_down(&curr->exit);
+}
+
 /* Exit the process. This function is called by thread_exit (). */
 void process_exit(void)
 {
@@ -462,6 +954,13 @@ void process_exit(void)
 	 * TODO: project2/process_termination.html).
 	 * TODO: We recommend you to implement process resource cleanup here. */
 
+	if (curr->stack_slot >= 0)
+	{
+		exit_thread();
+		return;
+	}
+	process_kill_threads();
+
 	/*
 	실행 중인 file을 닫음
 	deny write on executables를 위해 실행 중인 파일을 계속 open해 놓는다
@@ -916,7 +1415,7 @@ bool lazy_load_segment(struct page *page, void *aux){
 	// laod segment
 	if ((temp = file_read(file, page->frame->kva, page_read_bytes)) != page_read_bytes)
 	{
-		free(file_info);
+		kmem_cache_free(file_info_cache, file_info);
 		return false;
 	}
 
@@ -961,7 +1460,9 @@ load_segment(struct file *file, off_t ofs, uint8_t *upage,
 		TODO: Set up aux to pass information to the lazy_load_segment.
 		aux를 통해 file data 전달을 위해 만든 struct file_info
 		*/
-		struct file_info *file_info = (struct file_info *)malloc(sizeof(struct file_info));
+		struct file_info *file_info = kmem_cache_alloc(file_info_cache);
+		if (file_info == NULL)
+			return false;
 
 		file_info->file = file;
 		file_info->ofs = ofs;
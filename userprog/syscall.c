@@ -1,14 +1,20 @@
 #include "userprog/syscall.h"
 #include <stdio.h>
+#include <string.h>
 #include <syscall-nr.h>
+#include <time.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "threads/loader.h"
 #include "threads/flags.h"
 #include "threads/palloc.h"
+#include "threads/trace.h"
 #include "userprog/gdt.h"
 #include "userprog/process.h"
+#include "userprog/futex.h"
+#include "userprog/tss.h"
 #include "intrinsic.h"
+#include "devices/timer.h"
 #include "filesys/filesys.h"
 #include "filesys/file.h"
 #include "vm/vm.h"
@@ -28,14 +34,11 @@ void syscall_handler(struct intr_frame *);
 #define MSR_STAR 0xc0000081			/* Segment selector msr */
 #define MSR_LSTAR 0xc0000082		/* Long mode SYSCALL target */
 #define MSR_SYSCALL_MASK 0xc0000084 /* Mask for the eflags */
+#define MSR_KERNEL_GS_BASE 0xc0000102 /* GS base after swapgs */
 
 #define STDIN 1	 // 표준 입력
 #define STDOUT 2 // 표준 출력
 
-// readers-writers를 위한 semaphore와 cnt
-struct semaphore mutex, wrt;
-int read_cnt;
-
 void halt(void);
 void exit(int status);
 tid_t fork(const char *thread_name, struct intr_frame *if_);
@@ -55,13 +58,17 @@ void *mmap(void *addr, size_t length, int writable, int fd, off_t offset);
 void munmap(void *addr);
 
 int dup2(int oldfd, int newfd);
-
+bool sched_stats(int scope, struct sched_stats *stats, void *rsp);
+int clock_gettime(int clock_id, struct timespec *ts, void *rsp);
+int sched_setdeadline(const struct sched_deadline *dl, void *rsp);
+int thread_join(tid_t tid, int *status, void *rsp);
+int futex_wait_user(int *uaddr, int val, void *rsp);
+static void close_fd(int fd);
+
+/* Sets up the running CPU to take system calls.  Called on each
+ * CPU. */
 void syscall_init(void)
 {
-	sema_init(&mutex, 1);
-	sema_init(&wrt, 1);
-	read_cnt = 0;
-
 	write_msr(MSR_STAR, ((uint64_t)SEL_UCSEG - 0x10) << 48 |
 							((uint64_t)SEL_KCSEG) << 32);
 	write_msr(MSR_LSTAR, (uint64_t)syscall_entry);
@@ -71,6 +78,10 @@ void syscall_init(void)
 	 * mode stack. Therefore, we masked the FLAG_FL. */
 	write_msr(MSR_SYSCALL_MASK,
 			  FLAG_IF | FLAG_TF | FLAG_DF | FLAG_IOPL | FLAG_AC | FLAG_NT);
+
+	/* syscall_entry finds this CPU's TSS, and in it the kernel
+	 * stack, through the GS base that swapgs swaps in. */
+	write_msr(MSR_KERNEL_GS_BASE, (uint64_t)tss_get());
 }
 
 /*
@@ -88,7 +99,7 @@ struct page *check_address(uint64_t addr)
 		// printf("===[DEBUG] addr : %d\n", addr);
 		exit(-1);}
 
-	return spt_find_page(&thread_current()->spt, addr);
+	return spt_find_page(&process_current()->spt, addr);
 }
 
 
@@ -97,7 +108,14 @@ void check_valid_buffer(void *buffer, unsigned size, void *rsp, bool to_write)
 {
 	uintptr_t start_page = pg_round_down(buffer);
 	uintptr_t end_page = pg_round_down(buffer + size - 1);
-	if (buffer <= USER_STACK && buffer >= rsp)
+	uintptr_t stack_bottom, stack_top;
+
+	/* The main thread's stack may not have grown down to BUFFER
+	   yet, so accept anything between RSP and the top of the
+	   running thread's own stack.  The access will grow it. */
+	process_stack_bounds(&stack_bottom, &stack_top);
+	if ((uintptr_t)buffer >= (uintptr_t)rsp && (uintptr_t)buffer >= stack_bottom
+		&& (uintptr_t)buffer + size <= stack_top)
 		return;
 	
 	for (; start_page <= end_page ; start_page += PGSIZE)
@@ -261,7 +279,65 @@ void syscall_handler(struct intr_frame *f)
 		// argv[1]: int newfd
 		f->R.rax = dup2(f->R.rdi, f->R.rsi);
 		break;
+
+	case SYS_SCHED_STATS:
+		// argv[0]: int scope
+		// argv[1]: struct sched_stats *stats
+		f->R.rax = sched_stats(f->R.rdi, (struct sched_stats *)f->R.rsi, (void *)f->rsp);
+		break;
+
+	case SYS_CLOCK_GETTIME:
+		// argv[0]: int clock_id
+		// argv[1]: struct timespec *ts
+		f->R.rax = clock_gettime(f->R.rdi, (struct timespec *)f->R.rsi, (void *)f->rsp);
+		break;
+
+	case SYS_SCHED_SETDEADLINE:
+		// argv[0]: const struct sched_deadline *dl
+		f->R.rax = sched_setdeadline((const struct sched_deadline *)f->R.rdi, (void *)f->rsp);
+		break;
+
+	case SYS_TRACE_DUMP:
+		trace_dump();
+		break;
+
+	case SYS_THREAD_CREATE:
+		// argv[0]: void (*entry) (void *, void *)
+		// argv[1]: void *arg0
+		// argv[2]: void *arg1
+		f->R.rax = process_thread_create(f->R.rdi, f->R.rsi, f->R.rdx);
+		break;
+
+	case SYS_THREAD_EXIT:
+		// argv[0]: int status
+		if (thread_current()->stack_slot < 0)
+			exit(f->R.rdi);
+		thread_current()->exit_status = f->R.rdi;
+		thread_exit();
+		break;
+
+	case SYS_THREAD_JOIN:
+		// argv[0]: tid_t tid
+		// argv[1]: int *status
+		f->R.rax = thread_join(f->R.rdi, (int *)f->R.rsi, (void *)f->rsp);
+		break;
+
+	case SYS_FUTEX_WAIT:
+		// argv[0]: int *uaddr
+		// argv[1]: int val
+		f->R.rax = futex_wait_user((int *)f->R.rdi, f->R.rsi, (void *)f->rsp);
+		break;
+
+	case SYS_FUTEX_WAKE:
+		// argv[0]: int *uaddr
+		// argv[1]: int cnt
+		f->R.rax = futex_wake((const int *)f->R.rdi, f->R.rsi);
+		break;
 	}
+
+	/* Another thread of the process called exit(). */
+	if (process_exiting())
+		thread_exit();
 }
 
 /* pintOS 종료 */
@@ -273,8 +349,9 @@ void halt(void)
 /* 현재 process 종료 */
 void exit(int status)
 {
-	thread_current()->exit_status = status;
-	printf("%s: exit(%d)\n", thread_name(), thread_current()->exit_status);
+	/* The first thread of a process to exit reports for it. */
+	if (process_terminate(status))
+		printf("%s: exit(%d)\n", thread_name(), process_current()->exit_status);
 
 	thread_exit();
 }
@@ -334,9 +411,7 @@ bool remove(const char *file)
 /* 입력 받은 file을 열어서 file descripter 생성 */
 int open(const char *file)
 {
-	sema_down(&wrt);
 	struct file *f = filesys_open(file);
-	sema_up(&wrt);
 	if (f == NULL)
 		return -1;
 
@@ -351,11 +426,13 @@ int filesize(int fd)
 	if (fd < 2)
 		return -1;
 
-	struct file *f = process_get_file(fd);
+	struct file *f = process_pin_file(fd);
 	if (f == NULL)
 		return -1;
 
-	return file_length(f);
+	int length = file_length(f);
+	process_unpin_file(f);
+	return length;
 }
 
 /* fd를 size만큼 buffer에 읽어온다 */
@@ -363,9 +440,12 @@ int read(int fd, void *buffer, unsigned size)
 {
 	check_address(buffer + size - 1); // buffer 끝 주소도 유효성 검사
 
-	struct file *f = process_get_file(fd);
+	struct file *f = process_pin_file(fd);
 	if (f == NULL || f == STDOUT)
+	{
+		process_unpin_file(f);
 		return -1;
+	}
 
 	int read_result;
 
@@ -388,31 +468,21 @@ int read(int fd, void *buffer, unsigned size)
 		}
 	}
 	else
-	{
-		sema_down(&mutex);
-		read_cnt++;
-		if (read_cnt == 1)
-			sema_down(&wrt);
-		sema_up(&mutex);
-
 		read_result = file_read(f, buffer, size);
 
-		sema_down(&mutex);
-		read_cnt--;
-		if (read_cnt == 0)
-			sema_up(&wrt);
-		sema_up(&mutex);
-	}
-
+	process_unpin_file(f);
 	return read_result;
 }
 
 /* buffer에서 size만큼 fd에 쓴다 */
 int write(int fd, const void *buffer, unsigned size)
 {
-	struct file *f = process_get_file(fd);
+	struct file *f = process_pin_file(fd);
 	if (f == NULL || f == STDIN)
+	{
+		process_unpin_file(f);
 		return -1;
+	}
 
 	int write_result;
 
@@ -423,12 +493,9 @@ int write(int fd, const void *buffer, unsigned size)
 		write_result = size;
 	}
 	else
-	{
-		sema_down(&wrt);
 		write_result = file_write(f, buffer, size);
-		sema_up(&wrt);
-	}
 
+	process_unpin_file(f);
 	return write_result;
 }
 
@@ -438,11 +505,12 @@ void seek(int fd, unsigned pos)
 	if (fd < 2)
 		return -1;
 
-	struct file *f = process_get_file(fd);
+	struct file *f = process_pin_file(fd);
 	if (f == NULL)
 		return -1;
 
 	file_seek(f, pos);
+	process_unpin_file(f);
 }
 
 /* fd의 pos를 return */
@@ -451,11 +519,13 @@ unsigned tell(int fd)
 	if (fd < 2)
 		return -1;
 
-	struct file *f = process_get_file(fd);
+	struct file *f = process_pin_file(fd);
 	if (f == NULL)
 		return -1;
 
-	return file_tell(f);
+	unsigned pos = file_tell(f);
+	process_unpin_file(f);
+	return pos;
 }
 
 /*
@@ -471,7 +541,16 @@ stdin_cnt와 stdout_cnt는 별 쓸모 없는 것 같음
 */
 void close(int fd)
 {
-	struct thread *curr = thread_current();
+	process_lock_files();
+	close_fd(fd);
+	process_unlock_files();
+}
+
+/* Does the work of close().  The caller must hold the fd table
+   lock (process_lock_files()). */
+static void close_fd(int fd)
+{
+	struct thread *curr = process_current();
 	struct file *f = process_get_file(fd);
 	if (f == NULL)
 		return;
@@ -489,14 +568,19 @@ void close(int fd)
 		if (f->dup_cnt == 0)
 		{
 			curr->fd_idx = fd;
-			file_close(f);
+			/* A system call in another thread is using F; it
+			   closes F when done (process_unpin_file()). */
+			if (f->pin_cnt > 0)
+				f->closed = true;
+			else
+				file_close(f);
 		}
 		else{
 			f->dup_cnt--;
 			
 			}
 	}
-	thread_current()->fdt[fd] = NULL;
+	curr->fdt[fd] = NULL;
 }
 
 /*
@@ -508,13 +592,14 @@ int dup2(int oldfd, int newfd)
 	if (oldfd == newfd)
 		return newfd;
 
-	struct thread *curr = thread_current();
+	struct thread *curr = process_current();
+	process_lock_files();
 	struct file *f = process_get_file(oldfd);
-	if (f == NULL)
-		return -1;
-
-	if (newfd < 0 || newfd >= FDT_LIMIT)
+	if (f == NULL || newfd < 0 || newfd >= FDT_LIMIT)
+	{
+		process_unlock_files();
 		return -1;
+	}
 
 	if (f == STDIN)
 		curr->stdin_cnt++;
@@ -523,16 +608,16 @@ int dup2(int oldfd, int newfd)
 	else
 		f->dup_cnt++;
 
-	close(newfd);
+	close_fd(newfd);
 	curr->fdt[newfd] = f;
+	process_unlock_files();
 	return newfd;
 }
 
 /**************** project 3: virtual memory *******************/
 void *mmap(void *addr, size_t length, int writable, int fd, off_t offset)
 {	
-	struct file *file = process_get_file(fd);
-	struct thread *cur = thread_current();
+	struct thread *cur = process_current();
 
 
 	if (length == 0 || addr == 0 || addr == NULL)
@@ -541,8 +626,6 @@ void *mmap(void *addr, size_t length, int writable, int fd, off_t offset)
 		return NULL;
 	if (spt_find_page(&cur->spt, addr))
 		return NULL;
-	if (file == NULL || file == STDIN || file == STDOUT)
-		return NULL;
 
 
 	/*for mmap-kernel validation*/
@@ -559,13 +642,91 @@ void *mmap(void *addr, size_t length, int writable, int fd, off_t offset)
 	if (is_kernel_vaddr(addr) || addr == NULL || pg_ofs(addr))
 		return NULL;
 
-	if (spt_find_page(&thread_current()->spt, addr) || offset % PGSIZE)
+	if (spt_find_page(&cur->spt, addr) || offset % PGSIZE)
 		return false;
 
-	return do_mmap(addr, length, writable, file, offset);
+	struct file *file = process_pin_file(fd);
+	void *mapped = NULL;
+	if (file != NULL && file != STDIN && file != STDOUT)
+		mapped = do_mmap(addr, length, writable, file, offset);
+	process_unpin_file(file);
+	return mapped;
 }
 
 void munmap(void *addr)
 {
 	do_munmap(addr);
 }
+
+/* Copies the scheduler statistics for SCOPE, SCHED_STATS_SELF or
+   SCHED_STATS_ALL, into the user buffer STATS.  Returns false if
+   SCOPE is invalid. */
+bool sched_stats(int scope, struct sched_stats *stats, void *rsp)
+{
+	struct sched_stats kstats;
+
+	if (scope != SCHED_STATS_SELF && scope != SCHED_STATS_ALL)
+		return false;
+	check_valid_buffer(stats, sizeof *stats, rsp, true);
+
+	/* Gather with interrupts off, then copy out, which may fault. */
+	thread_get_sched_stats(scope, &kstats);
+	memcpy(stats, &kstats, sizeof *stats);
+	return true;
+}
+
+/* Stores the current time of clock CLOCK_ID in the user buffer
+   TS.  Returns 0 if successful, -1 if CLOCK_ID is unknown. */
+int clock_gettime(int clock_id, struct timespec *ts, void *rsp)
+{
+	int64_t ns;
+
+	if (clock_id != CLOCK_MONOTONIC)
+		return -1;
+	check_valid_buffer(ts, sizeof *ts, rsp, true);
+
+	ns = timer_ns();
+	ts->tv_sec = ns / 1000000000;
+	ts->tv_nsec = ns % 1000000000;
+	return 0;
+}
+
+/* Moves the calling process into the deadline scheduling class
+   with the parameters in user buffer DL, or back out of it if
+   DL->runtime is 0.  Returns 0 if successful, -1 if the
+   parameters are invalid or the class has no room left. */
+int sched_setdeadline(const struct sched_deadline *dl, void *rsp)
+{
+	struct sched_deadline kdl;
+
+	check_valid_buffer((void *)dl, sizeof *dl, rsp, false);
+	memcpy(&kdl, dl, sizeof kdl);
+	return thread_set_deadline(&kdl) ? 0 : -1;
+}
+
+/* Waits for thread TID of the calling process to exit and, if
+   STATUS is not null, stores its exit status in user buffer
+   STATUS.  Returns 0 if successful, -1 if TID cannot be joined
+   (see process_thread_join()). */
+int thread_join(tid_t tid, int *status, void *rsp)
+{
+	int kstatus;
+
+	if (status != NULL)
+		check_valid_buffer(status, sizeof *status, rsp, true);
+	if (!process_thread_join(tid, &kstatus))
+		return -1;
+	if (status != NULL)
+		*status = kstatus;
+	return 0;
+}
+
+/* Sleeps on the futex at user address UADDR if it holds VAL.
+   See futex_wait(). */
+int futex_wait_user(int *uaddr, int val, void *rsp)
+{
+	if ((uintptr_t)uaddr % sizeof *uaddr != 0)
+		return -1;
+	check_valid_buffer(uaddr, sizeof *uaddr, rsp, false);
+	return futex_wait(uaddr, val);
+}
@@ -2,6 +2,7 @@
 #include <debug.h>
 #include <stddef.h>
 #include "userprog/gdt.h"
+#include "threads/cpu.h"
 #include "threads/thread.h"
 #include "threads/palloc.h"
 #include "threads/vaddr.h"
@@ -43,32 +44,41 @@
  *      not in use, so we can always use that.  Thus, when the
  *      scheduler switches threads, it also changes the TSS's
  *      stack pointer to point to the new thread's kernel stack.
- *      (The call is in schedule in thread.c.) */
+ *      (The call is in schedule in thread.c.)
+ *
+ *  Each CPU runs its own thread, so each needs its own TSS. */
 
-/* Kernel TSS. */
+/* Kernel TSSes, one per CPU, indexed by CPU number. */
 struct task_state *tss;
 
-/* Initializes the kernel TSS. */
+/* Initializes the kernel TSSes. */
 void
 tss_init (void) {
 	/* Our TSS is never used in a call gate or task gate, so only a
 	 * few fields of it are ever referenced, and those are the only
 	 * ones we initialize. */
+	ASSERT (NCPU_MAX * sizeof *tss <= PGSIZE);
 	tss = palloc_get_page (PAL_ASSERT | PAL_ZERO);
 	tss_update (thread_current ());
 }
 
-/* Returns the kernel TSS. */
+/* Returns the kernel TSS of CPU number ID. */
 struct task_state *
-tss_get (void) {
+tss_get_cpu (int id) {
 	ASSERT (tss != NULL);
-	return tss;
+	ASSERT (id >= 0 && id < NCPU_MAX);
+	return &tss[id];
 }
 
-/* Sets the ring 0 stack pointer in the TSS to point to the end
- * of the thread stack. */
+/* Returns the kernel TSS of the running CPU. */
+struct task_state *
+tss_get (void) {
+	return tss_get_cpu (this_cpu ()->id);
+}
+
+/* Sets the ring 0 stack pointer in the running CPU's TSS to point
+ * to the end of the thread stack. */
 void
 tss_update (struct thread *next) {
-	ASSERT (tss != NULL);
-	tss->rsp0 = (uint64_t) next + PGSIZE;
+	tss_get ()->rsp0 = (uint64_t) next + PGSIZE;
 }
@@ -2,6 +2,7 @@
 #include "vm/vm.h"
 
 #include "threads/vaddr.h"
+#include "threads/slab.h"
 #include "userprog/process.h"
 #include "threads/mmu.h"
 
@@ -19,12 +20,14 @@ static const struct page_operations file_ops = {
 
 /* Project 3 : Swapping in & out */
 
+struct kmem_cache *file_info_cache;
 
 /* The initializer of file vm */
 void vm_file_init(void)
 {
-
-
+	file_info_cache = kmem_cache_create("file_info", sizeof(struct file_info), NULL);
+	if (file_info_cache == NULL)
+		PANIC("vm_file_init: cannot create file_info cache");
 }
 
 /* Initialize the file backed page */
@@ -92,7 +95,7 @@ do_mmap(void *addr, size_t length, int writable, struct file *file, off_t offset
 	ASSERT(pg_ofs(addr) == 0);
 	ASSERT(offset % PGSIZE == 0);
 	// file_seek(file, offset);
-	struct thread *curr = thread_current();
+	struct thread *curr = process_current();
 	struct mmap_file *mmap_file = (struct mmap_file *)malloc(sizeof(struct mmap_file));
 
 
@@ -109,7 +112,6 @@ do_mmap(void *addr, size_t length, int writable, struct file *file, off_t offset
 	off_t ofs = offset;
 
 	list_init(&mmap_file->page_list);
-	list_push_back(&curr->mmap_list, &mmap_file->elem);
 
 	
 
@@ -120,7 +122,9 @@ do_mmap(void *addr, size_t length, int writable, struct file *file, off_t offset
 
 		/* Set up aux to pass information to the lazy_load_segment */
 
-		struct file_info *file_info = (struct file_info *)malloc(sizeof(struct file_info));
+		struct file_info *file_info = kmem_cache_alloc(file_info_cache);
+		if (file_info == NULL)
+			return NULL;
 
 		file_info->file = mmap_file->file;
 		file_info->ofs = ofs;
@@ -152,6 +156,9 @@ do_mmap(void *addr, size_t length, int writable, struct file *file, off_t offset
 	}
 	// printf("===[DEBUG] WHERE ARE U?\n");
 
+	process_lock_mmaps();
+	list_push_back(&curr->mmap_list, &mmap_file->elem);
+	process_unlock_mmaps();
 	return addr;
 }
 
@@ -164,7 +171,7 @@ void do_munmap(void *addr)
 	/* vm_entry를 가리키는 가상 주소에 대한 물리페이지가 존재하고, dirty 하면 디스크에 메모리 내용을 기록 */
 	
 	/* 1) 주어진 스레드에 대해 파일을 찾아 해당 파일과 연관되는 mmap_list 찾기 */
-	struct thread *curr = thread_current();
+	struct thread *curr = process_current();
 	void *munmap_addr = addr;
 	struct mmap_file *mmap_file;
 	struct page *page;
@@ -176,12 +183,17 @@ void do_munmap(void *addr)
 
 
 	/* thread에 내재되어 있는 mmap_list 순회하여 addr과 일치하는 mapid 검색 */
+	process_lock_mmaps();
 	for (elem = list_begin(mmap_list); elem != list_end(mmap_list); elem = list_next(elem)) {
 		mmap_file = list_entry(elem, struct mmap_file, elem);
 		if (mmap_file->mapid == addr){
 			break;
 		}
 	}
+	if (elem == list_end(mmap_list)) {
+		process_unlock_mmaps();
+		return;
+	}
 
 	// mmap_file->file = file_reopen(mmap_file->file);
 	// if (mmap_file->file == NULL)
@@ -205,6 +217,7 @@ void do_munmap(void *addr)
 		}
 		// file_close(file_info->file);
 		list_remove(&mmap_file->elem);
+		process_unlock_mmaps();
 		// free(mmap_file);
 
 		return;
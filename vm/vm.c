@@ -1,6 +1,7 @@
 /* vm.c: Generic interface for virtual memory objects. */
 
 #include "threads/malloc.h"
+#include "threads/slab.h"
 #include "threads/vaddr.h"
 #include "threads/mmu.h"
 #include "vm/vm.h"
@@ -8,6 +9,17 @@
 #include "vm/uninit.h"
 #include "vm/file.h"
 #include "vm/anon.h"
+#include "userprog/process.h"
+
+/* Frames holding user pages, oldest first, for eviction.
+   Shared by every process, so protected by frame_lock. */
+static struct list frame_list;
+static struct lock frame_lock;
+
+/* Object caches for struct page and struct frame. */
+static struct kmem_cache *page_cache;
+static struct kmem_cache *frame_cache;
+
 /* Initializes the virtual memory subsystem by invoking each subsystem's
  * intialize codes. */
 void vm_init(void)
@@ -21,6 +33,11 @@ void vm_init(void)
 	/* DO NOT MODIFY UPPER LINES. */
 	/* TODO: Your code goes here. */
 	list_init(&frame_list);
+	lock_init(&frame_lock);
+	page_cache = kmem_cache_create("page", sizeof(struct page), NULL);
+	frame_cache = kmem_cache_create("frame", sizeof(struct frame), NULL);
+	if (page_cache == NULL || frame_cache == NULL)
+		PANIC("vm_init: cannot create object caches");
 }
 
 /* Get the type of the page. This function is useful if you want to know the
@@ -43,25 +60,50 @@ page_get_type(struct page *page)
 static struct frame *vm_get_victim(void);
 static bool vm_do_claim_page(struct page *page);
 static struct frame *vm_evict_frame(void);
+static struct page *spt_lookup(struct supplemental_page_table *spt, void *va);
+static struct page *spt_lookup_settled(struct supplemental_page_table *spt, void *va);
+static bool spt_claim(struct supplemental_page_table *spt, struct page *page);
+static bool spt_alloc_page(struct supplemental_page_table *spt, enum vm_type type,
+						   void *upage, bool writable, vm_initializer *init, void *aux);
+
+/* The threads of a process share its main thread's SPT, so each
+   public function below that reads or changes an SPT holds the
+   SPT's lock, and the static helpers expect it to be held. */
 
 /* Create the pending page object with initializer. If you want to create a
  * page, do not create it directly and make it through this function or
  * `vm_alloc_page`. */
 bool vm_alloc_page_with_initializer(enum vm_type type, void *upage, bool writable, vm_initializer *init, void *aux)
 {
-	ASSERT(VM_TYPE(type) != VM_UNINIT)
+	struct supplemental_page_table *spt = &process_current()->spt;
+	bool success;
 
-	struct supplemental_page_table *spt = &thread_current()->spt;
+	lock_acquire(&spt->lock);
+	success = spt_alloc_page(spt, type, upage, writable, init, aux);
+	lock_release(&spt->lock);
+	return success;
+}
+
+/* Does the work of vm_alloc_page_with_initializer() for SPT,
+   whose lock must be held. */
+static bool
+spt_alloc_page(struct supplemental_page_table *spt, enum vm_type type, void *upage,
+			   bool writable, vm_initializer *init, void *aux)
+{
+	ASSERT(VM_TYPE(type) != VM_UNINIT)
+	ASSERT(lock_held_by_current_thread(&spt->lock));
 
 	/* Check wheter the upage is already occupied or not. */
-	if (spt_find_page(spt, upage) == NULL)
+	if (spt_lookup(spt, upage) == NULL)
 	{
 		/* TODO: Create the page, fetch the initialier according to the VM type,
 		 * TODO: and then create "uninit" page struct by calling uninit_new. You
 		 * TODO: should modify the field after calling the uninit_new. */
 
-		// 1. malloc으로  page struct를 만든다.
-		struct page *new_page = (struct page *)malloc(sizeof(struct page));
+		// 1. page_cache에서 page struct를 만든다.
+		struct page *new_page = kmem_cache_alloc(page_cache);
+		if (new_page == NULL)
+			goto err;
 
 		switch (type)
 		{
@@ -80,7 +122,7 @@ bool vm_alloc_page_with_initializer(enum vm_type type, void *upage, bool writabl
 		new_page->writable = writable;
 		/* TODO: Insert the page into the spt. */
 
-	return spt_insert_page(spt, new_page);
+	return hash_insert(&spt->table, &new_page->hash_elem) == NULL;
 	}
 
 err:
@@ -91,6 +133,19 @@ err:
 /* Find VA from spt and return page. On error, return NULL. */
 struct page *
 spt_find_page(struct supplemental_page_table *spt, void *va)
+{
+	struct page *page;
+
+	lock_acquire(&spt->lock);
+	page = spt_lookup(spt, va);
+	lock_release(&spt->lock);
+	return page;
+}
+
+/* Does the work of spt_find_page() for SPT, whose lock must be
+   held. */
+static struct page *
+spt_lookup(struct supplemental_page_table *spt, void *va)
 {
 	struct page temp_page;
 	temp_page.va = pg_round_down(va);
@@ -102,20 +157,61 @@ spt_find_page(struct supplemental_page_table *spt, void *va)
 	return hash_entry(temp_hash_elem, struct page, hash_elem);
 }
 
+/* Like spt_lookup(), but if another thread is claiming the page
+   at VA, waits for it to finish first. */
+static struct page *
+spt_lookup_settled(struct supplemental_page_table *spt, void *va)
+{
+	struct page *page;
+
+	while ((page = spt_lookup(spt, va)) != NULL && page->claiming)
+		cond_wait(&spt->claimed, &spt->lock);
+	return page;
+}
+
 /* Insert PAGE into spt with validation. */
 bool spt_insert_page(struct supplemental_page_table *spt, struct page *page)
 {
-	struct hash_elem *temp_elem = hash_insert(&spt->table, &page->hash_elem);
+	struct hash_elem *temp_elem;
+
+	lock_acquire(&spt->lock);
+	temp_elem = hash_insert(&spt->table, &page->hash_elem);
+	lock_release(&spt->lock);
 	if (temp_elem == NULL)
 		return true;
 
 	return false;
 }
 
+/* Removes PAGE from SPT, which must belong to the running
+   thread's process, and frees it along with its frame. */
 void spt_remove_page(struct supplemental_page_table *spt, struct page *page)
 {
+	struct frame *frame;
+
+	lock_acquire(&spt->lock);
+	while (page->claiming)
+		cond_wait(&spt->claimed, &spt->lock);
+	hash_delete(&spt->table, &page->hash_elem);
+	lock_release(&spt->lock);
+
+	/* Eviction can take the frame away until we hold frame_lock. */
+	lock_acquire(&frame_lock);
+	frame = page->frame;
+	if (frame != NULL)
+	{
+		list_remove(&frame->frame_elem);
+		page->frame = NULL;
+	}
+	lock_release(&frame_lock);
+
+	if (frame != NULL)
+	{
+		pml4_clear_page(thread_current()->pml4, page->va);
+		palloc_free_page(frame->kva);
+		kmem_cache_free(frame_cache, frame);
+	}
 	vm_dealloc_page(page);
-	return true;
 }
 
 /* Get the struct frame, that will be evicted. */
@@ -123,7 +219,12 @@ static struct frame *vm_get_victim(void)
 {
 	struct frame *victim = NULL;
 	/* TODO: The policy for eviction is up to you. */
-	struct list_elem *e = list_pop_front(&frame_list);
+	struct list_elem *e;
+
+	ASSERT(lock_held_by_current_thread(&frame_lock));
+	if (list_empty(&frame_list))
+		return NULL;
+	e = list_pop_front(&frame_list);
 	victim = list_entry(e, struct frame, frame_elem);
 
 	return victim;
@@ -155,29 +256,40 @@ vm_evict_frame(void)
 static struct frame *
 vm_get_frame(void)
 {
-	struct frame *frame = (struct frame *)malloc(sizeof(struct frame));
-
-	frame->kva = palloc_get_page(PAL_USER);
-	if (frame->kva == NULL){
+	struct frame *frame;
+	void *kva;
+
+	lock_acquire(&frame_lock);
+	kva = palloc_get_page(PAL_USER);
+	frame = kva != NULL ? kmem_cache_alloc(frame_cache) : NULL;
+	if (frame != NULL)
+		frame->kva = kva;
+	else
+	{
+		/* Out of user pages or frame structs: reuse a victim's. */
+		if (kva != NULL)
+			palloc_free_page(kva);
 		frame = vm_evict_frame();
+		if (frame == NULL)
+			PANIC("vm_get_frame: no frame to allocate or evict");
 	}
 
 	frame->page = NULL;
 	
 
-	ASSERT(frame != NULL);
 	ASSERT(frame->page == NULL);
 
 	list_push_back(&frame_list, &frame->frame_elem);
+	lock_release(&frame_lock);
 	return frame;
 }
 
 /* Growing the stack. */
 static void
-vm_stack_growth(void *addr)
+vm_stack_growth(struct supplemental_page_table *spt, void *addr)
 {
 	uintptr_t stack_bottom = pg_round_down(addr);
-	vm_alloc_page(VM_ANON, stack_bottom, true);
+	spt_alloc_page(spt, VM_ANON, (void *)stack_bottom, true, NULL, NULL);
 	// thread_current()->user_rsp = addr;
 }
 
@@ -192,35 +304,35 @@ bool vm_try_handle_fault(struct intr_frame *f, void *addr, bool user, bool write
 {
 	
 	// printf("=======vm_try_handle_fault :: start \n");
-	struct supplemental_page_table *spt = &thread_current()->spt;
+	struct supplemental_page_table *spt = &process_current()->spt;
 	bool succ = false;
 
 	/* check validation */
 	if (is_kernel_vaddr(addr) || addr == NULL)
 		return false;
 
-	/* stack growth */
+	lock_acquire(&spt->lock);
+
+	/* stack growth.  Only the main thread's stack grows: the
+	   stacks of the other threads are registered in full when
+	   they are created, and their RSP lies below the main stack,
+	   so any access to it would look like a push. */
 	uintptr_t stack_limit = USER_STACK - (1 << 20);
 	uintptr_t rsp = user ? f->rsp : thread_current()->user_rsp;
-	uintptr_t stack_bottom = pg_round_down(rsp);
-
+	uintptr_t va = (uintptr_t)addr;
 
-	if (addr >= rsp - 8 && addr <= USER_STACK && addr >= stack_limit)
-		vm_stack_growth(addr);
+	if (thread_current()->stack_slot < 0
+		&& va >= rsp - 8 && va <= USER_STACK && va >= stack_limit)
+		vm_stack_growth(spt, addr);
 
 	/* find page */
-	struct page *page = spt_find_page(spt, addr);
-	if (page == NULL)
-		return false;
-
-
-
-	if (!page->writable && write)
-		return false;
+	struct page *page = spt_lookup_settled(spt, addr);
 
 	/* upload to pysical memory */
-	succ = vm_do_claim_page(page);
+	if (page != NULL && (page->writable || !write))
+		succ = spt_claim(spt, page);
 
+	lock_release(&spt->lock);
 	return succ;
 }
 
@@ -229,17 +341,49 @@ bool vm_try_handle_fault(struct intr_frame *f, void *addr, bool user, bool write
 void vm_dealloc_page(struct page *page)
 {
 	destroy(page);
-	free(page);
+	kmem_cache_free(page_cache, page);
 }
 
 /* Claim the page that allocate on VA. */
 bool vm_claim_page(void *va)
 {
-	struct page *page = spt_find_page(&thread_current()->spt.table, va);
-	if (page == NULL)
-		return false;
+	struct supplemental_page_table *spt = &process_current()->spt;
+	struct page *page;
+	bool success = false;
+
+	lock_acquire(&spt->lock);
+	page = spt_lookup_settled(spt, va);
+	if (page != NULL)
+		success = spt_claim(spt, page);
+	lock_release(&spt->lock);
+	return success;
+}
+
+/* Claims PAGE of SPT, whose lock must be held, unless it is
+   already in memory.  The lock is dropped while the page is read
+   in, because the file or swap I/O takes other locks (the
+   inode's, the swap table's) that a thread holding one of them
+   may need the SPT lock under, when it faults on a user buffer.
+   Meanwhile PAGE is marked as claiming, which makes the process's
+   other threads wait rather than claim or remove it too. */
+static bool
+spt_claim(struct supplemental_page_table *spt, struct page *page)
+{
+	bool success;
+
+	ASSERT(lock_held_by_current_thread(&spt->lock));
+	ASSERT(!page->claiming);
+
+	if (page->frame != NULL)
+		return true;
 
-	return vm_do_claim_page(page);
+	page->claiming = true;
+	lock_release(&spt->lock);
+	success = vm_do_claim_page(page);
+	lock_acquire(&spt->lock);
+	page->claiming = false;
+	cond_broadcast(&spt->claimed, &spt->lock);
+	return success;
 }
 
 /* Claim the PAGE and set up the mmu. */
@@ -269,6 +413,8 @@ void hash_destructor(struct hash_elem *hash_elem, void *aux);
 void supplemental_page_table_init(struct supplemental_page_table *spt)
 {
 	hash_init(&spt->table, spt_hash, spt_less, NULL);
+	lock_init(&spt->lock);
+	cond_init(&spt->claimed);
 }
 
 /* Copy supplemental page table from src to dst */
@@ -277,6 +423,8 @@ bool supplemental_page_table_copy(struct supplemental_page_table *dst, struct su
 	struct hash_iterator i;
 	struct hash *parent_hash = &src->table;
 
+	/* SRC's other threads keep running while we copy. */
+	lock_acquire(&src->lock);
 	hash_first(&i, parent_hash);
 	while (hash_next(&i))
 	{
@@ -300,6 +448,7 @@ bool supplemental_page_table_copy(struct supplemental_page_table *dst, struct su
 			memcpy(child_page->frame->kva, parent_page->frame->kva, PGSIZE);
 		}
 	}
+	lock_release(&src->lock);
 
 	return true;
 }
@@ -310,8 +459,8 @@ void supplemental_page_table_kill(struct supplemental_page_table *spt)
 
 	/* TODO: Destroy all the supplemental_page_table hold by thread and
 	 * TODO: writeback all the modified contents to the storage. */
-	struct list_elem *soon_die_elem = list_begin(&thread_current()->mmap_list);
-		while (soon_die_elem != list_end(&thread_current()->mmap_list))
+	struct list_elem *soon_die_elem = list_begin(&process_current()->mmap_list);
+		while (soon_die_elem != list_end(&process_current()->mmap_list))
 		{
 			struct mmap_file *soon_die_file = list_entry(soon_die_elem, struct mmap_file, elem);
 			soon_die_elem = soon_die_elem->next;